@@ -0,0 +1,492 @@
+#include "AABBTree.h"
+#include "IO.h"
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+	vec3 minimum(const vec3 &a, const vec3 &b)
+	{
+		return vec3((std::min)(a.x, b.x), (std::min)(a.y, b.y), (std::min)(a.z, b.z));
+	}
+
+	vec3 maximum(const vec3 &a, const vec3 &b)
+	{
+		return vec3((std::max)(a.x, b.x), (std::max)(a.y, b.y), (std::max)(a.z, b.z));
+	}
+
+	float surfaceArea(const vec3 &boundsMin, const vec3 &boundsMax)
+	{
+		vec3 size = boundsMax - boundsMin;
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	bool overlaps(const vec3 &aMin, const vec3 &aMax, const vec3 &bMin, const vec3 &bMax)
+	{
+		return aMin.x <= bMax.x && aMax.x >= bMin.x &&
+			aMin.y <= bMax.y && aMax.y >= bMin.y &&
+			aMin.z <= bMax.z && aMax.z >= bMin.z;
+	}
+
+	bool contains(const vec3 &outerMin, const vec3 &outerMax, const vec3 &innerMin, const vec3 &innerMax)
+	{
+		return outerMin.x <= innerMin.x && outerMin.y <= innerMin.y && outerMin.z <= innerMin.z &&
+			innerMax.x <= outerMax.x && innerMax.y <= outerMax.y && innerMax.z <= outerMax.z;
+	}
+
+	bool overlapsSphere(const vec3 &boundsMin, const vec3 &boundsMax, const vec3 &center, float radius)
+	{
+		vec3 closest = maximum(boundsMin, minimum(center, boundsMax));
+		return (closest - center).LengthSquared() <= radius * radius;
+	}
+
+	// Slab test, the distance along the ray where it enters the box
+	bool intersectsRay(const vec3 &boundsMin, const vec3 &boundsMax, const vec3 &origin, const vec3 &inverseDirection, float maxDistance, float &entry)
+	{
+		float tMin = 0.0f;
+		float tMax = maxDistance;
+		for (unsigned axis = 0; axis < 3; ++axis)
+		{
+			float t1 = (boundsMin[axis] - origin[axis]) * inverseDirection[axis];
+			float t2 = (boundsMax[axis] - origin[axis]) * inverseDirection[axis];
+			// Parallel rays inside the slab give NaNs here, which the comparisons ignore
+			tMin = (std::max)(tMin, (std::min)(t1, t2));
+			tMax = (std::min)(tMax, (std::max)(t1, t2));
+		}
+		entry = tMin;
+		return tMin <= tMax;
+	}
+}
+
+int AABBTree::insert(Transform * object, const vec3 & boundsMin, const vec3 & boundsMax)
+{
+	int leaf = allocateNode();
+	Node& node = _Nodes[leaf];
+	node.object = object;
+	node.tightMin = boundsMin;
+	node.tightMax = boundsMax;
+	node.boundsMin = boundsMin - vec3(margin);
+	node.boundsMax = boundsMax + vec3(margin);
+	node.height = 0;
+	insertLeaf(leaf);
+	++_NumObjects;
+	return leaf;
+}
+
+void AABBTree::remove(int proxy)
+{
+	SAT_ASSERT(proxy >= 0 && proxy < (int)_Nodes.size() && _Nodes[proxy].isLeaf(), "Removing an invalid proxy from an AABBTree!");
+	removeLeaf(proxy);
+	freeNode(proxy);
+	--_NumObjects;
+}
+
+bool AABBTree::move(int proxy, const vec3 & boundsMin, const vec3 & boundsMax)
+{
+	SAT_ASSERT(proxy >= 0 && proxy < (int)_Nodes.size() && _Nodes[proxy].isLeaf(), "Moving an invalid proxy in an AABBTree!");
+	Node& node = _Nodes[proxy];
+	node.tightMin = boundsMin;
+	node.tightMax = boundsMax;
+	if (contains(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+	{
+		return false;
+	}
+
+	removeLeaf(proxy);
+	node.boundsMin = boundsMin - vec3(margin);
+	node.boundsMax = boundsMax + vec3(margin);
+	insertLeaf(proxy);
+	return true;
+}
+
+void AABBTree::clear()
+{
+	_Nodes.clear();
+	_Root = _FreeList = Null;
+	_NumObjects = 0;
+}
+
+void AABBTree::queryFrustum(const Frustum & frustum, std::vector<Transform*>& objects) const
+{
+	if (_Root == Null)
+	{
+		return;
+	}
+
+	// Leaves crossing a plane, tested four or eight at a time once the walk is done
+	BoundsList candidateBounds;
+	std::vector<Transform*> candidates;
+	std::vector<int> stack;
+	stack.push_back(_Root);
+	while (!stack.empty())
+	{
+		const Node& node = _Nodes[stack.back()];
+		stack.pop_back();
+
+		Frustum::Containment containment = frustum.classify(node.boundsMin, node.boundsMax);
+		if (containment == Frustum::Containment::Outside)
+		{
+			continue;
+		}
+		if (node.isLeaf())
+		{
+			candidateBounds.add(node.tightMin, node.tightMax);
+			candidates.push_back(node.object);
+		}
+		else if (containment == Frustum::Containment::Inside)
+		{
+			addSubtree(node.child1, objects);
+			addSubtree(node.child2, objects);
+		}
+		else
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+
+	std::vector<unsigned char> visible;
+	frustum.test(candidateBounds, visible);
+	for (size_t i = 0; i < candidates.size(); ++i)
+	{
+		if (visible[i])
+		{
+			objects.push_back(candidates[i]);
+		}
+	}
+}
+
+void AABBTree::querySphere(const vec3 & center, float radius, std::vector<Transform*>& objects) const
+{
+	if (_Root == Null)
+	{
+		return;
+	}
+
+	std::vector<int> stack;
+	stack.push_back(_Root);
+	while (!stack.empty())
+	{
+		const Node& node = _Nodes[stack.back()];
+		stack.pop_back();
+		if (!overlapsSphere(node.boundsMin, node.boundsMax, center, radius))
+		{
+			continue;
+		}
+		if (!node.isLeaf())
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+		else if (overlapsSphere(node.tightMin, node.tightMax, center, radius))
+		{
+			objects.push_back(node.object);
+		}
+	}
+}
+
+void AABBTree::queryBox(const vec3 & boundsMin, const vec3 & boundsMax, std::vector<Transform*>& objects) const
+{
+	if (_Root == Null)
+	{
+		return;
+	}
+
+	std::vector<int> stack;
+	stack.push_back(_Root);
+	while (!stack.empty())
+	{
+		const Node& node = _Nodes[stack.back()];
+		stack.pop_back();
+		if (!overlaps(node.boundsMin, node.boundsMax, boundsMin, boundsMax))
+		{
+			continue;
+		}
+		if (!node.isLeaf())
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+		else if (overlaps(node.tightMin, node.tightMax, boundsMin, boundsMax))
+		{
+			objects.push_back(node.object);
+		}
+	}
+}
+
+void AABBTree::raycast(const vec3 & origin, const vec3 & direction, float maxDistance, std::vector<Transform*>& objects) const
+{
+	if (_Root == Null)
+	{
+		return;
+	}
+
+	vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	std::vector<std::pair<float, Transform*>> hits;
+	std::vector<int> stack;
+	stack.push_back(_Root);
+	while (!stack.empty())
+	{
+		const Node& node = _Nodes[stack.back()];
+		stack.pop_back();
+		float entry;
+		if (!intersectsRay(node.boundsMin, node.boundsMax, origin, inverseDirection, maxDistance, entry))
+		{
+			continue;
+		}
+		if (!node.isLeaf())
+		{
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+		else if (intersectsRay(node.tightMin, node.tightMax, origin, inverseDirection, maxDistance, entry))
+		{
+			hits.push_back({ entry, node.object });
+		}
+	}
+
+	std::sort(hits.begin(), hits.end(), [](const std::pair<float, Transform*>& a, const std::pair<float, Transform*>& b)
+	{
+		return a.first < b.first;
+	});
+	for (const std::pair<float, Transform*>& hit : hits)
+	{
+		objects.push_back(hit.second);
+	}
+}
+
+int AABBTree::getHeight() const
+{
+	return _Root == Null ? 0 : _Nodes[_Root].height;
+}
+
+int AABBTree::getNumObjects() const
+{
+	return _NumObjects;
+}
+
+int AABBTree::allocateNode()
+{
+	if (_FreeList == Null)
+	{
+		_Nodes.push_back(Node());
+		return (int)_Nodes.size() - 1;
+	}
+
+	int node = _FreeList;
+	_FreeList = _Nodes[node].parent;
+	_Nodes[node] = Node();
+	return node;
+}
+
+void AABBTree::freeNode(int node)
+{
+	_Nodes[node].parent = _FreeList;
+	_Nodes[node].object = nullptr;
+	_Nodes[node].height = -1;
+	_FreeList = node;
+}
+
+void AABBTree::insertLeaf(int leaf)
+{
+	if (_Root == Null)
+	{
+		_Root = leaf;
+		_Nodes[leaf].parent = Null;
+		return;
+	}
+
+	// Walk down to the sibling that adds the least surface area, counting what the ancestors grow by
+	vec3 leafMin = _Nodes[leaf].boundsMin;
+	vec3 leafMax = _Nodes[leaf].boundsMax;
+	int index = _Root;
+	while (!_Nodes[index].isLeaf())
+	{
+		const Node& node = _Nodes[index];
+		float area = surfaceArea(node.boundsMin, node.boundsMax);
+		float combinedArea = surfaceArea(minimum(node.boundsMin, leafMin), maximum(node.boundsMax, leafMax));
+
+		// Pairing with this node makes a new parent, and every ancestor grows with it
+		float cost = 2.0f * combinedArea;
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; ++c)
+		{
+			const Node& child = _Nodes[children[c]];
+			float grownArea = surfaceArea(minimum(child.boundsMin, leafMin), maximum(child.boundsMax, leafMax));
+			childCosts[c] = (child.isLeaf() ? grownArea : grownArea - surfaceArea(child.boundsMin, child.boundsMax)) + inheritanceCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+		{
+			break;
+		}
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+	int sibling = index;
+
+	int oldParent = _Nodes[sibling].parent;
+	int newParent = allocateNode();
+	Node& parent = _Nodes[newParent];
+	parent.parent = oldParent;
+	parent.boundsMin = minimum(leafMin, _Nodes[sibling].boundsMin);
+	parent.boundsMax = maximum(leafMax, _Nodes[sibling].boundsMax);
+	parent.height = _Nodes[sibling].height + 1;
+	parent.child1 = sibling;
+	parent.child2 = leaf;
+	_Nodes[sibling].parent = newParent;
+	_Nodes[leaf].parent = newParent;
+
+	if (oldParent == Null)
+	{
+		_Root = newParent;
+	}
+	else if (_Nodes[oldParent].child1 == sibling)
+	{
+		_Nodes[oldParent].child1 = newParent;
+	}
+	else
+	{
+		_Nodes[oldParent].child2 = newParent;
+	}
+
+	refit(newParent);
+}
+
+void AABBTree::removeLeaf(int leaf)
+{
+	if (leaf == _Root)
+	{
+		_Root = Null;
+		return;
+	}
+
+	// The sibling takes the parent's place
+	int parent = _Nodes[leaf].parent;
+	int grandParent = _Nodes[parent].parent;
+	int sibling = _Nodes[parent].child1 == leaf ? _Nodes[parent].child2 : _Nodes[parent].child1;
+
+	freeNode(parent);
+	_Nodes[sibling].parent = grandParent;
+	if (grandParent == Null)
+	{
+		_Root = sibling;
+		return;
+	}
+
+	if (_Nodes[grandParent].child1 == parent)
+	{
+		_Nodes[grandParent].child1 = sibling;
+	}
+	else
+	{
+		_Nodes[grandParent].child2 = sibling;
+	}
+	refit(grandParent);
+}
+
+int AABBTree::balance(int indexA)
+{
+	Node* a = &_Nodes[indexA];
+	if (a->isLeaf() || a->height < 2)
+	{
+		return indexA;
+	}
+
+	int indexB = a->child1;
+	int indexC = a->child2;
+	Node* b = &_Nodes[indexB];
+	Node* c = &_Nodes[indexC];
+	int difference = c->height - b->height;
+
+	// The taller child takes a's place, with a as its child and its shorter child given to a
+	if (difference > 1 || difference < -1)
+	{
+		int indexUp = difference > 1 ? indexC : indexB;
+		int indexOther = difference > 1 ? indexB : indexC;
+		Node* up = &_Nodes[indexUp];
+		Node* other = &_Nodes[indexOther];
+		int indexF = up->child1;
+		int indexG = up->child2;
+		Node* f = &_Nodes[indexF];
+		Node* g = &_Nodes[indexG];
+
+		up->child1 = indexA;
+		up->parent = a->parent;
+		a->parent = indexUp;
+		if (up->parent == Null)
+		{
+			_Root = indexUp;
+		}
+		else if (_Nodes[up->parent].child1 == indexA)
+		{
+			_Nodes[up->parent].child1 = indexUp;
+		}
+		else
+		{
+			_Nodes[up->parent].child2 = indexUp;
+		}
+
+		// The taller grandchild stays up, the shorter goes to a in place of up
+		int indexKeep = f->height > g->height ? indexF : indexG;
+		int indexGive = f->height > g->height ? indexG : indexF;
+		Node* keep = &_Nodes[indexKeep];
+		Node* give = &_Nodes[indexGive];
+		up->child2 = indexKeep;
+		if (difference > 1)
+		{
+			a->child2 = indexGive;
+		}
+		else
+		{
+			a->child1 = indexGive;
+		}
+		give->parent = indexA;
+
+		a->boundsMin = minimum(other->boundsMin, give->boundsMin);
+		a->boundsMax = maximum(other->boundsMax, give->boundsMax);
+		a->height = 1 + (std::max)(other->height, give->height);
+		up->boundsMin = minimum(a->boundsMin, keep->boundsMin);
+		up->boundsMax = maximum(a->boundsMax, keep->boundsMax);
+		up->height = 1 + (std::max)(a->height, keep->height);
+		return indexUp;
+	}
+	return indexA;
+}
+
+void AABBTree::refit(int node)
+{
+	while (node != Null)
+	{
+		node = balance(node);
+		Node& parent = _Nodes[node];
+		const Node& child1 = _Nodes[parent.child1];
+		const Node& child2 = _Nodes[parent.child2];
+		parent.boundsMin = minimum(child1.boundsMin, child2.boundsMin);
+		parent.boundsMax = maximum(child1.boundsMax, child2.boundsMax);
+		parent.height = 1 + (std::max)(child1.height, child2.height);
+		node = parent.parent;
+	}
+}
+
+void AABBTree::addSubtree(int node, std::vector<Transform*>& objects) const
+{
+	std::vector<int> stack;
+	stack.push_back(node);
+	while (!stack.empty())
+	{
+		const Node& current = _Nodes[stack.back()];
+		stack.pop_back();
+		if (current.isLeaf())
+		{
+			objects.push_back(current.object);
+		}
+		else
+		{
+			stack.push_back(current.child1);
+			stack.push_back(current.child2);
+		}
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "Frustum.h"
+#include <MiniMath/Core.h>
+#include <vector>
+
+class Transform;
+
+/*
+	///// // AABBTree // /////
+
+	Spatial index of objects by their world space bounding boxes, so scene queries visit the
+	branches that can answer them instead of every object.
+
+	A binary tree of boxes, with one object per leaf. Leaves are inserted next to the sibling
+	that grows the tree's surface area the least, and the tree is kept balanced with rotations on
+	the way back up, like an AVL tree.
+
+	Leaves keep a box fattened by margin on every side, so an object moving a little does not
+	touch the tree at all. move() only reinserts the leaf once the object leaves its fat box.
+	Queries test the fat boxes on the way down and the objects' tight boxes at the leaves.
+
+	Query results are appended to the vector passed in. Queries only read the tree and can run
+	on several threads at once, as long as nothing modifies it meanwhile.
+*/
+
+class AABBTree
+{
+public:
+	static const int Null = -1;
+
+	// Returns the object's proxy, for move() and remove()
+	int insert(Transform *object, const vec3 &boundsMin, const vec3 &boundsMax);
+	void remove(int proxy);
+	// Updates the object's bounds, true if it had to be reinserted
+	bool move(int proxy, const vec3 &boundsMin, const vec3 &boundsMax);
+	void clear();
+
+	// Objects that may be seen. Subtrees entirely inside are taken as they are, the objects in
+	// boxes crossing a plane are tested together with Frustum::test.
+	void queryFrustum(const Frustum &frustum, std::vector<Transform*> &objects) const;
+	void querySphere(const vec3 &center, float radius, std::vector<Transform*> &objects) const;
+	void queryBox(const vec3 &boundsMin, const vec3 &boundsMax, std::vector<Transform*> &objects) const;
+	// Objects whose bounds the ray enters within maxDistance, nearest first.
+	// direction needs not be normalized, distances are in multiples of it.
+	void raycast(const vec3 &origin, const vec3 &direction, float maxDistance, std::vector<Transform*> &objects) const;
+
+	int getHeight() const;
+	int getNumObjects() const;
+
+	// Added around each object's bounds, in world units
+	float margin = 0.5f;
+
+private:
+	struct Node
+	{
+		// Fat bounds for leaves, the union of the children otherwise
+		vec3 boundsMin;
+		vec3 boundsMax;
+		// The object's own bounds, leaves only
+		vec3 tightMin;
+		vec3 tightMax;
+		Transform* object = nullptr;
+		// Next free node while in the free list
+		int parent = Null;
+		int child1 = Null;
+		int child2 = Null;
+		// Leaves are 0, free nodes -1
+		int height = 0;
+
+		bool isLeaf() const { return child1 == Null; }
+	};
+
+	int allocateNode();
+	void freeNode(int node);
+	void insertLeaf(int leaf);
+	void removeLeaf(int leaf);
+	// Rotates the taller grandchild up if node's children differ in height by more than one,
+	// returns the node now in its place
+	int balance(int node);
+	// Refits boxes and heights from node up to the root
+	void refit(int node);
+	void addSubtree(int node, std::vector<Transform*> &objects) const;
+
+	std::vector<Node> _Nodes;
+	int _Root = Null;
+	int _FreeList = Null;
+	int _NumObjects = 0;
+};
@@ -0,0 +1,473 @@
+#include "AssetLoader.h"
+#include "ThreadPool.h"
+#include "Texture.h"
+#include "TextureCube.h"
+#include "Mesh.h"
+#include "ImageContainer.h"
+#include "TextureStreamer.h"
+#include "IO.h"
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+std::mutex AssetLoader::_UploadMutex;
+std::deque<AssetLoader::Upload> AssetLoader::_Uploads;
+std::atomic<unsigned int> AssetLoader::_NumPending(0);
+std::vector<std::function<void()>> AssetLoader::_MainThreadTasks;
+// Statics are initialized before main() runs, on the thread that creates the OpenGL context
+std::thread::id AssetLoader::_MainThread = std::this_thread::get_id();
+std::mutex AssetLoader::_StagingMutex;
+std::deque<AssetLoader::StagingBlock> AssetLoader::_StagingBlocks;
+unsigned int AssetLoader::_StagingBuffer = 0;
+char* AssetLoader::_StagingMapped = nullptr;
+
+AssetState AssetHandle::getState() const
+{
+	return _State ? _State->load() : AssetState::Failed;
+}
+
+bool AssetHandle::isReady() const
+{
+	return getState() == AssetState::Ready;
+}
+
+bool AssetHandle::isFailed() const
+{
+	return getState() == AssetState::Failed;
+}
+
+bool AssetHandle::isPending() const
+{
+	return getState() == AssetState::Pending;
+}
+
+AssetHandle AssetLoader::loadTexture(Texture * texture, const std::string & file, bool mipmap, unsigned char placeholder)
+{
+	return loadTexture(std::shared_ptr<Texture>(texture, [](Texture*) {}), file, mipmap, placeholder);
+}
+
+AssetHandle AssetLoader::loadTextureCube(TextureCube * texture, const std::vector<std::string>& files, bool mipmap)
+{
+	return loadTextureCube(std::shared_ptr<TextureCube>(texture, [](TextureCube*) {}), files, mipmap);
+}
+
+AssetHandle AssetLoader::loadMesh(Mesh * mesh, const std::string & file)
+{
+	return loadMesh(std::shared_ptr<Mesh>(mesh, [](Mesh*) {}), file);
+}
+
+AssetHandle AssetLoader::loadTexture(std::shared_ptr<Texture> texture, const std::string & file, bool mipmap, unsigned char placeholder)
+{
+	AssetHandle handle = createHandle();
+	createStagingRing();
+	texture->filename = "../assets/textures/" + file;
+	texture->createPlaceholder(placeholder, placeholder, placeholder);
+
+	std::string path = texture->filename;
+	ThreadPool::shared().submit([=]()
+	{
+		std::string precompressed = Texture::findPrecompressed(path);
+		if (!ImageContainer::isContainerFile(precompressed))
+		{
+			precompressed = texture->findCompressionCache(path);
+		}
+		if (ImageContainer::isContainerFile(precompressed))
+		{
+			auto image = std::make_shared<ImageContainer>();
+			if (!image->load(precompressed) || image->isCube())
+			{
+				SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", precompressed.c_str());
+				fail(handle);
+				return;
+			}
+
+			// Streamed textures start out with only their small levels, the rest follow as they are needed
+			int firstLevel = mipmap ? TextureStreamer::getTailLevel(*image) : 0;
+			size_t offset, size;
+			image->getLevelSpan(firstLevel, offset, size);
+			StagedPixels staged = stagePixels(image->getData() + offset, size);
+			queueUpload(handle, [=]()
+			{
+				const void* base = bindStaged(staged, image->getData() + offset);
+				image->setPixelBase(reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(base) - offset));
+				texture->upload(*image, mipmap, firstLevel);
+				unbindStaged(staged);
+				if (firstLevel > 0)
+				{
+					TextureStreamer::add(texture.get(), precompressed, *image, firstLevel);
+				}
+				return true;
+			});
+			return;
+		}
+
+		int width, height, numChannels;
+		unsigned char* pixels = Texture::decodeImage(path, width, height, numChannels);
+		if (pixels == nullptr)
+		{
+			SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", path.c_str());
+			fail(handle);
+			return;
+		}
+
+		auto image = std::make_shared<ImageContainer>();
+		if (texture->compressImage(path, pixels, width, height, mipmap, *image))
+		{
+			Texture::freeImage(pixels);
+			StagedPixels staged = stagePixels(image->getData(), image->getDataSize());
+			queueUpload(handle, [=]()
+			{
+				image->setPixelBase(bindStaged(staged, image->getData()));
+				texture->upload(*image, mipmap);
+				unbindStaged(staged);
+				return true;
+			});
+			return;
+		}
+
+		// Once staged the decoded pixels are no longer needed here
+		StagedPixels staged = stagePixels(pixels, (size_t)width * height * 4);
+		if (staged.staged)
+		{
+			Texture::freeImage(pixels);
+			pixels = nullptr;
+		}
+		queueUpload(handle, [=]()
+		{
+			texture->sizeX = width;
+			texture->sizeY = height;
+			texture->channels = numChannels;
+			texture->upload(bindStaged(staged, pixels), mipmap);
+			unbindStaged(staged);
+			if (pixels != nullptr)
+			{
+				Texture::freeImage(pixels);
+			}
+			return true;
+		});
+	});
+	return handle;
+}
+
+AssetHandle AssetLoader::loadTextureCube(std::shared_ptr<TextureCube> texture, const std::vector<std::string>& files, bool mipmap)
+{
+	AssetHandle handle = createHandle();
+	createStagingRing();
+	texture->filename = "../assets/textures/cubemap/" + files[0];
+	texture->createPlaceholder(0, 0, 0);
+
+	ThreadPool::shared().submit([=]()
+	{
+		std::string precompressed = TextureCube::findPrecompressed(files);
+		if (!precompressed.empty())
+		{
+			auto image = std::make_shared<ImageContainer>();
+			if (image->load(precompressed) && image->isCube())
+			{
+				StagedPixels staged = stagePixels(image->getData(), image->getDataSize());
+				queueUpload(handle, [=]()
+				{
+					image->setPixelBase(bindStaged(staged, image->getData()));
+					texture->uploadCube(*image, mipmap);
+					unbindStaged(staged);
+					return true;
+				});
+				return;
+			}
+			SAT_DEBUG_LOG_WARNING("[AssetLoader] %s is not a usable cube map, loading the faces instead", precompressed.c_str());
+		}
+
+		// A single file is an equirectangular panorama, decoded here and converted on the GPU
+		if (files.size() == 1)
+		{
+			auto panorama = std::make_shared<ImageContainer>();
+			if (!TextureCube::decodePanorama(texture->filename, *panorama))
+			{
+				SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", files[0].c_str());
+				fail(handle);
+				return;
+			}
+
+			queueUpload(handle, [=]()
+			{
+				texture->convertEquirectangular(*panorama, mipmap);
+				if (mipmap)
+				{
+					// Reading back stalls once, writing the cache happens off the main thread
+					auto cube = std::make_shared<ImageContainer>();
+					texture->readBack(*cube);
+					std::string cachePath = TextureCube::getPanoramaCachePath(texture->filename);
+					ThreadPool::shared().submit([=]()
+					{
+						if (!cube->save(cachePath))
+						{
+							SAT_DEBUG_LOG_WARNING("[AssetLoader] Could not cache %s", cachePath.c_str());
+						}
+					});
+				}
+				return true;
+			});
+			return;
+		}
+
+		std::vector<unsigned char*> faces;
+		int width, height;
+		if (!TextureCube::decodeFaces(files, faces, width, height))
+		{
+			SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", files[0].c_str());
+			fail(handle);
+			return;
+		}
+
+		queueUpload(handle, [=]()
+		{
+			texture->sizeX = width;
+			texture->sizeY = height;
+			texture->channels = 4;
+			texture->uploadFaces(faces, mipmap);
+			for (unsigned char* face : faces)
+			{
+				Texture::freeImage(face);
+			}
+			return true;
+		});
+	});
+	return handle;
+}
+
+AssetHandle AssetLoader::loadMesh(std::shared_ptr<Mesh> mesh, const std::string & file)
+{
+	AssetHandle handle = createHandle();
+
+	ThreadPool::shared().submit([=]()
+	{
+		auto vertices = std::make_shared<std::vector<vec4>>();
+		auto uvs = std::make_shared<std::vector<vec4>>();
+		auto normals = std::make_shared<std::vector<vec4>>();
+		if (!Mesh::ParseObj(file, *vertices, *uvs, *normals))
+		{
+			fail(handle);
+			return;
+		}
+
+		queueUpload(handle, [=]()
+		{
+			mesh->setData(*vertices, *uvs, *normals);
+			return true;
+		});
+	});
+	return handle;
+}
+
+void AssetLoader::update(float budgetMS)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	createStagingRing();
+	recycleStaging();
+
+	// Deferred releases are cheap, they never count against the budget
+	std::vector<std::function<void()>> tasks;
+	{
+		std::lock_guard<std::mutex> lock(_UploadMutex);
+		tasks.swap(_MainThreadTasks);
+	}
+	for (std::function<void()>& task : tasks)
+	{
+		task();
+	}
+
+	for (;;)
+	{
+		Upload next;
+		{
+			std::lock_guard<std::mutex> lock(_UploadMutex);
+			if (_Uploads.empty())
+			{
+				break;
+			}
+			next = std::move(_Uploads.front());
+			_Uploads.pop_front();
+		}
+
+		*next.state = next.upload() ? AssetState::Ready : AssetState::Failed;
+		--_NumPending;
+
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		if (elapsed.count() >= budgetMS)
+		{
+			break;
+		}
+	}
+}
+
+unsigned int AssetLoader::getNumPending()
+{
+	return _NumPending;
+}
+
+void AssetLoader::runOnMainThread(std::function<void()> task)
+{
+	if (isMainThread())
+	{
+		task();
+		return;
+	}
+	std::lock_guard<std::mutex> lock(_UploadMutex);
+	_MainThreadTasks.push_back(std::move(task));
+}
+
+bool AssetLoader::isMainThread()
+{
+	return std::this_thread::get_id() == _MainThread;
+}
+
+AssetHandle AssetLoader::createHandle()
+{
+	AssetHandle handle;
+	handle._State = std::make_shared<std::atomic<AssetState>>(AssetState::Pending);
+	++_NumPending;
+	return handle;
+}
+
+void AssetLoader::queueUpload(const AssetHandle & handle, std::function<bool()> upload)
+{
+	std::lock_guard<std::mutex> lock(_UploadMutex);
+	_Uploads.push_back({ handle._State, std::move(upload) });
+}
+
+void AssetLoader::fail(const AssetHandle & handle)
+{
+	*handle._State = AssetState::Failed;
+	--_NumPending;
+}
+
+void AssetLoader::createStagingRing()
+{
+	if (!isMainThread() || _StagingBuffer != 0)
+	{
+		return;
+	}
+
+	// Mapped once for the lifetime of the program, coherent so worker writes need no flush
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &_StagingBuffer);
+	glNamedBufferStorage(_StagingBuffer, StagingRingSize, nullptr, flags);
+	char* mapped = static_cast<char*>(glMapNamedBufferRange(_StagingBuffer, 0, StagingRingSize, flags));
+	if (mapped == nullptr)
+	{
+		// Keep the buffer so this is not retried, every upload comes from client memory instead
+		SAT_DEBUG_LOG_WARNING("[AssetLoader] Could not map the staging ring, uploading from client memory");
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(_StagingMutex);
+	_StagingMapped = mapped;
+}
+
+AssetLoader::StagedPixels AssetLoader::stagePixels(const void * pixels, size_t size)
+{
+	// Keeps every offset aligned for any pixel type glTex*SubImage reads
+	const size_t alignment = 64;
+	size_t reserved = (size + alignment - 1) & ~(alignment - 1);
+
+	StagedPixels staged;
+	char* mapped;
+	{
+		std::lock_guard<std::mutex> lock(_StagingMutex);
+		if (_StagingMapped == nullptr || reserved == 0 || reserved > StagingRingSize)
+		{
+			return staged;
+		}
+
+		// Blocks are handed back in the order they were reserved, so the free space is
+		// what lies after the newest block, wrapping around to before the oldest
+		size_t offset = 0;
+		if (!_StagingBlocks.empty())
+		{
+			const StagingBlock &oldest = _StagingBlocks.front();
+			const StagingBlock &newest = _StagingBlocks.back();
+			size_t end = newest.offset + newest.size;
+			if (newest.offset >= oldest.offset)
+			{
+				if (StagingRingSize - end >= reserved)
+				{
+					offset = end;
+				}
+				else if (oldest.offset < reserved)
+				{
+					return staged;
+				}
+			}
+			else if (oldest.offset - end >= reserved)
+			{
+				offset = end;
+			}
+			else
+			{
+				return staged;
+			}
+		}
+
+		_StagingBlocks.push_back({ offset, reserved, nullptr });
+		staged.offset = offset;
+		staged.staged = true;
+		mapped = _StagingMapped;
+	}
+
+	// The block is reserved, the copy runs without holding the lock
+	memcpy(mapped + staged.offset, pixels, size);
+	return staged;
+}
+
+const void * AssetLoader::bindStaged(const StagedPixels & staged, const void * pixels)
+{
+	if (!staged.staged)
+	{
+		return pixels;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _StagingBuffer);
+	return reinterpret_cast<const void*>(staged.offset);
+}
+
+void AssetLoader::unbindStaged(const StagedPixels & staged)
+{
+	if (!staged.staged)
+	{
+		return;
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GL_NONE);
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	std::lock_guard<std::mutex> lock(_StagingMutex);
+	for (StagingBlock &block : _StagingBlocks)
+	{
+		if (block.offset == staged.offset && block.fence == nullptr)
+		{
+			block.fence = fence;
+			return;
+		}
+	}
+	glDeleteSync(fence);
+}
+
+void AssetLoader::recycleStaging()
+{
+	std::lock_guard<std::mutex> lock(_StagingMutex);
+	while (!_StagingBlocks.empty())
+	{
+		// A block without a fence has not been uploaded yet, everything after it waits too
+		StagingBlock &oldest = _StagingBlocks.front();
+		if (oldest.fence == nullptr)
+		{
+			break;
+		}
+		GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+		glDeleteSync(oldest.fence);
+		_StagingBlocks.pop_front();
+	}
+}
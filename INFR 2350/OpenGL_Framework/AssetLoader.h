@@ -0,0 +1,130 @@
+#pragma once
+#include "GL/glew.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <thread>
+
+class Texture;
+class TextureCube;
+class Mesh;
+
+/*
+  /////////////////
+ // AssetLoader //
+/////////////////
+
+Loads textures and meshes without blocking the frame. File reading and
+decoding (SOIL, OBJ parsing) run on the shared ThreadPool, then the decoded
+data is queued for the main thread, which owns the OpenGL context. Each frame
+update() uploads queued assets until its time budget is spent.
+
+Pixel data reaches the GPU through a persistently mapped staging ring. The
+worker that decoded an image copies it straight into the ring, the main thread
+only points glTex*SubImage at that offset, and a fence placed after the upload
+hands the space back once the GPU has read it. Images larger than the ring, or
+decoded while it is full, are uploaded from client memory instead.
+
+Until an asset resolves, the object it was requested into stays usable: a
+texture holds a 1x1 placeholder color and a mesh simply draws nothing.
+Requests made through a shared_ptr keep the object alive until they finish,
+raw pointers must outlive their pending requests.
+*/
+
+enum class AssetState
+{
+	Pending,
+	Ready,
+	Failed
+};
+
+class AssetHandle
+{
+public:
+	AssetHandle() = default;
+
+	AssetState getState() const;
+	bool isReady() const;
+	bool isFailed() const;
+	bool isPending() const;
+
+private:
+	friend class AssetLoader;
+	std::shared_ptr<std::atomic<AssetState>> _State;
+};
+
+class AssetLoader
+{
+public:
+	static AssetHandle loadTexture(Texture* texture, const std::string &file, bool mipmap = true,
+		unsigned char placeholder = 255);
+	static AssetHandle loadTextureCube(TextureCube* texture, const std::vector<std::string> &files, bool mipmap = true);
+	static AssetHandle loadMesh(Mesh* mesh, const std::string &file);
+	static AssetHandle loadTexture(std::shared_ptr<Texture> texture, const std::string &file, bool mipmap = true,
+		unsigned char placeholder = 255);
+	static AssetHandle loadTextureCube(std::shared_ptr<TextureCube> texture, const std::vector<std::string> &files, bool mipmap = true);
+	static AssetHandle loadMesh(std::shared_ptr<Mesh> mesh, const std::string &file);
+
+	// Runs task right away on the main thread, otherwise queues it for the next update().
+	// Used to release OpenGL objects whose last reference was dropped on a worker.
+	static void runOnMainThread(std::function<void()> task);
+	static bool isMainThread();
+
+	// Runs pending GPU uploads on the main thread, spending at most budgetMS (at least one upload per call)
+	static void update(float budgetMS = 2.0f);
+	// Requests that have not finished uploading yet
+	static unsigned int getNumPending();
+
+private:
+	struct Upload
+	{
+		std::shared_ptr<std::atomic<AssetState>> state;
+		std::function<bool()> upload;
+	};
+
+	// Space reserved in the staging ring, recycled once fence has signaled
+	struct StagingBlock
+	{
+		size_t offset;
+		size_t size;
+		GLsync fence;
+	};
+
+	// Where stagePixels() put an image, staged is false when it stayed in client memory
+	struct StagedPixels
+	{
+		size_t offset = 0;
+		bool staged = false;
+	};
+
+	static AssetHandle createHandle();
+	static void queueUpload(const AssetHandle &handle, std::function<bool()> upload);
+	static void fail(const AssetHandle &handle);
+
+	// Main thread, creates and maps the staging ring the first time it is called
+	static void createStagingRing();
+	// Any thread, copies pixels into the staging ring if it has room for them
+	static StagedPixels stagePixels(const void* pixels, size_t size);
+	// Main thread, binds the ring for staged pixels and returns what to pass to glTex*SubImage in place of pixels
+	static const void* bindStaged(const StagedPixels &staged, const void* pixels);
+	// Main thread, unbinds the ring and fences the staged space so it is reused once the upload has been read
+	static void unbindStaged(const StagedPixels &staged);
+	// Main thread, hands back the space of every upload the GPU has finished reading
+	static void recycleStaging();
+
+	static std::mutex _UploadMutex;
+	static std::deque<Upload> _Uploads;
+	static std::atomic<unsigned int> _NumPending;
+	static std::vector<std::function<void()>> _MainThreadTasks;
+	static std::thread::id _MainThread;
+
+	static const size_t StagingRingSize = 64 * 1024 * 1024;
+	static std::mutex _StagingMutex;
+	static std::deque<StagingBlock> _StagingBlocks;
+	static unsigned int _StagingBuffer;
+	static char* _StagingMapped;
+};
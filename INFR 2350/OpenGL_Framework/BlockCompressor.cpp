@@ -0,0 +1,558 @@
+#include "BlockCompressor.h"
+#include "ImageContainer.h"
+#include "ThreadPool.h"
+#include "IO.h"
+#include <emmintrin.h>
+#include <cstring>
+#include <cfloat>
+#include <climits>
+
+namespace
+{
+	// Interpolation weights out of 64 for 4-bit BC7 indices
+	const int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Mode6Block
+	{
+		unsigned char endpoints[2][4]; // 7 bits per channel
+		int pBits[2];
+		int indices[16];
+		float error;
+	};
+
+	inline void loadRows(const unsigned char* pixels, __m128i rows[4])
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i * 16));
+		}
+	}
+
+	// One channel of the four texels in a row as floats
+	inline __m128 getChannel(__m128i row, int shift)
+	{
+		return _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(row, shift), _mm_set1_epi32(0xFF)));
+	}
+
+	// Per channel minimum and maximum of the block
+	void findBounds(const __m128i rows[4], unsigned char minColor[4], unsigned char maxColor[4])
+	{
+		__m128i low = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+		__m128i high = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+
+		// Fold the four texels of each register down to one
+		low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(2, 3, 0, 1)));
+		low = _mm_min_epu8(low, _mm_shuffle_epi32(low, _MM_SHUFFLE(1, 0, 3, 2)));
+		high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(2, 3, 0, 1)));
+		high = _mm_max_epu8(high, _mm_shuffle_epi32(high, _MM_SHUFFLE(1, 0, 3, 2)));
+
+		int packedLow = _mm_cvtsi128_si32(low);
+		int packedHigh = _mm_cvtsi128_si32(high);
+		memcpy(minColor, &packedLow, 4);
+		memcpy(maxColor, &packedHigh, 4);
+	}
+
+	// Pulls the bounding box in by 1/16 of its size, the extremes are rarely the best endpoints
+	// (J.M.P. van Waveren, "Real-Time DXT Compression")
+	void insetBounds(unsigned char minColor[4], unsigned char maxColor[4], int numChannels)
+	{
+		for (int c = 0; c < numChannels; ++c)
+		{
+			int inset = (maxColor[c] - minColor[c]) >> 4;
+			minColor[c] = (unsigned char)(minColor[c] + inset);
+			maxColor[c] = (unsigned char)(maxColor[c] - inset);
+		}
+	}
+
+	// Projects every texel onto the line from start to end, returning the nearest of numSteps + 1 evenly
+	// spaced positions along it (0 at start)
+	void projectIndices(const __m128i rows[4], const float start[4], const float end[4], int numSteps, int indices[16])
+	{
+		float dir[4];
+		float lengthSq = 0.0f;
+		float startDot = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			dir[c] = end[c] - start[c];
+			lengthSq += dir[c] * dir[c];
+			startDot += start[c] * dir[c];
+		}
+		if (lengthSq < 1.0f)
+		{
+			memset(indices, 0, sizeof(int) * 16);
+			return;
+		}
+
+		float scale = numSteps / lengthSq;
+		__m128 dirR = _mm_set1_ps(dir[0] * scale);
+		__m128 dirG = _mm_set1_ps(dir[1] * scale);
+		__m128 dirB = _mm_set1_ps(dir[2] * scale);
+		__m128 dirA = _mm_set1_ps(dir[3] * scale);
+		__m128 offset = _mm_set1_ps(startDot * scale);
+		__m128 lowest = _mm_setzero_ps();
+		__m128 highest = _mm_set1_ps((float)numSteps);
+
+		for (int row = 0; row < 4; ++row)
+		{
+			__m128 t = _mm_mul_ps(getChannel(rows[row], 0), dirR);
+			t = _mm_add_ps(t, _mm_mul_ps(getChannel(rows[row], 8), dirG));
+			t = _mm_add_ps(t, _mm_mul_ps(getChannel(rows[row], 16), dirB));
+			t = _mm_add_ps(t, _mm_mul_ps(getChannel(rows[row], 24), dirA));
+			t = _mm_min_ps(_mm_max_ps(_mm_sub_ps(t, offset), lowest), highest);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(indices + row * 4), _mm_cvtps_epi32(t));
+		}
+	}
+
+	inline unsigned short packRGB565(const unsigned char color[4])
+	{
+		int r = (color[0] * 31 + 127) / 255;
+		int g = (color[1] * 63 + 127) / 255;
+		int b = (color[2] * 31 + 127) / 255;
+		return (unsigned short)((r << 11) | (g << 5) | b);
+	}
+
+	inline void unpackRGB565(unsigned short packed, float color[4])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (float)((r << 3) | (r >> 2));
+		color[1] = (float)((g << 2) | (g >> 4));
+		color[2] = (float)((b << 3) | (b >> 2));
+		color[3] = 0.0f;
+	}
+
+	inline void writeBits(unsigned char* block, int &position, unsigned int value, int numBits)
+	{
+		for (int i = 0; i < numBits; ++i, ++position)
+		{
+			if ((value >> i) & 1)
+			{
+				block[position >> 3] |= (unsigned char)(1 << (position & 7));
+			}
+		}
+	}
+
+	// Mode 6 stores 7 bits per channel, the p-bit supplies the shared lowest bit of each endpoint
+	void quantizeMode6Endpoint(const float value[4], unsigned char quantized[4], int &pBit)
+	{
+		float bestError = FLT_MAX;
+		for (int p = 0; p < 2; ++p)
+		{
+			unsigned char candidate[4];
+			float error = 0.0f;
+			for (int c = 0; c < 4; ++c)
+			{
+				int q = (int)((value[c] - p) * 0.5f + 0.5f);
+				q = q < 0 ? 0 : (q > 127 ? 127 : q);
+				candidate[c] = (unsigned char)q;
+				float difference = (float)((q << 1) | p) - value[c];
+				error += difference * difference;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				memcpy(quantized, candidate, 4);
+				pBit = p;
+			}
+		}
+	}
+
+	void encodeMode6(const unsigned char* pixels, const __m128i rows[4], const float endpoints[2][4], Mode6Block &result)
+	{
+		int expanded[2][4];
+		float start[4], end[4];
+		for (int e = 0; e < 2; ++e)
+		{
+			quantizeMode6Endpoint(endpoints[e], result.endpoints[e], result.pBits[e]);
+			for (int c = 0; c < 4; ++c)
+			{
+				expanded[e][c] = (result.endpoints[e][c] << 1) | result.pBits[e];
+			}
+		}
+		for (int c = 0; c < 4; ++c)
+		{
+			start[c] = (float)expanded[0][c];
+			end[c] = (float)expanded[1][c];
+		}
+
+		int palette[16][4];
+		for (int i = 0; i < 16; ++i)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				palette[i][c] = ((64 - BC7Weights[i]) * expanded[0][c] + BC7Weights[i] * expanded[1][c] + 32) >> 6;
+			}
+		}
+
+		int projected[16];
+		projectIndices(rows, start, end, 15, projected);
+
+		// The weights are not evenly spaced, so the neighbours of the projected index are checked as well
+		result.error = 0.0f;
+		for (int i = 0; i < 16; ++i)
+		{
+			const unsigned char* texel = pixels + i * 4;
+			int bestIndex = projected[i];
+			int bestError = INT_MAX;
+			for (int index = projected[i] - 1; index <= projected[i] + 1; ++index)
+			{
+				if (index < 0 || index > 15)
+				{
+					continue;
+				}
+				int error = 0;
+				for (int c = 0; c < 4; ++c)
+				{
+					int difference = palette[index][c] - texel[c];
+					error += difference * difference;
+				}
+				if (error < bestError)
+				{
+					bestError = error;
+					bestIndex = index;
+				}
+			}
+			result.indices[i] = bestIndex;
+			result.error += (float)bestError;
+		}
+	}
+
+	// Least squares fit of both endpoints to the texels, keeping their current index assignment
+	bool solveEndpoints(const unsigned char* pixels, const int indices[16], float endpoints[2][4])
+	{
+		float a = 0.0f, b = 0.0f, c = 0.0f;
+		float x[4] = { 0.0f }, y[4] = { 0.0f };
+		for (int i = 0; i < 16; ++i)
+		{
+			float weight = BC7Weights[indices[i]] / 64.0f;
+			float inverse = 1.0f - weight;
+			a += inverse * inverse;
+			b += inverse * weight;
+			c += weight * weight;
+			for (int channel = 0; channel < 4; ++channel)
+			{
+				x[channel] += inverse * pixels[i * 4 + channel];
+				y[channel] += weight * pixels[i * 4 + channel];
+			}
+		}
+
+		float determinant = a * c - b * b;
+		if (determinant > -1e-6f && determinant < 1e-6f)
+		{
+			return false;
+		}
+		float inverseDeterminant = 1.0f / determinant;
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			float start = (c * x[channel] - b * y[channel]) * inverseDeterminant;
+			float end = (a * y[channel] - b * x[channel]) * inverseDeterminant;
+			endpoints[0][channel] = start < 0.0f ? 0.0f : (start > 255.0f ? 255.0f : start);
+			endpoints[1][channel] = end < 0.0f ? 0.0f : (end > 255.0f ? 255.0f : end);
+		}
+		return true;
+	}
+
+	void writeMode6(Mode6Block mode6, unsigned char* block)
+	{
+		// The first index is stored without its top bit, so it must be below 8
+		if (mode6.indices[0] & 8)
+		{
+			for (int c = 0; c < 4; ++c)
+			{
+				unsigned char swap = mode6.endpoints[0][c];
+				mode6.endpoints[0][c] = mode6.endpoints[1][c];
+				mode6.endpoints[1][c] = swap;
+			}
+			int swapPBit = mode6.pBits[0];
+			mode6.pBits[0] = mode6.pBits[1];
+			mode6.pBits[1] = swapPBit;
+			for (int i = 0; i < 16; ++i)
+			{
+				mode6.indices[i] = 15 - mode6.indices[i];
+			}
+		}
+
+		memset(block, 0, 16);
+		int position = 0;
+		writeBits(block, position, 1 << 6, 7);
+		for (int c = 0; c < 4; ++c)
+		{
+			writeBits(block, position, mode6.endpoints[0][c], 7);
+			writeBits(block, position, mode6.endpoints[1][c], 7);
+		}
+		writeBits(block, position, mode6.pBits[0], 1);
+		writeBits(block, position, mode6.pBits[1], 1);
+		writeBits(block, position, mode6.indices[0], 3);
+		for (int i = 1; i < 16; ++i)
+		{
+			writeBits(block, position, mode6.indices[i], 4);
+		}
+	}
+}
+
+bool BlockCompressor::compress(const unsigned char * pixels, int width, int height, GLenum format, bool mipmap, ImageContainer & image)
+{
+	if (!isSupportedFormat(format))
+	{
+		SAT_DEBUG_LOG_ERROR("[BlockCompressor] Unsupported format 0x%X", format);
+		return false;
+	}
+
+	int numLevels = mipmap ? ImageContainer::countMipLevels(width, height) : 1;
+	image.create(format, width, height, numLevels);
+
+	const unsigned char* source = pixels;
+	std::vector<unsigned char> mip, nextMip;
+	for (int level = 0; level < numLevels; ++level)
+	{
+		const ImageLevel& data = image.getLevel(level);
+		compressLevel(source, data.width, data.height, format, reinterpret_cast<unsigned char*>(image.getLevelData(level)));
+
+		if (level + 1 < numLevels)
+		{
+			downsample(source, data.width, data.height, nextMip);
+			mip.swap(nextMip);
+			source = mip.data();
+		}
+	}
+	return true;
+}
+
+bool BlockCompressor::isSupportedFormat(GLenum format)
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool BlockCompressor::hasAlpha(const unsigned char * pixels, int width, int height)
+{
+	size_t numBytes = (size_t)width * height * 4;
+	size_t i = 0;
+
+	const __m128i alphaMask = _mm_set1_epi32((int)0xFF000000);
+	for (; i + 16 <= numBytes; i += 16)
+	{
+		__m128i texels = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i)), alphaMask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(texels, alphaMask)) != 0xFFFF)
+		{
+			return true;
+		}
+	}
+	for (; i < numBytes; i += 4)
+	{
+		if (pixels[i + 3] != 255)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void BlockCompressor::downsample(const unsigned char * pixels, int width, int height, std::vector<unsigned char>& result)
+{
+	int newWidth = (std::max)(1, width / 2);
+	int newHeight = (std::max)(1, height / 2);
+	result.resize((size_t)newWidth * newHeight * 4);
+	unsigned char* output = result.data();
+
+	ThreadPool::shared().parallelFor(newHeight, [=](unsigned int begin, unsigned int end)
+	{
+		for (int y = (int)begin; y < (int)end; ++y)
+		{
+			const unsigned char* row0 = pixels + (size_t)(std::min)(y * 2, height - 1) * width * 4;
+			const unsigned char* row1 = pixels + (size_t)(std::min)(y * 2 + 1, height - 1) * width * 4;
+			for (int x = 0; x < newWidth; ++x)
+			{
+				int x0 = (std::min)(x * 2, width - 1) * 4;
+				int x1 = (std::min)(x * 2 + 1, width - 1) * 4;
+				unsigned char* texel = output + ((size_t)y * newWidth + x) * 4;
+				for (int c = 0; c < 4; ++c)
+				{
+					texel[c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+				}
+			}
+		}
+	}, 16);
+}
+
+void BlockCompressor::compressBC1Block(const unsigned char * pixels, unsigned char * block)
+{
+	__m128i rows[4];
+	loadRows(pixels, rows);
+
+	unsigned char minColor[4], maxColor[4];
+	findBounds(rows, minColor, maxColor);
+	insetBounds(minColor, maxColor, 3);
+
+	unsigned short color0 = packRGB565(maxColor);
+	unsigned short color1 = packRGB565(minColor);
+	unsigned int indices = 0;
+
+	if (color0 != color1)
+	{
+		// Four color mode needs color0 > color1
+		if (color0 < color1)
+		{
+			unsigned short swap = color0;
+			color0 = color1;
+			color1 = swap;
+		}
+
+		// Project onto the endpoints as the GPU will decode them
+		float start[4], end[4];
+		unpackRGB565(color1, start);
+		unpackRGB565(color0, end);
+		int steps[16];
+		projectIndices(rows, start, end, 3, steps);
+
+		// Step 0 is color1, step 3 is color0, 1 and 2 are the interpolated colors
+		const unsigned int stepToIndex[4] = { 1, 3, 2, 0 };
+		for (int i = 0; i < 16; ++i)
+		{
+			indices |= stepToIndex[steps[i]] << (i * 2);
+		}
+	}
+
+	block[0] = (unsigned char)(color0 & 0xFF);
+	block[1] = (unsigned char)(color0 >> 8);
+	block[2] = (unsigned char)(color1 & 0xFF);
+	block[3] = (unsigned char)(color1 >> 8);
+	for (int i = 0; i < 4; ++i)
+	{
+		block[4 + i] = (unsigned char)(indices >> (i * 8));
+	}
+}
+
+void BlockCompressor::compressBC3Block(const unsigned char * pixels, unsigned char * block)
+{
+	compressBC4Block(pixels, 3, block);
+	compressBC1Block(pixels, block + 8);
+}
+
+void BlockCompressor::compressBC4Block(const unsigned char * pixels, int channel, unsigned char * block)
+{
+	int minValue = 255, maxValue = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		int value = pixels[i * 4 + channel];
+		minValue = value < minValue ? value : minValue;
+		maxValue = value > maxValue ? value : maxValue;
+	}
+
+	block[0] = (unsigned char)maxValue;
+	block[1] = (unsigned char)minValue;
+
+	unsigned long long indices = 0;
+	int range = maxValue - minValue;
+	if (range > 0)
+	{
+		// With value0 > value1 there are six interpolated steps between the endpoints
+		for (int i = 0; i < 16; ++i)
+		{
+			int step = ((pixels[i * 4 + channel] - minValue) * 7 + range / 2) / range;
+			unsigned long long index = step == 7 ? 0 : (step == 0 ? 1 : 8 - step);
+			indices |= index << (i * 3);
+		}
+	}
+	for (int i = 0; i < 6; ++i)
+	{
+		block[2 + i] = (unsigned char)(indices >> (i * 8));
+	}
+}
+
+void BlockCompressor::compressBC5Block(const unsigned char * pixels, unsigned char * block)
+{
+	compressBC4Block(pixels, 0, block);
+	compressBC4Block(pixels, 1, block + 8);
+}
+
+void BlockCompressor::compressBC7Block(const unsigned char * pixels, unsigned char * block)
+{
+	__m128i rows[4];
+	loadRows(pixels, rows);
+
+	unsigned char minColor[4], maxColor[4];
+	findBounds(rows, minColor, maxColor);
+	insetBounds(minColor, maxColor, 4);
+
+	float endpoints[2][4];
+	for (int c = 0; c < 4; ++c)
+	{
+		endpoints[0][c] = minColor[c];
+		endpoints[1][c] = maxColor[c];
+	}
+
+	Mode6Block best;
+	encodeMode6(pixels, rows, endpoints, best);
+
+	Mode6Block refined;
+	if (best.error > 0.0f && solveEndpoints(pixels, best.indices, endpoints))
+	{
+		encodeMode6(pixels, rows, endpoints, refined);
+		if (refined.error < best.error)
+		{
+			best = refined;
+		}
+	}
+
+	writeMode6(best, block);
+}
+
+void BlockCompressor::compressLevel(const unsigned char * pixels, int width, int height, GLenum format, unsigned char * output)
+{
+	int blocksX = (width + 3) / 4;
+	int blocksY = (height + 3) / 4;
+	size_t blockSize = ImageContainer::calculateLevelSize(format, 4, 4);
+
+	ThreadPool::shared().parallelFor(blocksY, [=](unsigned int begin, unsigned int end)
+	{
+		unsigned char texels[64];
+		for (int blockY = (int)begin; blockY < (int)end; ++blockY)
+		{
+			for (int blockX = 0; blockX < blocksX; ++blockX)
+			{
+				// Blocks hanging over the edge repeat the last row and column
+				for (int y = 0; y < 4; ++y)
+				{
+					int sourceY = (std::min)(blockY * 4 + y, height - 1);
+					for (int x = 0; x < 4; ++x)
+					{
+						int sourceX = (std::min)(blockX * 4 + x, width - 1);
+						memcpy(texels + (y * 4 + x) * 4, pixels + ((size_t)sourceY * width + sourceX) * 4, 4);
+					}
+				}
+
+				unsigned char* block = output + ((size_t)blockY * blocksX + blockX) * blockSize;
+				switch (format)
+				{
+				case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+					compressBC3Block(texels, block);
+					break;
+				case GL_COMPRESSED_RED_RGTC1:
+					compressBC4Block(texels, 0, block);
+					break;
+				case GL_COMPRESSED_RG_RGTC2:
+					compressBC5Block(texels, block);
+					break;
+				case GL_COMPRESSED_RGBA_BPTC_UNORM:
+					compressBC7Block(texels, block);
+					break;
+				default:
+					compressBC1Block(texels, block);
+					break;
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "GL/glew.h"
+#include <vector>
+
+class ImageContainer;
+
+/*
+	///// // BlockCompressor // /////
+
+	CPU encoder for block compressed textures, used when an image has no precompressed .dds/.ktx2.
+
+	BC1 / BC3	Fast. Bounding box endpoints inset by 1/16, texels projected onto the endpoint line.
+	BC4 / BC5	Single and dual channel versions of the BC3 alpha block, for masks and normals.
+	BC7			Quality. Mode 6 only (RGBA endpoints with per-endpoint p-bits and 4-bit indices),
+				refined with one least squares pass over the endpoints.
+
+	Endpoint search and index selection work on a whole block at once with SSE2.
+	Rows of blocks are spread across ThreadPool::shared(), so compress() may be called from a job.
+*/
+
+class BlockCompressor
+{
+public:
+	// Compresses RGBA8 pixels, plus a box filtered mip chain if mipmap is set, into image.
+	// format must be one that isSupportedFormat() accepts.
+	static bool compress(const unsigned char* pixels, int width, int height, GLenum format, bool mipmap, ImageContainer &image);
+	static bool isSupportedFormat(GLenum format);
+	// Compresses a single RGBA8 level into output, which must hold ImageContainer::calculateLevelSize() bytes
+	static void compressLevel(const unsigned char* pixels, int width, int height, GLenum format, unsigned char* output);
+
+	// True if any pixel of an RGBA8 image is not fully opaque
+	static bool hasAlpha(const unsigned char* pixels, int width, int height);
+	// Box filters an RGBA8 image down to half size, odd edges are clamped
+	static void downsample(const unsigned char* pixels, int width, int height, std::vector<unsigned char> &result);
+
+	// Single blocks, pixels are the 16 RGBA8 texels of a 4x4 block in row order
+	static void compressBC1Block(const unsigned char* pixels, unsigned char* block);
+	static void compressBC3Block(const unsigned char* pixels, unsigned char* block);
+	static void compressBC4Block(const unsigned char* pixels, int channel, unsigned char* block);
+	static void compressBC5Block(const unsigned char* pixels, unsigned char* block);
+	static void compressBC7Block(const unsigned char* pixels, unsigned char* block);
+};
@@ -1,10 +1,50 @@
 #include "Camera.h"
 #include "ResourceManager.h"
+#include "ShaderProgram.h"
+#include "HiZCuller.h"
+#include "DepthRasterizer.h"
+#include "OcclusionQueries.h"
+#include "Frustum.h"
 #include "IO.h"
+#include "ThreadPool.h"
 #include <algorithm>
 
 Camera* activeCamera;
-vec3 activeCameraPosition;
+
+namespace
+{
+	// Objects per job in the culling and sorting loops
+	const unsigned int CullGrainSize = 256;
+
+	// Keeps the objects keep returns true for, in order. Each chunk fills a list of its own,
+	// and the lists are joined after, so no job waits on another.
+	template<typename Predicate>
+	void parallelFilter(std::vector<Transform*> &objects, Predicate keep)
+	{
+		unsigned int numChunks = ((unsigned int)objects.size() + CullGrainSize - 1) / CullGrainSize;
+		std::vector<std::vector<Transform*>> kept(numChunks);
+		ThreadPool::shared().parallelFor(numChunks, [&](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int chunk = begin; chunk < end; ++chunk)
+			{
+				size_t last = (std::min)(objects.size(), (size_t)(chunk + 1) * CullGrainSize);
+				for (size_t i = (size_t)chunk * CullGrainSize; i < last; ++i)
+				{
+					if (keep(objects[i]))
+					{
+						kept[chunk].push_back(objects[i]);
+					}
+				}
+			}
+		});
+
+		objects.clear();
+		for (const std::vector<Transform*>& list : kept)
+		{
+			objects.insert(objects.end(), list.begin(), list.end());
+		}
+	}
+}
 
 Camera::Camera()
 {
@@ -25,6 +65,7 @@ void Camera::perspective(float fovy, float aspect, float zNear, float zFar)
 	m_pProjection = mat4::PerspectiveProjection(
 		fovy, aspect, 
 		zNear, zFar);
+	m_pUnjitteredProjection = m_pProjection;
 
 	m_pAspectRatio = aspect;
 	m_pNear = zNear;
@@ -40,6 +81,7 @@ void Camera::orthographic(float left, float right, float bottom, float top, floa
 		left, right, 
 		top, bottom,
 		zNear, zFar);
+	m_pUnjitteredProjection = m_pProjection;
 
 	m_pOrthoSize = vec4(left, right, top, bottom);
 	m_pAspectRatio = (right - left) / (top - bottom);
@@ -47,6 +89,22 @@ void Camera::orthographic(float left, float right, float bottom, float top, floa
 	m_pFar = zFar;
 }
 
+void Camera::setJitter(const vec2 & ndcOffset)
+{
+	m_pProjection = m_pUnjitteredProjection;
+	if (m_pProjectionType == ProjectionType::Perspective)
+	{
+		// Clip space w is -z, so the shift is scaled by depth and lands as a constant in NDC
+		m_pProjection[mat4::ForwardX] -= ndcOffset.x;
+		m_pProjection[mat4::ForwardY] -= ndcOffset.y;
+	}
+	else
+	{
+		m_pProjection[mat4::TransX] += ndcOffset.x;
+		m_pProjection[mat4::TransY] += ndcOffset.y;
+	}
+}
+
 mat4 Camera::getView() const
 {
 	return m_pViewMatrix;
@@ -62,6 +120,16 @@ mat4 Camera::getProjection() const
 	return m_pProjection;
 }
 
+mat4 Camera::getUnjitteredViewProjection() const
+{
+	return m_pUnjitteredProjection * m_pViewMatrix;
+}
+
+mat4 Camera::getPreviousViewProjection() const
+{
+	return m_pPreviousViewProjection;
+}
+
 mat4* Camera::getViewProjectionPtr() 
 {
 	return &m_pProjection;
@@ -69,12 +137,21 @@ mat4* Camera::getViewProjectionPtr()
 
 void Camera::update(float dt)
 {
+	m_pPreviousViewProjection = getUnjitteredViewProjection();
 	Transform::update(dt); // original inherited update function
 	m_pViewMatrix = m_pLocalToWorld.GetFastInverse();
+}
 
-	objectList = ResourceManager::Transforms;
-	cull();
-	sort();
+void Camera::cullCameras(const std::vector<Camera*>& cameras)
+{
+	ThreadPool::shared().parallelFor((unsigned int)cameras.size(), [&cameras](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			cameras[i]->cull();
+			cameras[i]->sort();
+		}
+	});
 }
 
 void Camera::draw()
@@ -82,60 +159,240 @@ void Camera::draw()
 
 }
 
-void Camera::render()
+void Camera::renderDepth(const ShaderProgram & program)
 {
-	activeCamera = this;
-	activeCameraPosition = getLocalToWorld().GetTranslation();
-	for (Transform* object : cullList)
+	// Depth only, the fragment shader writes nothing the color attachments should keep
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	program.bind();
+	if (occlusionCuller)
 	{
-		object->draw();
+		occlusionCuller->bindCommands();
 	}
+	depthList.assign(cullList.size(), false);
+	for (size_t i = 0; i < cullList.size(); ++i)
+	{
+		GLintptr command = occlusionCuller ? occlusionCuller->getCommand(i) : -1;
+		if (command >= 0)
+		{
+			depthList[i] = cullList[i]->drawDepthIndirect(program, (size_t)command);
+		}
+		else if (!occlusionCuller || !occlusionCuller->isSecondPhase())
+		{
+			depthList[i] = cullList[i]->drawDepth(program);
+		}
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
 }
 
-void Camera::cull()
+void Camera::render()
 {
-	cullList.clear();
-	if (cullingActive)
+	activeCamera = this;
+	vec3 eye = getLocalToWorld().GetTranslation();
+	// Objects in the pre-pass only pass the depth test where they are the closest surface.
+	// Their depth is already written, the rest still test and write it as usual.
+	bool prepassed = false;
+	// Objects that are not culled draw directly, in the first phase only
+	bool secondPhase = occlusionCuller && occlusionCuller->isSecondPhase();
+	if (occlusionCuller)
+	{
+		occlusionCuller->bindCommands();
+	}
+	for (size_t i = 0; i < cullList.size(); ++i)
 	{
-		if (m_pProjectionType == Perspective)
+		GLintptr command = occlusionCuller ? occlusionCuller->getCommand(i) : -1;
+		if (command < 0 && secondPhase)
 		{
-			// assuming aspect ratio is bigger on X than Y
-			for (Transform* object : objectList)
-			{
-				vec3 direction = this->m_pLocalToWorld.GetTranslation() - object->m_pLocalToWorld.GetTranslation();
-				direction.Normalize();
-				if (Dot(direction, this->m_pLocalToWorld.GetForward()) > cos(ToRadians(m_pFov.x * 0.5f * 1.4f)))
-				{
-					cullList.push_back(object);
-				}
-			}
+			continue;
+		}
+
+		bool inDepthList = i < depthList.size() && depthList[i];
+		if (inDepthList != prepassed)
+		{
+			prepassed = inDepthList;
+			glDepthFunc(prepassed ? GL_EQUAL : GL_LESS);
+			glDepthMask(prepassed ? GL_FALSE : GL_TRUE);
+		}
+		if (command >= 0)
+		{
+			cullList[i]->drawIndirect((size_t)command);
+		}
+		else if (occlusionQueries)
+		{
+			occlusionQueries->draw(*cullList[i], eye, m_pNear);
 		}
 		else
 		{
-			for (Transform* object : objectList)
+			cullList[i]->draw();
+		}
+	}
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, GL_NONE);
+	glDepthFunc(GL_LESS);
+	glDepthMask(GL_TRUE);
+	depthList.clear();
+}
+
+void Camera::cull()
+{
+	// Jitter moves the view a fraction of a pixel every frame, which culling does not care about
+	mat4 viewProjection = getUnjitteredViewProjection();
+	bool viewChanged = false;
+	for (unsigned i = 0; i < 16 && !viewChanged; ++i)
+	{
+		viewChanged = fabsf(viewProjection[i] - culledViewProjection[i]) > recullTolerance;
+	}
+	unsigned int sceneVersion = ResourceManager::SceneVersion;
+	// ChangedTransforms only covers the last scene update
+	bool missedChanges = sceneVersion != culledSceneVersion && sceneVersion != culledSceneVersion + 1;
+	bool sceneChanged = sceneVersion != culledSceneVersion && !ResourceManager::ChangedTransforms.empty();
+	bool settingsChanged = !hasCulled || cullingActive != culledWithCulling || depthRasterizer != culledWithRasterizer;
+	// An occluder moving changes what everything else is tested against
+	bool occludersChanged = false;
+	if (sceneChanged && depthRasterizer != nullptr)
+	{
+		for (Transform* object : ResourceManager::ChangedTransforms)
+		{
+			if (object->getOccluderMesh() != nullptr)
 			{
-				cullList.push_back(object);
+				occludersChanged = true;
+				break;
 			}
 		}
 	}
+
+	if (viewChanged || missedChanges || settingsChanged || occludersChanged)
+	{
+		cullAll(viewProjection);
+		culledViewProjection = viewProjection;
+		cullListChanged = true;
+	}
+	else if (sceneChanged)
+	{
+		cullChanged();
+		cullListChanged = true;
+	}
 	else
 	{
-		for (Transform* object : objectList)
+		cullListChanged = false;
+	}
+
+	culledSceneVersion = sceneVersion;
+	culledWithCulling = cullingActive;
+	culledWithRasterizer = depthRasterizer;
+	hasCulled = true;
+}
+
+void Camera::cullAll(const mat4 & viewProjection)
+{
+	cullCandidates.clear();
+	if (cullingActive)
+	{
+		ResourceManager::SceneTree.queryFrustum(Frustum(viewProjection), cullCandidates);
+		// Objects without bounds are always kept
+		cullCandidates.insert(cullCandidates.end(), ResourceManager::UnboundedTransforms.begin(), ResourceManager::UnboundedTransforms.end());
+	}
+	else
+	{
+		cullCandidates = ResourceManager::Transforms;
+	}
+
+	if (depthRasterizer != nullptr)
+	{
+		depthRasterizer->render(cullCandidates, viewProjection);
+		// Occluders are tested too, they may be hidden by others
+		parallelFilter(cullCandidates, [this](Transform* object)
 		{
-			cullList.push_back(object);
-		}
+			vec3 boundsMin, boundsMax;
+			return !object->getWorldBounds(boundsMin, boundsMax) || depthRasterizer->isVisible(boundsMin, boundsMax);
+		});
 	}
+
+	// Objects still visible keep last frame's order, so sort() starts from nearly sorted
+	std::unordered_set<Transform*> previous;
+	previous.swap(visibleSet);
+	visibleSet.insert(cullCandidates.begin(), cullCandidates.end());
+	parallelFilter(cullList, [this](Transform* object)
+	{
+		return visibleSet.count(object) != 0;
+	});
+	parallelFilter(cullCandidates, [&previous](Transform* object)
+	{
+		return previous.count(object) == 0;
+	});
+	cullList.insert(cullList.end(), cullCandidates.begin(), cullCandidates.end());
 }
 
-struct
+void Camera::cullChanged()
 {
-	bool operator()(Transform* a, Transform* b) const
+	const std::vector<Transform*>& changed = ResourceManager::ChangedTransforms;
+	Frustum frustum(culledViewProjection);
+	changedVisible.resize(changed.size());
+	ThreadPool::shared().parallelFor((unsigned int)changed.size(), [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			// The depth buffer still holds the occluders as cullAll() drew them, none of them moved since
+			vec3 boundsMin, boundsMax;
+			changedVisible[i] = !changed[i]->getWorldBounds(boundsMin, boundsMax) ||
+				((!cullingActive || frustum.isVisible(boundsMin, boundsMax)) && (depthRasterizer == nullptr || depthRasterizer->isVisible(boundsMin, boundsMax)));
+		}
+	}, CullGrainSize);
+
+	bool removed = false;
+	for (size_t i = 0; i < changed.size(); ++i)
+	{
+		bool wasVisible = visibleSet.count(changed[i]) != 0;
+		if (changedVisible[i] && !wasVisible)
+		{
+			visibleSet.insert(changed[i]);
+			cullList.push_back(changed[i]);
+		}
+		else if (!changedVisible[i] && wasVisible)
+		{
+			visibleSet.erase(changed[i]);
+			removed = true;
+		}
+	}
+
+	if (removed)
 	{
-		return (Distance(a->getLocalToWorld().GetTranslation(), activeCameraPosition) < Distance(b->getLocalToWorld().GetTranslation(), activeCameraPosition));
+		parallelFilter(cullList, [this](Transform* object)
+		{
+			return visibleSet.count(object) != 0;
+		});
 	}
-} customSort;
+}
+
+const std::vector<Transform*>& Camera::getCullList() const
+{
+	return cullList;
+}
 
 void Camera::sort()
 {
-	std::sort(cullList.begin(), cullList.end(), customSort);
+	// Nothing moved, last frame's order still holds
+	if (!cullListChanged)
+	{
+		return;
+	}
+
+	vec3 eye = getLocalToWorld().GetTranslation();
+	renderQueue.resize(cullList.size());
+	ThreadPool::shared().parallelFor((unsigned int)cullList.size(), [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			// Distance to the centre of the bounds where there are any, one square root per object
+			Transform* object = cullList[i];
+			vec3 boundsMin, boundsMax;
+			vec3 center = object->getWorldBounds(boundsMin, boundsMax) ? (boundsMin + boundsMax) * 0.5f : object->getLocalToWorld().GetTranslation();
+			renderQueue.set(i, object, object->getRenderState(), Distance(center, eye) / m_pFar);
+		}
+	}, CullGrainSize);
+	renderQueue.sortIncremental();
+
+	for (size_t i = 0; i < renderQueue.size(); ++i)
+	{
+		cullList[i] = renderQueue[i];
+	}
 }
@@ -2,6 +2,11 @@
 #include "Transform.h"
 #include "Framebuffer.h"
 #include <vector>
+#include <unordered_set>
+
+class HiZCuller;
+class DepthRasterizer;
+class OcclusionQueries;
 
 enum ProjectionType
 {
@@ -29,21 +34,57 @@ public:
 		m_pFB = fb;
 	}
 
+	// Offsets the projection by a fraction of a pixel, in normalized device coordinates.
+	// Cleared by perspective() and orthographic().
+	void setJitter(const vec2 &ndcOffset);
+
 	mat4 getView() const;
 	mat4 getViewProjection() const;
 	mat4 getProjection() const;
+	// Without jitter, for motion vectors
+	mat4 getUnjitteredViewProjection() const;
+	// Unjittered view projection of the previous update
+	mat4 getPreviousViewProjection() const;
 	mat4* getViewProjectionPtr();
+	// Updates the view, the draws are culled and sorted by cullCameras()
 	void update(float dt);
 	void draw();
+	// Lays down the depth of the opaque objects in cullList with program, so render() only shades what is visible.
+	// Lasts until the next render().
+	void renderDepth(const ShaderProgram &program);
 	void render();
 
+	// Keeps the cull list from the last call, re-testing only the objects that changed since, unless
+	// the view moved past recullTolerance, the culling settings changed or an occluder moved
 	void cull();
+	// Orders the cull list by each object's RenderQueue key, grouping state and opaque objects front to back.
+	// Starts from last frame's order, and does nothing if the cull list did not change.
 	void sort();
+	// What render() draws, in order
+	const std::vector<Transform*>& getCullList() const;
+	// Culls and sorts each camera's draws, the cameras concurrently on ThreadPool::shared().
+	// Call after ResourceManager::updateScene(). Cameras only read the scene, but must not share a depthRasterizer.
+	static void cullCameras(const std::vector<Camera*> &cameras);
 
-	bool cullingActive = false;
+	// Drops objects whose bounds are outside the frustum, see ResourceManager::SceneTree
+	bool cullingActive = true;
+	// Draws the cull list through the culler's indirect commands for its current phase
+	HiZCuller* occlusionCuller = nullptr;
+	// Draws the occluders in the cull list on the CPU and drops what they hide from it
+	DepthRasterizer* depthRasterizer = nullptr;
+	// Draws heavy objects that do not go through occlusionCuller behind queries on their bounding boxes
+	OcclusionQueries* occlusionQueries = nullptr;
+	// Largest change in any element of the unjittered view projection that keeps the last cull
+	float recullTolerance = 1.0e-5f;
 private:
+	void cullAll(const mat4 &viewProjection);
+	// Re-tests ResourceManager::ChangedTransforms against the last frustum and occluder depth
+	void cullChanged();
+
 	mat4 m_pProjection;
+	mat4 m_pUnjitteredProjection;
 	mat4 m_pViewMatrix;
+	mat4 m_pPreviousViewProjection;
 		
 	vec4 m_pOrthoSize;
 	vec2 m_pFov; 
@@ -52,7 +93,21 @@ private:
 	float m_pFar;
 	ProjectionType m_pProjectionType = ProjectionType::Perspective;
 
-	std::vector<Transform*> objectList;
 	std::vector<Transform*> cullList;
+	RenderQueue renderQueue;
+	// What cullList holds, and what it was culled with
+	std::unordered_set<Transform*> visibleSet;
+	std::vector<Transform*> cullCandidates;
+	// Parallel to ResourceManager::ChangedTransforms in cullChanged()
+	std::vector<unsigned char> changedVisible;
+	mat4 culledViewProjection;
+	unsigned int culledSceneVersion = 0;
+	bool culledWithCulling = false;
+	DepthRasterizer* culledWithRasterizer = nullptr;
+	bool hasCulled = false;
+	// Whether sort() has anything to do
+	bool cullListChanged = false;
+	// Parallel to cullList, objects whose depth renderDepth() already wrote
+	std::vector<bool> depthList;
 	Framebuffer* m_pFB;
 };
\ No newline at end of file
@@ -0,0 +1,317 @@
+#include "DepthRasterizer.h"
+#include "Transform.h"
+#include "Mesh.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <emmintrin.h>
+
+DepthRasterizer::DepthRasterizer()
+	: _Depth(Width * Height, 1.0f), _BlockDepth(BlocksX * BlocksY, 1.0f), _Bins(TilesX * TilesY)
+{
+}
+
+void DepthRasterizer::render(const std::vector<Transform*>& objects, const mat4 & viewProjection)
+{
+	_ViewProjection = viewProjection;
+
+	std::vector<std::pair<const Mesh*, mat4>> occluders;
+	for (Transform* object : objects)
+	{
+		const Mesh* mesh = object->getOccluderMesh();
+		if (mesh != nullptr && mesh->isLoaded())
+		{
+			occluders.push_back({ mesh, viewProjection * object->getLocalToWorld() });
+		}
+	}
+	_NumOccluders = (int)occluders.size();
+
+	// Set up every occluder's triangles in parallel, then bin them in order
+	std::vector<std::vector<Triangle>> setups(occluders.size());
+	ThreadPool::shared().parallelFor((unsigned int)occluders.size(), [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			setupTriangles(*occluders[i].first, occluders[i].second, setups[i]);
+		}
+	});
+
+	_Triangles.clear();
+	for (std::vector<Triangle>& triangles : setups)
+	{
+		_Triangles.insert(_Triangles.end(), triangles.begin(), triangles.end());
+	}
+	for (std::vector<int>& bin : _Bins)
+	{
+		bin.clear();
+	}
+	for (int i = 0; i < (int)_Triangles.size(); ++i)
+	{
+		const Triangle& triangle = _Triangles[i];
+		for (int ty = triangle.minY / TileHeight; ty <= triangle.maxY / TileHeight; ++ty)
+		{
+			for (int tx = triangle.minX / TileWidth; tx <= triangle.maxX / TileWidth; ++tx)
+			{
+				_Bins[ty * TilesX + tx].push_back(i);
+			}
+		}
+	}
+
+	// Tiles share no pixels, so each is rasterized on its own without locking
+	ThreadPool::shared().parallelFor(TilesX * TilesY, [this](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int tile = begin; tile < end; ++tile)
+		{
+			rasterizeTile((int)tile);
+		}
+	});
+}
+
+bool DepthRasterizer::isVisible(const vec3 & boundsMin, const vec3 & boundsMax) const
+{
+	vec3 ndcMin = vec3(FLT_MAX);
+	vec3 ndcMax = vec3(-FLT_MAX);
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner(i & 1 ? boundsMax.x : boundsMin.x, i & 2 ? boundsMax.y : boundsMin.y, i & 4 ? boundsMax.z : boundsMin.z);
+		vec4 clip = _ViewProjection * vec4(corner, 1.0f);
+		// Crossing the near plane, too close to be worth testing
+		if (clip.w <= 0.0f)
+		{
+			return true;
+		}
+		vec3 ndc = vec3(clip.x, clip.y, clip.z) / clip.w;
+		ndcMin = vec3((std::min)(ndcMin.x, ndc.x), (std::min)(ndcMin.y, ndc.y), (std::min)(ndcMin.z, ndc.z));
+		ndcMax = vec3((std::max)(ndcMax.x, ndc.x), (std::max)(ndcMax.y, ndc.y), (std::max)(ndcMax.z, ndc.z));
+	}
+	if (ndcMax.x < -1.0f || ndcMax.y < -1.0f || ndcMin.x > 1.0f || ndcMin.y > 1.0f || ndcMin.z > 1.0f)
+	{
+		return false;
+	}
+
+	int minX = (std::max)(0, (int)floorf((ndcMin.x * 0.5f + 0.5f) * Width));
+	int minY = (std::max)(0, (int)floorf((ndcMin.y * 0.5f + 0.5f) * Height));
+	int maxX = (std::min)(Width - 1, (int)floorf((ndcMax.x * 0.5f + 0.5f) * Width));
+	int maxY = (std::min)(Height - 1, (int)floorf((ndcMax.y * 0.5f + 0.5f) * Height));
+	float nearest = ndcMin.z * 0.5f + 0.5f;
+
+	for (int by = minY / BlockSize; by <= maxY / BlockSize; ++by)
+	{
+		for (int bx = minX / BlockSize; bx <= maxX / BlockSize; ++bx)
+		{
+			// Everything in this block is in front of the box
+			if (_BlockDepth[by * BlocksX + bx] < nearest)
+			{
+				continue;
+			}
+
+			int x0 = (std::max)(minX, bx * BlockSize), x1 = (std::min)(maxX, bx * BlockSize + BlockSize - 1);
+			int y0 = (std::max)(minY, by * BlockSize), y1 = (std::min)(maxY, by * BlockSize + BlockSize - 1);
+			for (int y = y0; y <= y1; ++y)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					if (_Depth[y * Width + x] >= nearest)
+					{
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+int DepthRasterizer::getNumOccluders() const
+{
+	return _NumOccluders;
+}
+
+int DepthRasterizer::getNumTriangles() const
+{
+	return (int)_Triangles.size();
+}
+
+const std::vector<float>& DepthRasterizer::getDepth() const
+{
+	return _Depth;
+}
+
+void DepthRasterizer::setupTriangles(const Mesh & mesh, const mat4 & localToClip, std::vector<Triangle>& triangles)
+{
+	const std::vector<vec4>& vertices = mesh.dataVertex;
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+	{
+		vec4 clip[3];
+		int numInFront = 0;
+		for (int v = 0; v < 3; ++v)
+		{
+			clip[v] = localToClip * vec4(vec3(vertices[i + v]), 1.0f);
+			numInFront += clip[v].z >= -clip[v].w ? 1 : 0;
+		}
+
+		if (numInFront == 3)
+		{
+			addTriangle(clip[0], clip[1], clip[2], triangles);
+			continue;
+		}
+		if (numInFront == 0)
+		{
+			continue;
+		}
+
+		// Clip against the near plane, z = -w, which leaves a triangle or a quad
+		vec4 polygon[4];
+		int numVertices = 0;
+		for (int v = 0; v < 3; ++v)
+		{
+			const vec4& a = clip[v];
+			const vec4& b = clip[(v + 1) % 3];
+			float da = a.z + a.w;
+			float db = b.z + b.w;
+			if (da >= 0.0f)
+			{
+				polygon[numVertices++] = a;
+			}
+			if ((da >= 0.0f) != (db >= 0.0f))
+			{
+				polygon[numVertices++] = a + (b - a) * (da / (da - db));
+			}
+		}
+		for (int v = 1; v + 1 < numVertices; ++v)
+		{
+			addTriangle(polygon[0], polygon[v], polygon[v + 1], triangles);
+		}
+	}
+}
+
+void DepthRasterizer::addTriangle(const vec4 & a, const vec4 & b, const vec4 & c, std::vector<Triangle>& triangles)
+{
+	Triangle triangle;
+	const vec4* clip[3] = { &a, &b, &c };
+	for (int v = 0; v < 3; ++v)
+	{
+		float inverseW = 1.0f / clip[v]->w;
+		triangle.x[v] = (clip[v]->x * inverseW * 0.5f + 0.5f) * Width;
+		triangle.y[v] = (clip[v]->y * inverseW * 0.5f + 0.5f) * Height;
+		triangle.z[v] = clip[v]->z * inverseW * 0.5f + 0.5f;
+	}
+
+	// Counter-clockwise faces the camera, as with glCullFace(GL_BACK)
+	float area = (triangle.x[1] - triangle.x[0]) * (triangle.y[2] - triangle.y[0]) - (triangle.y[1] - triangle.y[0]) * (triangle.x[2] - triangle.x[0]);
+	if (area <= 0.0f)
+	{
+		return;
+	}
+
+	float minX = (std::min)(triangle.x[0], (std::min)(triangle.x[1], triangle.x[2]));
+	float maxX = (std::max)(triangle.x[0], (std::max)(triangle.x[1], triangle.x[2]));
+	float minY = (std::min)(triangle.y[0], (std::min)(triangle.y[1], triangle.y[2]));
+	float maxY = (std::max)(triangle.y[0], (std::max)(triangle.y[1], triangle.y[2]));
+	triangle.minX = (std::max)(0, (int)floorf(minX));
+	triangle.minY = (std::max)(0, (int)floorf(minY));
+	triangle.maxX = (std::min)(Width - 1, (int)floorf(maxX));
+	triangle.maxY = (std::min)(Height - 1, (int)floorf(maxY));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+	triangles.push_back(triangle);
+}
+
+void DepthRasterizer::rasterizeTile(int tile)
+{
+	int tileX = (tile % TilesX) * TileWidth;
+	int tileY = (tile / TilesX) * TileHeight;
+	for (int y = tileY; y < tileY + TileHeight; ++y)
+	{
+		std::fill(_Depth.begin() + y * Width + tileX, _Depth.begin() + y * Width + tileX + TileWidth, 1.0f);
+	}
+
+	const __m128 centers = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	for (int index : _Bins[tile])
+	{
+		const Triangle& t = _Triangles[index];
+
+		// Edge functions, positive inside: e = a * x + b * y + c
+		float a[3], b[3], c[3];
+		for (int e = 0; e < 3; ++e)
+		{
+			int next = (e + 1) % 3;
+			a[e] = t.y[e] - t.y[next];
+			b[e] = t.x[next] - t.x[e];
+			c[e] = -(a[e] * t.x[e] + b[e] * t.y[e]);
+		}
+
+		// Conservative, a pixel is only covered if all of it is inside, so each edge is moved in by
+		// the most it changes between the pixel's centre and a corner
+		float inset[3];
+		for (int e = 0; e < 3; ++e)
+		{
+			inset[e] = 0.5f * (fabsf(a[e]) + fabsf(b[e]));
+		}
+
+		// Depth is linear in screen space
+		float area = b[0] * (t.y[2] - t.y[0]) + a[0] * (t.x[2] - t.x[0]);
+		float dzdx = ((t.z[1] - t.z[0]) * (t.y[2] - t.y[0]) - (t.z[2] - t.z[0]) * (t.y[1] - t.y[0])) / area;
+		float dzdy = ((t.z[2] - t.z[0]) * (t.x[1] - t.x[0]) - (t.z[1] - t.z[0]) * (t.x[2] - t.x[0])) / area;
+		// And the farthest depth on the pixel, rather than at its centre
+		float farthestOffset = 0.5f * (fabsf(dzdx) + fabsf(dzdy));
+
+		// Rows start on a multiple of four, which tiles are, so four pixels never leave the tile
+		int startX = (std::max)(t.minX, tileX) & ~3;
+		int endX = (std::min)(t.maxX, tileX + TileWidth - 1);
+		int startY = (std::max)(t.minY, tileY);
+		int endY = (std::min)(t.maxY, tileY + TileHeight - 1);
+
+		__m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+		__m128 slope = _mm_set1_ps(dzdx);
+		for (int y = startY; y <= endY; ++y)
+		{
+			float centerY = y + 0.5f;
+			__m128 row0 = _mm_set1_ps(b[0] * centerY + c[0] - inset[0]);
+			__m128 row1 = _mm_set1_ps(b[1] * centerY + c[1] - inset[1]);
+			__m128 row2 = _mm_set1_ps(b[2] * centerY + c[2] - inset[2]);
+			__m128 rowDepth = _mm_set1_ps(t.z[0] + dzdy * (centerY - t.y[0]) - dzdx * t.x[0] + farthestOffset);
+			float* depthRow = &_Depth[y * Width];
+
+			for (int x = startX; x <= endX; x += 4)
+			{
+				__m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), centers);
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps(
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, centerX), row0), zero),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, centerX), row1), zero)),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, centerX), row2), zero));
+				if (_mm_movemask_ps(inside) == 0)
+				{
+					continue;
+				}
+
+				__m128 depth = _mm_add_ps(_mm_mul_ps(slope, centerX), rowDepth);
+				__m128 stored = _mm_loadu_ps(depthRow + x);
+				__m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(depth, stored));
+				_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(closer, depth), _mm_andnot_ps(closer, stored)));
+			}
+		}
+	}
+
+	// The farthest depth of each block, for isVisible() to skip blocks with
+	for (int by = tileY / BlockSize; by < (tileY + TileHeight) / BlockSize; ++by)
+	{
+		for (int bx = tileX / BlockSize; bx < (tileX + TileWidth) / BlockSize; ++bx)
+		{
+			__m128 farthest = zero;
+			for (int y = by * BlockSize; y < (by + 1) * BlockSize; ++y)
+			{
+				const float* depthRow = &_Depth[y * Width + bx * BlockSize];
+				farthest = _mm_max_ps(farthest, _mm_max_ps(_mm_loadu_ps(depthRow), _mm_loadu_ps(depthRow + 4)));
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, farthest);
+			_BlockDepth[by * BlocksX + bx] = (std::max)((std::max)(lanes[0], lanes[1]), (std::max)(lanes[2], lanes[3]));
+		}
+	}
+}
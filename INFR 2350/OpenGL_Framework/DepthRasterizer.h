@@ -0,0 +1,79 @@
+#pragma once
+#include <MiniMath/Core.h>
+#include <vector>
+
+class Transform;
+class Mesh;
+
+/*
+	///// // DepthRasterizer // /////
+
+	Occlusion culling on the CPU, so hidden objects are dropped before any GL work is issued,
+	without waiting on the GPU and without needing one at all.
+
+	Occluders (see GameObject::setOccluder) are drawn into a small depth buffer. Their triangles
+	are transformed and set up on worker threads, binned into tiles, and each tile is then
+	rasterized on a worker of its own, four pixels at a time with SSE. Each tile also keeps the
+	farthest depth of every 8x8 block of it.
+
+	isVisible() projects an object's bounding box, and it is hidden if its nearest depth is behind
+	every pixel the box covers. Blocks whose farthest depth is already in front of the box are
+	skipped without looking at their pixels.
+
+	The buffer is coarse, each pixel spanning several on screen, so rasterization is conservative:
+	a pixel is only covered where all of it is inside a triangle, and keeps the farthest depth the
+	triangle has on it. Occluders never hide more than they cover, at the cost of leaving gaps
+	along their edges, including those inside a mesh. Occluder meshes with few large triangles
+	leave the fewest gaps, see GameObject::setOccluder.
+*/
+
+class DepthRasterizer
+{
+public:
+	static const int Width = 256;
+	static const int Height = 128;
+
+	DepthRasterizer();
+
+	// Draws the occluders among objects as seen through viewProjection
+	void render(const std::vector<Transform*> &objects, const mat4 &viewProjection);
+	// False if the box is certainly hidden behind the occluders, or entirely off screen
+	bool isVisible(const vec3 &boundsMin, const vec3 &boundsMax) const;
+
+	int getNumOccluders() const;
+	int getNumTriangles() const;
+	// Window space depth, row 0 at the bottom
+	const std::vector<float>& getDepth() const;
+
+private:
+	static const int TileWidth = 64;
+	static const int TileHeight = 32;
+	static const int TilesX = Width / TileWidth;
+	static const int TilesY = Height / TileHeight;
+	static const int BlockSize = 8;
+	static const int BlocksX = Width / BlockSize;
+	static const int BlocksY = Height / BlockSize;
+
+	// In pixels, depth is window space [0, 1]
+	struct Triangle
+	{
+		float x[3];
+		float y[3];
+		float z[3];
+		int minX, minY, maxX, maxY;
+	};
+
+	// Transforms, clips to the near plane, culls back faces and sets up a mesh's triangles
+	static void setupTriangles(const Mesh &mesh, const mat4 &localToClip, std::vector<Triangle> &triangles);
+	static void addTriangle(const vec4 &a, const vec4 &b, const vec4 &c, std::vector<Triangle> &triangles);
+	void rasterizeTile(int tile);
+
+	mat4 _ViewProjection;
+	std::vector<float> _Depth;
+	// Farthest depth in each block
+	std::vector<float> _BlockDepth;
+	std::vector<Triangle> _Triangles;
+	// Indices into _Triangles overlapping each tile
+	std::vector<std::vector<int>> _Bins;
+	int _NumOccluders = 0;
+};
@@ -0,0 +1,53 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+bool DynamicResolution::enabled = false;
+float DynamicResolution::targetMilliseconds = 1000.0f / 60.0f * 0.9f;
+float DynamicResolution::minScale = 0.5f;
+float DynamicResolution::maxScale = 1.0f;
+float DynamicResolution::_Scale = 1.0f;
+
+namespace
+{
+	// Fraction of the way to the wanted scale moved each frame
+	const float GainDown = 0.25f;
+	const float GainUp = 0.05f;
+	// Frame times this close to the target leave the scale alone
+	const float Deadband = 0.05f;
+}
+
+void DynamicResolution::update(float gpuMilliseconds)
+{
+	if (!enabled)
+	{
+		_Scale = maxScale;
+		return;
+	}
+	if (gpuMilliseconds <= 0.0f)
+	{
+		return;
+	}
+
+	float ratio = targetMilliseconds / gpuMilliseconds;
+	if (fabsf(ratio - 1.0f) < Deadband)
+	{
+		return;
+	}
+
+	float wanted = _Scale * sqrtf(ratio);
+	float gain = wanted < _Scale ? GainDown : GainUp;
+	_Scale += (wanted - _Scale) * gain;
+	_Scale = (std::max)(minScale, (std::min)(_Scale, maxScale));
+}
+
+void DynamicResolution::getViewport(unsigned width, unsigned height, unsigned & viewportWidth, unsigned & viewportHeight)
+{
+	viewportWidth = (std::max)(1u, (unsigned)(width * _Scale + 0.5f));
+	viewportHeight = (std::max)(1u, (unsigned)(height * _Scale + 0.5f));
+}
+
+float DynamicResolution::getScale()
+{
+	return _Scale;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+	///// // DynamicResolution // /////
+
+	Picks how much of the window the scene renders at, to hold a GPU frame time.
+
+	Render targets are allocated at full size once, and the scene draws into a viewport
+	scaled down from it, so changing the scale never allocates. The final full screen pass
+	stretches the rendered part back over the window.
+
+	update() takes the last GPU frame time (see GpuTimer). Pixel cost grows with the square
+	of the scale, so the scale moves towards sqrt(target / measured) of its current value.
+	It drops quickly when a frame runs over and climbs back slowly, and ignores small
+	errors, so it does not oscillate around the target.
+*/
+
+class DynamicResolution
+{
+public:
+	// Call once a frame with the newest GPU frame time, 0 if none is available yet
+	static void update(float gpuMilliseconds);
+	// Size of the scene's viewport inside targets of width by height
+	static void getViewport(unsigned width, unsigned height, unsigned &viewportWidth, unsigned &viewportHeight);
+	static float getScale();
+
+	static bool enabled;
+	// 60 fps, less some headroom for the CPU side of the frame and the UI
+	static float targetMilliseconds;
+	static float minScale;
+	static float maxScale;
+
+private:
+	static float _Scale;
+};
@@ -0,0 +1,623 @@
+#include "FrameGraph.h"
+#include "IO.h"
+#include <algorithm>
+
+unsigned int FrameGraph::FramesToKeep = 3;
+
+bool RenderTargetDesc::operator==(const RenderTargetDesc & other) const
+{
+	return width == other.width && height == other.height && format == other.format &&
+		filter == other.filter && wrap == other.wrap && samples == other.samples;
+}
+
+FrameGraph::Builder::Builder(FrameGraph & graph, int pass)
+	: _Graph(graph), _Pass(pass)
+{
+}
+
+FrameResource FrameGraph::Builder::create(const std::string & name, const RenderTargetDesc & desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	return _Graph.addResource(resource);
+}
+
+FrameResource FrameGraph::Builder::read(FrameResource resource)
+{
+	SAT_ASSERT(resource >= 0 && resource < (int)_Graph._Resources.size(), "Reading an invalid frame graph resource!");
+	_Graph._Passes[_Pass].reads.push_back(resource);
+	_Graph._Resources[resource].readers.push_back(_Pass);
+	return resource;
+}
+
+FrameResource FrameGraph::Builder::write(FrameResource resource)
+{
+	SAT_ASSERT(resource >= 0 && resource < (int)_Graph._Resources.size(), "Writing an invalid frame graph resource!");
+	_Graph._Passes[_Pass].writes.push_back(resource);
+	_Graph._Resources[resource].writers.push_back(_Pass);
+	return resource;
+}
+
+FrameResource FrameGraph::Builder::resolve(FrameResource source, FrameResource target)
+{
+	read(source);
+	write(target);
+	SAT_ASSERT(_Graph._Resources[source].desc.width == _Graph._Resources[target].desc.width &&
+		_Graph._Resources[source].desc.height == _Graph._Resources[target].desc.height, "Resolving to a target of a different size!");
+	_Graph._Passes[_Pass].resolves.push_back({ source, target });
+	return target;
+}
+
+void FrameGraph::Builder::sideEffect()
+{
+	_Graph._Passes[_Pass].sideEffect = true;
+}
+
+FrameGraph::~FrameGraph()
+{
+	unload();
+}
+
+void FrameGraph::unload()
+{
+	for (auto& framebuffer : _Framebuffers)
+	{
+		glDeleteFramebuffers(1, &framebuffer.second);
+	}
+	_Framebuffers.clear();
+	for (PooledTexture& texture : _Pool)
+	{
+		glDeleteTextures(1, &texture.handle);
+	}
+	_Pool.clear();
+	clear();
+}
+
+void FrameGraph::addPass(const std::string & name, const SetupFunction & setup, const ExecuteFunction & execute)
+{
+	SAT_ASSERT(!_IsCompiled, "Passes can not be added to a compiled frame graph!");
+	Pass pass;
+	pass.name = name;
+	pass.execute = execute;
+	_Passes.push_back(pass);
+
+	Builder builder(*this, (int)_Passes.size() - 1);
+	setup(builder);
+}
+
+FrameResource FrameGraph::importBackbuffer(const std::string & name, unsigned width, unsigned height)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc.width = width;
+	resource.desc.height = height;
+	resource.imported = true;
+	resource.backbuffer = true;
+	return addResource(resource);
+}
+
+FrameResource FrameGraph::importTexture(const std::string & name, GLuint handle, const RenderTargetDesc & desc)
+{
+	Resource resource;
+	resource.name = name;
+	resource.desc = desc;
+	resource.imported = true;
+	resource.handle = handle;
+	return addResource(resource);
+}
+
+void FrameGraph::compile()
+{
+	++_Frame;
+	cull();
+	sortPasses();
+	allocate();
+	freeUnusedTextures();
+	_NumPasses = (int)_Order.size();
+	_IsCompiled = true;
+}
+
+void FrameGraph::execute()
+{
+	SAT_ASSERT(_IsCompiled, "Frame graph executed before it was compiled!");
+
+	for (int position = 0; position < (int)_Order.size(); ++position)
+	{
+		const Pass& pass = _Passes[_Order[position]];
+
+		GLuint framebuffer = 0;
+		if (!pass.writes.empty())
+		{
+			framebuffer = getFramebuffer(pass);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			const RenderTargetDesc& desc = _Resources[pass.writes[0]].desc;
+			glViewport(0, 0, desc.width, desc.height);
+
+			// Targets written for the first time hold nothing worth loading
+			std::vector<FrameResource> fresh;
+			for (FrameResource resource : pass.writes)
+			{
+				if (!_Resources[resource].imported && _Resources[resource].first == position &&
+					std::find(pass.reads.begin(), pass.reads.end(), resource) == pass.reads.end())
+				{
+					fresh.push_back(resource);
+				}
+			}
+			invalidate(framebuffer, pass, fresh);
+		}
+
+		pass.execute(*this);
+		resolve(pass);
+
+		if (framebuffer != 0)
+		{
+			// Nothing reads these again this frame, so they never need to leave the GPU's tile memory
+			std::vector<FrameResource> finished;
+			for (FrameResource resource : pass.writes)
+			{
+				if (!_Resources[resource].imported && _Resources[resource].last == position)
+				{
+					finished.push_back(resource);
+				}
+			}
+			invalidate(framebuffer, pass, finished);
+		}
+
+		// Targets last used as a source, such as multisampled targets after their resolve, are not
+		// attached here, so they are discarded as textures. The pool hands them out again next.
+		for (FrameResource resource : pass.reads)
+		{
+			const Resource& data = _Resources[resource];
+			if (!data.imported && data.last == position &&
+				std::find(pass.writes.begin(), pass.writes.end(), resource) == pass.writes.end())
+			{
+				glInvalidateTexImage(data.handle, 0);
+			}
+		}
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
+	clear();
+}
+
+GLuint FrameGraph::getTexture(FrameResource resource) const
+{
+	SAT_ASSERT(resource >= 0 && resource < (int)_Resources.size(), "Invalid frame graph resource!");
+	return _Resources[resource].handle;
+}
+
+void FrameGraph::bindTexture(FrameResource resource, int textureSlot) const
+{
+	glBindTextureUnit(textureSlot, getTexture(resource));
+}
+
+const RenderTargetDesc & FrameGraph::getDesc(FrameResource resource) const
+{
+	return _Resources[resource].desc;
+}
+
+int FrameGraph::getNumPasses() const
+{
+	return _NumPasses;
+}
+
+int FrameGraph::getNumCulledPasses() const
+{
+	return _NumCulled;
+}
+
+int FrameGraph::getNumPooledTextures() const
+{
+	return (int)_Pool.size();
+}
+
+size_t FrameGraph::getPooledBytes() const
+{
+	size_t bytes = 0;
+	for (const PooledTexture& texture : _Pool)
+	{
+		bytes += (size_t)texture.desc.width * texture.desc.height * texture.desc.samples * getTexelSize(texture.desc.format);
+	}
+	return bytes;
+}
+
+FrameResource FrameGraph::addResource(const Resource & resource)
+{
+	SAT_ASSERT(!_IsCompiled, "Resources can not be added to a compiled frame graph!");
+	_Resources.push_back(resource);
+	return (FrameResource)_Resources.size() - 1;
+}
+
+void FrameGraph::cull()
+{
+	// Work back from the passes whose results leave the graph
+	std::vector<bool> alive(_Passes.size(), false);
+	std::vector<int> stack;
+	for (int i = 0; i < (int)_Passes.size(); ++i)
+	{
+		bool root = _Passes[i].sideEffect;
+		for (FrameResource resource : _Passes[i].writes)
+		{
+			root = root || _Resources[resource].imported;
+		}
+		if (root)
+		{
+			alive[i] = true;
+			stack.push_back(i);
+		}
+	}
+
+	// A target used by a live pass needs every pass that writes it
+	while (!stack.empty())
+	{
+		const Pass& pass = _Passes[stack.back()];
+		stack.pop_back();
+
+		std::vector<FrameResource> used = pass.reads;
+		used.insert(used.end(), pass.writes.begin(), pass.writes.end());
+		for (FrameResource resource : used)
+		{
+			for (int writer : _Resources[resource].writers)
+			{
+				if (!alive[writer])
+				{
+					alive[writer] = true;
+					stack.push_back(writer);
+				}
+			}
+		}
+	}
+
+	_NumCulled = 0;
+	for (size_t i = 0; i < _Passes.size(); ++i)
+	{
+		_Passes[i].culled = !alive[i];
+		_NumCulled += alive[i] ? 0 : 1;
+	}
+}
+
+void FrameGraph::sortPasses()
+{
+	// Writers of a target run in the order they were added, and all of them run before its readers
+	size_t numPasses = _Passes.size();
+	std::vector<std::vector<int>> next(numPasses);
+	std::vector<int> numDependencies(numPasses, 0);
+	auto addEdge = [&](int from, int to)
+	{
+		if (from != to && !_Passes[from].culled && !_Passes[to].culled)
+		{
+			next[from].push_back(to);
+			++numDependencies[to];
+		}
+	};
+	for (const Resource& resource : _Resources)
+	{
+		for (size_t i = 1; i < resource.writers.size(); ++i)
+		{
+			addEdge(resource.writers[i - 1], resource.writers[i]);
+		}
+		for (int reader : resource.readers)
+		{
+			for (int writer : resource.writers)
+			{
+				addEdge(writer, reader);
+			}
+		}
+	}
+
+	// Among passes that are ready, the one added first runs first
+	_Order.clear();
+	std::vector<int> ready;
+	for (int i = 0; i < (int)numPasses; ++i)
+	{
+		if (!_Passes[i].culled && numDependencies[i] == 0)
+		{
+			ready.push_back(i);
+		}
+	}
+	while (!ready.empty())
+	{
+		auto first = std::min_element(ready.begin(), ready.end());
+		int pass = *first;
+		ready.erase(first);
+		_Order.push_back(pass);
+
+		for (int dependent : next[pass])
+		{
+			if (--numDependencies[dependent] == 0)
+			{
+				ready.push_back(dependent);
+			}
+		}
+	}
+
+	if (_Order.size() + _NumCulled != numPasses)
+	{
+		SAT_DEBUG_LOG_ERROR("[FrameGraph] Passes depend on each other in a cycle, running them in the order they were added");
+		_Order.clear();
+		for (int i = 0; i < (int)numPasses; ++i)
+		{
+			if (!_Passes[i].culled)
+			{
+				_Order.push_back(i);
+			}
+		}
+	}
+}
+
+void FrameGraph::allocate()
+{
+	for (int position = 0; position < (int)_Order.size(); ++position)
+	{
+		const Pass& pass = _Passes[_Order[position]];
+		std::vector<FrameResource> used = pass.reads;
+		used.insert(used.end(), pass.writes.begin(), pass.writes.end());
+		for (FrameResource resource : used)
+		{
+			Resource& data = _Resources[resource];
+			if (data.first < 0)
+			{
+				data.first = position;
+			}
+			data.last = position;
+		}
+	}
+
+	// Walk the lifetimes in order, a texture goes back to the pool right after its last pass
+	for (int position = 0; position < (int)_Order.size(); ++position)
+	{
+		for (Resource& resource : _Resources)
+		{
+			if (!resource.imported && resource.first == position)
+			{
+				resource.handle = acquireTexture(resource.desc);
+			}
+		}
+		for (Resource& resource : _Resources)
+		{
+			if (!resource.imported && resource.last == position)
+			{
+				releaseTexture(resource.handle);
+			}
+		}
+	}
+}
+
+GLuint FrameGraph::acquireTexture(const RenderTargetDesc & desc)
+{
+	for (PooledTexture& texture : _Pool)
+	{
+		if (!texture.inUse && texture.desc == desc)
+		{
+			texture.inUse = true;
+			texture.lastUsedFrame = _Frame;
+			return texture.handle;
+		}
+	}
+
+	PooledTexture texture;
+	texture.desc = desc;
+	texture.inUse = true;
+	texture.lastUsedFrame = _Frame;
+	if (desc.samples > 1)
+	{
+		glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &texture.handle);
+		glTextureStorage2DMultisample(texture.handle, desc.samples, desc.format, desc.width, desc.height, GL_TRUE);
+	}
+	else
+	{
+		glCreateTextures(GL_TEXTURE_2D, 1, &texture.handle);
+		glTextureStorage2D(texture.handle, 1, desc.format, desc.width, desc.height);
+		glTextureParameteri(texture.handle, GL_TEXTURE_MIN_FILTER, desc.filter);
+		glTextureParameteri(texture.handle, GL_TEXTURE_MAG_FILTER, desc.filter);
+		glTextureParameteri(texture.handle, GL_TEXTURE_WRAP_S, desc.wrap);
+		glTextureParameteri(texture.handle, GL_TEXTURE_WRAP_T, desc.wrap);
+	}
+	_Pool.push_back(texture);
+	return texture.handle;
+}
+
+void FrameGraph::releaseTexture(GLuint handle)
+{
+	for (PooledTexture& texture : _Pool)
+	{
+		if (texture.handle == handle)
+		{
+			texture.inUse = false;
+			return;
+		}
+	}
+}
+
+void FrameGraph::freeUnusedTextures()
+{
+	for (size_t i = 0; i < _Pool.size();)
+	{
+		PooledTexture& texture = _Pool[i];
+		if (_Frame - texture.lastUsedFrame <= FramesToKeep)
+		{
+			++i;
+			continue;
+		}
+
+		// Framebuffers holding the texture go with it
+		for (auto framebuffer = _Framebuffers.begin(); framebuffer != _Framebuffers.end();)
+		{
+			const std::vector<GLuint>& attachments = framebuffer->first;
+			if (std::find(attachments.begin(), attachments.end(), texture.handle) != attachments.end())
+			{
+				glDeleteFramebuffers(1, &framebuffer->second);
+				framebuffer = _Framebuffers.erase(framebuffer);
+			}
+			else
+			{
+				++framebuffer;
+			}
+		}
+		glDeleteTextures(1, &texture.handle);
+		_Pool.erase(_Pool.begin() + i);
+	}
+}
+
+GLuint FrameGraph::getFramebuffer(const Pass & pass)
+{
+	return getFramebuffer(pass.writes, pass.name);
+}
+
+GLuint FrameGraph::getFramebuffer(const std::vector<FrameResource>& attachments, const std::string & name)
+{
+	std::vector<GLuint> colors;
+	GLuint depth = 0;
+	for (FrameResource resource : attachments)
+	{
+		const Resource& data = _Resources[resource];
+		if (data.backbuffer)
+		{
+			return 0;
+		}
+		if (isDepthFormat(data.desc.format))
+		{
+			depth = data.handle;
+		}
+		else
+		{
+			colors.push_back(data.handle);
+		}
+	}
+
+	std::vector<GLuint> key = colors;
+	key.push_back(0);
+	key.push_back(depth);
+	auto found = _Framebuffers.find(key);
+	if (found != _Framebuffers.end())
+	{
+		return found->second;
+	}
+
+	GLuint framebuffer = 0;
+	glCreateFramebuffers(1, &framebuffer);
+	std::vector<GLenum> buffers;
+	for (size_t i = 0; i < colors.size(); ++i)
+	{
+		glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0 + (GLenum)i, colors[i], 0);
+		buffers.push_back(GL_COLOR_ATTACHMENT0 + (GLenum)i);
+	}
+	if (depth != 0)
+	{
+		glNamedFramebufferTexture(framebuffer, GL_DEPTH_ATTACHMENT, depth, 0);
+	}
+	if (buffers.empty())
+	{
+		glNamedFramebufferDrawBuffer(framebuffer, GL_NONE);
+	}
+	else
+	{
+		glNamedFramebufferDrawBuffers(framebuffer, (GLsizei)buffers.size(), buffers.data());
+	}
+
+	if (glCheckNamedFramebufferStatus(framebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		SAT_DEBUG_LOG_ERROR("[FrameGraph] Framebuffer for pass %s is not complete!", name.c_str());
+	}
+	_Framebuffers[key] = framebuffer;
+	return framebuffer;
+}
+
+void FrameGraph::resolve(const Pass & pass)
+{
+	// Each pair gets framebuffers of its own, so a blit only ever touches one attachment
+	for (const std::pair<FrameResource, FrameResource>& pair : pass.resolves)
+	{
+		const Resource& source = _Resources[pair.first];
+		GLuint read = getFramebuffer({ pair.first }, pass.name);
+		GLuint draw = getFramebuffer({ pair.second }, pass.name);
+		GLbitfield mask = isDepthFormat(source.desc.format) ? GL_DEPTH_BUFFER_BIT : GL_COLOR_BUFFER_BIT;
+		glBlitNamedFramebuffer(read, draw, 0, 0, source.desc.width, source.desc.height,
+			0, 0, source.desc.width, source.desc.height, mask, GL_NEAREST);
+	}
+}
+
+void FrameGraph::invalidate(GLuint framebuffer, const Pass & pass, const std::vector<FrameResource>& resources) const
+{
+	if (framebuffer == 0 || resources.empty())
+	{
+		return;
+	}
+
+	// Attachment points follow the order getFramebuffer() attached the pass's writes in
+	std::vector<GLenum> attachments;
+	for (FrameResource resource : resources)
+	{
+		const Resource& data = _Resources[resource];
+		if (isDepthFormat(data.desc.format))
+		{
+			attachments.push_back(data.desc.format == GL_DEPTH24_STENCIL8 || data.desc.format == GL_DEPTH32F_STENCIL8 ?
+				GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT);
+			continue;
+		}
+
+		GLenum index = 0;
+		for (FrameResource write : pass.writes)
+		{
+			if (write == resource)
+			{
+				break;
+			}
+			if (!isDepthFormat(_Resources[write].desc.format))
+			{
+				++index;
+			}
+		}
+		attachments.push_back(GL_COLOR_ATTACHMENT0 + index);
+	}
+	glInvalidateNamedFramebufferData(framebuffer, (GLsizei)attachments.size(), attachments.data());
+}
+
+void FrameGraph::clear()
+{
+	_Passes.clear();
+	_Resources.clear();
+	_Order.clear();
+	_IsCompiled = false;
+}
+
+bool FrameGraph::isDepthFormat(GLenum format)
+{
+	switch (format)
+	{
+	case GL_DEPTH_COMPONENT16:
+	case GL_DEPTH_COMPONENT24:
+	case GL_DEPTH_COMPONENT32:
+	case GL_DEPTH_COMPONENT32F:
+	case GL_DEPTH24_STENCIL8:
+	case GL_DEPTH32F_STENCIL8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+size_t FrameGraph::getTexelSize(GLenum format)
+{
+	// What drivers typically allocate, RGB formats are padded to four channels
+	switch (format)
+	{
+	case GL_R8:
+		return 1;
+	case GL_RG8:
+	case GL_R16F:
+	case GL_DEPTH_COMPONENT16:
+		return 2;
+	case GL_RGBA16F:
+	case GL_RGB16F:
+	case GL_RG32F:
+	case GL_DEPTH32F_STENCIL8:
+		return 8;
+	case GL_RGBA32F:
+	case GL_RGB32F:
+		return 16;
+	default:
+		return 4;
+	}
+}
@@ -0,0 +1,172 @@
+#pragma once
+#include "GL/glew.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+/*
+	///// // FrameGraph // /////
+
+	Describes a frame as passes that read and write render targets, rather than framebuffers
+	that are created up front and wired together by hand.
+
+	Passes are added every frame. A pass's setup function runs straight away and declares the
+	targets it creates, reads (samples) and writes (renders to). Its execute function runs later,
+	from execute(). compile() then
+		- culls passes whose output nothing needs, keeping passes that write an imported target
+		  such as the back buffer, or that were marked as having side effects,
+		- orders the rest so that every pass writing a target runs before any pass reading it,
+		- finds the first and last pass using each transient target and gives it a texture from a
+		  pool, shared with other targets of the same description whose lifetimes do not overlap.
+
+	execute() binds a framebuffer holding each pass's attachments, runs the pass, and invalidates
+	attachments whose contents are not needed afterwards, so the driver can skip storing them.
+	Targets whose last pass only reads them are invalidated after it too.
+	Multisampled targets can not be sampled, a pass resolves them into single sampled targets,
+	which is a blit the graph does for it after the pass's execute function.
+
+	Pooled textures and their framebuffers are kept between frames, so a graph with the same shape
+	as last frame's allocates nothing. Textures that go unused for a few frames, such as after a
+	resize, are freed. Adding a post effect only adds a target when it has to overlap the others.
+*/
+
+typedef int FrameResource;
+const FrameResource InvalidFrameResource = -1;
+
+struct RenderTargetDesc
+{
+	unsigned width = 0;
+	unsigned height = 0;
+	GLenum format = GL_RGBA8;
+	GLenum filter = GL_NEAREST;
+	GLenum wrap = GL_CLAMP_TO_EDGE;
+	// More than one makes a multisampled texture, which has no filtering or wrapping
+	unsigned samples = 1;
+
+	bool operator==(const RenderTargetDesc &other) const;
+};
+
+class FrameGraph
+{
+public:
+	class Builder
+	{
+	public:
+		// A transient target that only lives for this frame
+		FrameResource create(const std::string &name, const RenderTargetDesc &desc);
+		// The pass samples resource
+		FrameResource read(FrameResource resource);
+		// The pass renders to resource, which is attached to its framebuffer
+		FrameResource write(FrameResource resource);
+		// Reads multisampled source and writes its resolved samples to target, which must be the same size
+		FrameResource resolve(FrameResource source, FrameResource target);
+		// Keeps the pass even if nothing reads what it writes
+		void sideEffect();
+
+	private:
+		friend class FrameGraph;
+		Builder(FrameGraph &graph, int pass);
+
+		FrameGraph& _Graph;
+		int _Pass;
+	};
+
+	typedef std::function<void(Builder&)> SetupFunction;
+	typedef std::function<void(const FrameGraph&)> ExecuteFunction;
+
+	~FrameGraph();
+	// Frees the pooled textures and framebuffers
+	void unload();
+
+	// Runs setup now and execute during execute()
+	void addPass(const std::string &name, const SetupFunction &setup, const ExecuteFunction &execute);
+	// The default framebuffer, passes writing it are never culled
+	FrameResource importBackbuffer(const std::string &name, unsigned width, unsigned height);
+	// A texture owned elsewhere that outlives the frame, passes writing it are never culled
+	FrameResource importTexture(const std::string &name, GLuint handle, const RenderTargetDesc &desc);
+
+	void compile();
+	// Runs the passes compile() kept, then clears the graph for the next frame
+	void execute();
+
+	// For execute functions, only valid while the graph is executing
+	GLuint getTexture(FrameResource resource) const;
+	void bindTexture(FrameResource resource, int textureSlot) const;
+	const RenderTargetDesc& getDesc(FrameResource resource) const;
+
+	// Passes that ran in the last compiled frame
+	int getNumPasses() const;
+	int getNumCulledPasses() const;
+	int getNumPooledTextures() const;
+	size_t getPooledBytes() const;
+
+	// Pooled textures unused for this many frames are freed
+	static unsigned int FramesToKeep;
+
+private:
+	struct Resource
+	{
+		std::string name;
+		RenderTargetDesc desc;
+		bool imported = false;
+		bool backbuffer = false;
+		GLuint handle = 0;
+		std::vector<int> writers;
+		std::vector<int> readers;
+		// Positions in _Order of the first and last pass using the resource
+		int first = -1;
+		int last = -1;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		ExecuteFunction execute;
+		std::vector<FrameResource> reads;
+		std::vector<FrameResource> writes;
+		// Source and target of each resolve, blit after execute
+		std::vector<std::pair<FrameResource, FrameResource>> resolves;
+		bool sideEffect = false;
+		bool culled = false;
+	};
+
+	struct PooledTexture
+	{
+		RenderTargetDesc desc;
+		GLuint handle = 0;
+		unsigned int lastUsedFrame = 0;
+		bool inUse = false;
+	};
+
+	FrameResource addResource(const Resource &resource);
+	void cull();
+	void sortPasses();
+	void allocate();
+	GLuint acquireTexture(const RenderTargetDesc &desc);
+	void releaseTexture(GLuint handle);
+	void freeUnusedTextures();
+	// Creates or reuses a framebuffer with the pass's writes attached
+	GLuint getFramebuffer(const Pass &pass);
+	GLuint getFramebuffer(const std::vector<FrameResource> &attachments, const std::string &name);
+	void resolve(const Pass &pass);
+	// Discards the contents of some of the pass's writes
+	void invalidate(GLuint framebuffer, const Pass &pass, const std::vector<FrameResource> &resources) const;
+	void clear();
+
+	static bool isDepthFormat(GLenum format);
+	static size_t getTexelSize(GLenum format);
+
+	std::vector<Pass> _Passes;
+	std::vector<Resource> _Resources;
+	// Indices of the passes that survived culling, in the order they run
+	std::vector<int> _Order;
+	int _NumPasses = 0;
+	int _NumCulled = 0;
+	bool _IsCompiled = false;
+
+	std::vector<PooledTexture> _Pool;
+	// Keyed by the attached color textures followed by 0 and the depth texture
+	std::map<std::vector<GLuint>, GLuint> _Framebuffers;
+	unsigned int _Frame = 0;
+};
@@ -123,7 +123,7 @@ void Framebuffer::addDepthTarget()
 
 void Framebuffer::addColorTarget(GLenum format)
 {
-	SAT_ASSERT(!_IsInit, "Framebuffer alreading initialized!");
+	SAT_ASSERT(!_IsInit, "Framebuffer already initialized!");
 	_Color._Tex.resize(_Color._NumAttachments+1);
 	_Color._Format.push_back(format);
 	_Color._Buffer.push_back(GL_COLOR_ATTACHMENT0 + _Color._NumAttachments);
@@ -0,0 +1,172 @@
+#include "Frustum.h"
+#include <cmath>
+#include <emmintrin.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+void BoundsList::clear()
+{
+	centerX.clear();
+	centerY.clear();
+	centerZ.clear();
+	extentX.clear();
+	extentY.clear();
+	extentZ.clear();
+}
+
+void BoundsList::add(const vec3 & boundsMin, const vec3 & boundsMax)
+{
+	centerX.push_back((boundsMin.x + boundsMax.x) * 0.5f);
+	centerY.push_back((boundsMin.y + boundsMax.y) * 0.5f);
+	centerZ.push_back((boundsMin.z + boundsMax.z) * 0.5f);
+	extentX.push_back((boundsMax.x - boundsMin.x) * 0.5f);
+	extentY.push_back((boundsMax.y - boundsMin.y) * 0.5f);
+	extentZ.push_back((boundsMax.z - boundsMin.z) * 0.5f);
+}
+
+size_t BoundsList::size() const
+{
+	return centerX.size();
+}
+
+Frustum::Frustum(const mat4 & viewProjection)
+{
+	setViewProjection(viewProjection);
+}
+
+void Frustum::setViewProjection(const mat4 & viewProjection)
+{
+	// Column major, row r is elements r, r + 4, r + 8 and r + 12
+	vec4 rows[4];
+	for (unsigned r = 0; r < 4; ++r)
+	{
+		rows[r] = vec4(viewProjection[r], viewProjection[r + 4], viewProjection[r + 8], viewProjection[r + 12]);
+	}
+
+	// -w <= x, y, z <= w in clip space
+	_Planes[0] = rows[3] + rows[0];
+	_Planes[1] = rows[3] - rows[0];
+	_Planes[2] = rows[3] + rows[1];
+	_Planes[3] = rows[3] - rows[1];
+	_Planes[4] = rows[3] + rows[2];
+	_Planes[5] = rows[3] - rows[2];
+
+	for (vec4& plane : _Planes)
+	{
+		float length = sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+		if (length > 0.0f)
+		{
+			plane /= length;
+		}
+	}
+}
+
+bool Frustum::isVisible(const vec3 & boundsMin, const vec3 & boundsMax) const
+{
+	vec3 center = (boundsMin + boundsMax) * 0.5f;
+	vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	return isVisible(center.x, center.y, center.z, extent.x, extent.y, extent.z);
+}
+
+Frustum::Containment Frustum::classify(const vec3 & boundsMin, const vec3 & boundsMax) const
+{
+	vec3 center = (boundsMin + boundsMax) * 0.5f;
+	vec3 extent = (boundsMax - boundsMin) * 0.5f;
+	Containment containment = Containment::Inside;
+	for (const vec4& plane : _Planes)
+	{
+		float distance = center.x * plane.x + center.y * plane.y + center.z * plane.z + plane.w;
+		float radius = extent.x * fabsf(plane.x) + extent.y * fabsf(plane.y) + extent.z * fabsf(plane.z);
+		if (distance + radius < 0.0f)
+		{
+			return Containment::Outside;
+		}
+		if (distance - radius < 0.0f)
+		{
+			containment = Containment::Intersecting;
+		}
+	}
+	return containment;
+}
+
+void Frustum::test(const BoundsList & bounds, std::vector<unsigned char>& visible) const
+{
+	size_t count = bounds.size();
+	visible.resize(count);
+	size_t i = 0;
+
+#ifdef __AVX__
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 centerX = _mm256_loadu_ps(&bounds.centerX[i]);
+		__m256 centerY = _mm256_loadu_ps(&bounds.centerY[i]);
+		__m256 centerZ = _mm256_loadu_ps(&bounds.centerZ[i]);
+		__m256 extentX = _mm256_loadu_ps(&bounds.extentX[i]);
+		__m256 extentY = _mm256_loadu_ps(&bounds.extentY[i]);
+		__m256 extentZ = _mm256_loadu_ps(&bounds.extentZ[i]);
+		__m256 outside = _mm256_setzero_ps();
+		for (const vec4& plane : _Planes)
+		{
+			// Distance of the centre, plus the box's projected radius along the normal
+			__m256 distance = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(centerX, _mm256_set1_ps(plane.x)), _mm256_mul_ps(centerY, _mm256_set1_ps(plane.y))),
+				_mm256_add_ps(_mm256_mul_ps(centerZ, _mm256_set1_ps(plane.z)), _mm256_set1_ps(plane.w)));
+			__m256 radius = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(extentX, _mm256_set1_ps(fabsf(plane.x))), _mm256_mul_ps(extentY, _mm256_set1_ps(fabsf(plane.y)))),
+				_mm256_mul_ps(extentZ, _mm256_set1_ps(fabsf(plane.z))));
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+		}
+		int mask = _mm256_movemask_ps(outside);
+		for (int lane = 0; lane < 8; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+		}
+	}
+#endif
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 centerX = _mm_loadu_ps(&bounds.centerX[i]);
+		__m128 centerY = _mm_loadu_ps(&bounds.centerY[i]);
+		__m128 centerZ = _mm_loadu_ps(&bounds.centerZ[i]);
+		__m128 extentX = _mm_loadu_ps(&bounds.extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&bounds.extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&bounds.extentZ[i]);
+		__m128 outside = _mm_setzero_ps();
+		for (const vec4& plane : _Planes)
+		{
+			__m128 distance = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+				_mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			__m128 radius = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(extentY, _mm_set1_ps(fabsf(plane.y)))),
+				_mm_mul_ps(extentZ, _mm_set1_ps(fabsf(plane.z))));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(outside);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			visible[i + lane] = (mask >> lane) & 1 ? 0 : 1;
+		}
+	}
+
+	for (; i < count; ++i)
+	{
+		visible[i] = isVisible(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]) ? 1 : 0;
+	}
+}
+
+bool Frustum::isVisible(float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ) const
+{
+	for (const vec4& plane : _Planes)
+	{
+		float distance = centerX * plane.x + centerY * plane.y + centerZ * plane.z + plane.w;
+		float radius = extentX * fabsf(plane.x) + extentY * fabsf(plane.y) + extentZ * fabsf(plane.z);
+		if (distance + radius < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
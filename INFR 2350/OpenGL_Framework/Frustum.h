@@ -0,0 +1,56 @@
+#pragma once
+#include <MiniMath/Core.h>
+#include <vector>
+#include <cstddef>
+
+/*
+	///// // Frustum // /////
+
+	The six planes of a view projection, for culling bounding boxes against what a camera sees,
+	perspective or orthographic alike.
+
+	Boxes are kept as centres and half extents in separate arrays (see BoundsList), so test()
+	checks four of them per SSE instruction, or eight with AVX when the build targets it.
+	A box is culled only when it is entirely outside one of the planes, which never drops a
+	visible box but keeps a few that are just off a corner of the frustum.
+*/
+
+// World space bounding boxes, structure of arrays
+struct BoundsList
+{
+	void clear();
+	void add(const vec3 &boundsMin, const vec3 &boundsMax);
+	size_t size() const;
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+};
+
+class Frustum
+{
+public:
+	enum class Containment
+	{
+		Outside,
+		Intersecting,
+		Inside
+	};
+
+	Frustum() = default;
+	explicit Frustum(const mat4 &viewProjection);
+
+	// Extracts the planes from the rows of the matrix, pointing inwards and normalized
+	void setViewProjection(const mat4 &viewProjection);
+
+	bool isVisible(const vec3 &boundsMin, const vec3 &boundsMax) const;
+	// Whether a box is entirely inside, for hierarchies to accept whole subtrees without testing them
+	Containment classify(const vec3 &boundsMin, const vec3 &boundsMax) const;
+	// Fills visible with 1 for each box in bounds that may be seen, 0 for the rest
+	void test(const BoundsList &bounds, std::vector<unsigned char> &visible) const;
+
+private:
+	bool isVisible(float centerX, float centerY, float centerZ, float extentX, float extentY, float extentZ) const;
+
+	// Left, right, bottom, top, near, far. xyz is the normal, w the distance.
+	vec4 _Planes[6];
+};
@@ -3,11 +3,15 @@
 #include "TextureCube.h"
 #include "UI.h"
 #include "Light.h"
+#include "AssetLoader.h"
+#include "TextureStreamer.h"
+#include "DynamicResolution.h"
 
 #include <vector>
 #include <string>
 #include <fstream>
 #include <random>
+#include <algorithm>
 
 Game::Game()
 {
@@ -24,35 +28,62 @@ bool toonActive = false;
 bool rimActive = false;
 bool ambientActive = false;
 bool specularActive = false;
+bool gradeActive = true;
+float gradeAmount = 1.0f;
+bool upscaleActive = true;
+bool taaActive = true;
+// Samples per pixel of the scene targets are 1 << msaaLevel
+int msaaLevel = 2;
+// Opaque objects lay down depth first, so the full shading only runs for the visible pixels
+bool depthPrepassActive = true;
+// Objects hidden behind what was drawn last frame, or this frame, are skipped on the GPU
+bool occlusionCullingActive = true;
+// Objects hidden behind the island and tree are dropped on the CPU, before the GPU sees them
+bool softwareOcclusionActive = true;
+// Heavy meshes the Hi-Z culling leaves alone are tested with hardware queries on their bounding boxes
+bool occlusionQueriesActive = true;
+// RCAS sharpness in stops, 0 is the strongest
+float sharpness = 0.2f;
 
 void Game::initializeGame()
 {
 	ShaderProgram::initDefault();
 	Framebuffer::initFrameBuffers();
-	framebuffer.addDepthTarget();
-	framebuffer.addColorTarget(GL_RGB8);
-	framebuffer.init(windowWidth, windowHeight);
 	framebufferTV.addDepthTarget();
 	framebufferTV.addColorTarget(GL_RGB8);
 	framebufferTV.init(128, 128);
-	meshIsland.LoadFromObj("island.obj");
-	meshTree.LoadFromObj("tree.obj");
-	meshLeaves.LoadFromObj("leaves.obj");
-	meshSphere.initMeshSphere(32U, 32U);
-	meshSkybox.initMeshSphere(32U, 32U, true);
-	meshLight.initMeshSphere(6U, 6U);
+	// Assets decode on worker threads and upload over the next frames, drawing placeholders until then.
+	// ResourceManager shares each file between everything that asks for it.
+	meshIsland = ResourceManager::getMesh("island.obj");
+	meshTree = ResourceManager::getMesh("tree.obj");
+	meshLeaves = ResourceManager::getMesh("leaves.obj");
+	meshSphere = std::make_shared<Mesh>();
+	meshSphere->initMeshSphere(32U, 32U);
+	meshSkybox = std::make_shared<Mesh>();
+	meshSkybox->initMeshSphere(32U, 32U, true);
+	meshLight = std::make_shared<Mesh>();
+	meshLight->initMeshSphere(6U, 6U);
 	
-	shaderBasic.load("shader.vert", "shader.frag");
-	shaderTexture.load("shader.vert", "shaderTexture.frag");
-	shaderRim.load("shader.vs", "shader.fs");
-	shaderSky.load("shaderSky.vert", "shaderSky.frag");
+	shaderBasic = ResourceManager::getShader("shader.vert", "shader.frag");
+	shaderTexture = ResourceManager::getShader("shader.vert", "shaderTexture.frag");
+	shaderRim = ResourceManager::getShader("shader.vs", "shader.fs");
+	shaderSky = ResourceManager::getShader("shaderSky.vert", "shaderSky.frag");
+	shaderPassthrough = ResourceManager::getShader("passthrough.vert", "passthrough.frag");
+	shaderGrade = ResourceManager::getShader("passthrough.vert", "grade.frag");
+	shaderUpscale = ResourceManager::getShader("passthrough.vert", "easu.frag");
+	shaderSharpen = ResourceManager::getShader("passthrough.vert", "rcas.frag");
+	shaderTAA = ResourceManager::getShader("passthrough.vert", "taa.frag");
+	shaderDepth = ResourceManager::getShader("depthOnly.vert", "depthOnly.frag");
+	// Foliage antialiases its cutout edges through alpha to coverage, without discard turning off early depth testing
+	shaderCutout = std::make_shared<ShaderProgram>();
+	shaderCutout->setSpecialization("ALPHA_DISCARD", 0, 0);
+	shaderCutout->setSpecialization("ALPHA_TO_COVERAGE", 1, 1);
+	shaderCutout->load("shader.vert", "shaderTextureAlphaDiscard.frag");
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	hiZCuller.init();
+	occlusionQueries.init();
 
-	ResourceManager::Shaders.push_back(&shaderBasic);
-	ResourceManager::Shaders.push_back(&shaderTexture);
-	ResourceManager::Shaders.push_back(&shaderRim);
-	ResourceManager::Shaders.push_back(&shaderSky);
-
-	uniformBufferCamera.allocateMemory(sizeof(mat4) * 2);
+	uniformBufferCamera.allocateMemory(sizeof(mat4) * 4); // Projection, view, and the unjittered view projection this and last frame
 	uniformBufferCamera.bind(0);
 	uniformBufferTime.allocateMemory(sizeof(float));
 	uniformBufferTime.bind(1);
@@ -67,6 +98,13 @@ void Game::initializeGame()
 	uniformBufferAmbient.bind(7);
 	uniformBufferSpecular.allocateMemory(sizeof(int)); // SPECULAR
 	uniformBufferSpecular.bind(8);
+	uniformBufferToonRamp.allocateMemory(sizeof(int) * 2); // Pool and layer of the active ramp
+	uniformBufferToonRamp.bind(9);
+	uniformBufferGrade.allocateMemory(sizeof(float)); // Blend between the scene and its graded colour
+	uniformBufferGrade.bind(10);
+	uniformBufferGrade.sendFloat(gradeAmount, 0);
+	uniformBufferResolution.allocateMemory(sizeof(vec4)); // Rendered part of the scene target
+	uniformBufferResolution.bind(11);
 	
 	uniformBufferToon.sendBool(false, 0);
 	uniformBufferLightScene.sendVector(vec3(0.2f), 0);
@@ -77,37 +115,44 @@ void Game::initializeGame()
 	uniformBufferSpecular.sendBool(false, 0);
 	uniformBufferLightScene.sendVector(vec3(0.2f), 0);
 
-	Texture* texBlack = new Texture("black.png");
-	Texture* texYellow = new Texture("yellow.png");
-	Texture* texTreeAlbedo = new Texture("TreeAlbedo.png");
-	Texture* texTreeSpecular = new Texture("TreeSpecular.png");
-	Texture* texIslandAlbedo = new Texture("IslandAlbedo.png");
-	Texture* texIslandSpecular = new Texture("IslandSpecular.png");
-	Texture* texLeavesAlbedo = new Texture("LeavesAlbedo.png");
-	Texture* texLeavesSpecular = new Texture("LeavesSpecular.png");
+	// Albedo placeholders are white, emissive and specular placeholders are black
+	TextureOptions dark;
+	dark.placeholder = 0;
+	std::shared_ptr<Texture> texBlack = ResourceManager::getTexture("black.png", dark);
+	std::shared_ptr<Texture> texYellow = ResourceManager::getTexture("yellow.png", dark);
+	std::shared_ptr<Texture> texTreeAlbedo = ResourceManager::getTexture("TreeAlbedo.png");
+	std::shared_ptr<Texture> texTreeSpecular = ResourceManager::getTexture("TreeSpecular.png", dark);
+	std::shared_ptr<Texture> texIslandAlbedo = ResourceManager::getTexture("IslandAlbedo.png");
+	std::shared_ptr<Texture> texIslandSpecular = ResourceManager::getTexture("IslandSpecular.png", dark);
+	std::shared_ptr<Texture> texLeavesAlbedo = ResourceManager::getTexture("LeavesAlbedo.png");
+	std::shared_ptr<Texture> texLeavesSpecular = ResourceManager::getTexture("LeavesSpecular.png", dark);
 
 	// TODO: Load toon texture ramp
-	textureToonRamp.push_back(new Texture("TF2.jpg", false));
-	textureToonRamp[0]->setWrapParameters(GL_CLAMP_TO_EDGE);
-	textureToonRamp[0]->setFilterParameters(GL_NEAREST, GL_NEAREST);
-	textureToonRamp[0]->sendTexParameters();
-	textureToonRamp.push_back(new Texture("toonramp1.png", false));
-	textureToonRamp[1]->setWrapParameters(GL_CLAMP_TO_EDGE);
-	textureToonRamp[1]->sendTexParameters();
-	textureToonRamp.push_back(new Texture("toonramp2.png", false));
-	textureToonRamp[2]->setWrapParameters(GL_CLAMP_TO_EDGE);
-	textureToonRamp[2]->sendTexParameters();
-
-	std::vector<Texture*> texTree = { texTreeAlbedo, texBlack, texTreeSpecular };
-	std::vector<Texture*> texIsland = { texIslandAlbedo, texBlack, texIslandSpecular };
-	std::vector<Texture*> texSun = { texBlack, texYellow, texBlack };
-	std::vector<Texture*> texLeaves = { texLeavesAlbedo, texBlack, texLeavesSpecular };
-
-	goSun = GameObject(&meshSphere, texSun);
+	TextureOptions ramp;
+	ramp.mipmap = false;
+	ramp.wrap = GL_CLAMP_TO_EDGE;
+	ramp.compression = TextureCompression::None;
+	TextureOptions rampNearest = ramp;
+	rampNearest.magFilter = GL_NEAREST;
+	rampNearest.minFilter = GL_NEAREST;
+	textureToonRamp.push_back(ResourceManager::getTexture("TF2.jpg", rampNearest));
+	textureToonRamp.push_back(ResourceManager::getTexture("toonramp1.png", ramp));
+	textureToonRamp.push_back(ResourceManager::getTexture("toonramp2.png", ramp));
+
+	// Parsed once and cached as a .lut, grading only costs a 3D texture fetch per pixel
+	textureLUT = std::make_shared<Texture>();
+	textureLUT->loadLUT("Warm.cube");
+
+	std::vector<std::shared_ptr<Texture>> texTree = { texTreeAlbedo, texBlack, texTreeSpecular };
+	std::vector<std::shared_ptr<Texture>> texIsland = { texIslandAlbedo, texBlack, texIslandSpecular };
+	std::vector<std::shared_ptr<Texture>> texSun = { texBlack, texYellow, texBlack };
+	std::vector<std::shared_ptr<Texture>> texLeaves = { texLeavesAlbedo, texBlack, texLeavesSpecular };
+
+	goSun = GameObject(meshSphere, texSun);
 	goSun.addChild(&light);
-	goTree = GameObject(&meshTree, texTree);
-	goIsland = GameObject(&meshIsland, texIsland);
-	goLeaves = GameObject(&meshLeaves, texLeaves);
+	goTree = GameObject(meshTree, texTree);
+	goIsland = GameObject(meshIsland, texIsland);
+	goLeaves = GameObject(meshLeaves, texLeaves);
 
 	std::vector<std::string> skyboxTex;
 	skyboxTex.push_back("sky2/sky_c00.bmp");
@@ -116,9 +161,10 @@ void Game::initializeGame()
 	skyboxTex.push_back("sky2/sky_c03.bmp");
 	skyboxTex.push_back("sky2/sky_c04.bmp");
 	skyboxTex.push_back("sky2/sky_c05.bmp");
-	goSkybox = GameObject(&meshSkybox, new TextureCube(skyboxTex));
-	//goSkybox = GameObject(&meshSkybox, new TextureCube("Sky/Skybox.png"));
-	goSkybox.setShaderProgram(&shaderSky);
+	goSkybox = GameObject(meshSkybox, ResourceManager::getTextureCube(skyboxTex));
+	// A single equirectangular panorama (.hdr or any image) also works, converted to a cube on load
+	//goSkybox = GameObject(meshSkybox, ResourceManager::getTextureCube({ "Sky/Skybox.hdr" }));
+	goSkybox.setShaderProgram(shaderSky);
 
 	ResourceManager::addEntity(&goSun);
 	ResourceManager::addEntity(&goTree);
@@ -135,16 +181,20 @@ void Game::initializeGame()
 	goIsland.setScale(1.f);
 	goLeaves.setScale(1.f);
 
-	goSun.setShaderProgram(&shaderTexture);
-	goTree.setShaderProgram(&shaderTexture);
-	goIsland.setShaderProgram(&shaderTexture);
-	goLeaves.setShaderProgram(&shaderTexture);
+	goSun.setShaderProgram(shaderTexture);
+	goTree.setShaderProgram(shaderTexture);
+	goIsland.setShaderProgram(shaderTexture);
+	goLeaves.setShaderProgram(shaderCutout);
+	goLeaves.setAlphaToCoverage(true);
+	goIsland.setOccluder(true);
+	goTree.setOccluder(true);
 
 	   	 
 	// These Render flags can be set once at the start (No reason to waste time calling these functions every frame).
 	// Tells OpenGL to respect the depth of the scene. Fragments will not render when they are behind other geometry.
 	glEnable(GL_DEPTH_TEST); 
 	glEnable(GL_CULL_FACE);
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 	glCullFace(GL_BACK);
 	   
 	// Basic clear color used by glClear().
@@ -155,7 +205,9 @@ void Game::initializeGame()
 	camera.perspective(90.0f, aspect, 0.05f, 1000.0f);
 	camera.setLocalPos(vec3(0.0f, 4.0f, 4.0f));
 	camera.setLocalRotX(-15.0f);
-	camera.attachFrameBuffer(&framebuffer);
+	cameraTV.perspective(90.0f, 1.0f, 0.05f, 1000.0f);
+	cameraTV.setLocalPos(vec3(0.0f, 12.0f, 0.0f));
+	cameraTV.setLocalRotX(-90.0f);
 
 
 }
@@ -229,41 +281,285 @@ void Game::update()
 
 	light.position = camera.getView() * vec4(goSun.getWorldPos(), 1.0f);
 	light.update(deltaTime);
-	// Give our Transforms a chance to compute the latest matrices
-	camera.update(deltaTime);
+	// Give our Transforms a chance to compute the latest matrices, keeping last frame's for motion vectors
+	for (Transform* object : ResourceManager::Transforms)
+	{
+		object->storePreviousTransform();
+	}
 	for (Transform* object : ResourceManager::Transforms)
 	{
 		object->update(deltaTime);
 	}
+	// The camera culls against where the objects are this frame
+	ResourceManager::updateScene();
+	camera.depthRasterizer = softwareOcclusionActive ? &depthRasterizer : nullptr;
+	camera.update(deltaTime);
+	cameraTV.update(deltaTime);
+	Camera::cullCameras({ &camera, &cameraTV });
 	goSkybox.update(deltaTime);
 }
 
 void Game::draw()
 {
+	// Finish any assets that were decoded since the last frame
+	AssetLoader::update();
+	// Grow or shrink streamed textures based on what was drawn last frame
+	TextureStreamer::update();
+
 	// TODO: Bind toon texture
 
-	textureToonRamp[activeToonRamp]->bind(31);
+	// A pooled ramp is already bound through its TextureArray
+	TextureLayer rampLayer = textureToonRamp[activeToonRamp]->layer;
+	int ramp[2] = { rampLayer.pool, rampLayer.layer };
+	uniformBufferToonRamp.sendData(ramp, sizeof(ramp));
+	if (!rampLayer.isValid())
+	{
+		textureToonRamp[activeToonRamp]->bind(31);
+	}
 
-	uniformBufferCamera.sendMatrix(camera.getLocalToWorld(), sizeof(mat4));
-	goSkybox.draw();
-	glClear(GL_DEPTH_BUFFER_BIT);		
-	
-	uniformBufferTime.sendFloat(TotalGameTime, 0);
-	uniformBufferCamera.sendMatrix(camera.getProjection(), 0);
-	uniformBufferCamera.sendMatrix(camera.getView(), sizeof(mat4));
+	// The scene renders off screen and is graded on its way to the back buffer.
+	// Its targets only ever grow, the scene draws into a viewport scaled to hold the frame time.
+	DynamicResolution::update(gpuTimer.getMilliseconds());
+	renderWidth = (std::max)(renderWidth, (unsigned)windowWidth);
+	renderHeight = (std::max)(renderHeight, (unsigned)windowHeight);
+	unsigned viewportWidth, viewportHeight;
+	DynamicResolution::getViewport(windowWidth, windowHeight, viewportWidth, viewportHeight);
 
-	shaderTexture.bind();
-	shaderTexture.unbind();
-	
-	light.position = camera.getView() * vec4(goSun.getWorldPos(), 1.0f);
-	
-	camera.render();
+	RenderTargetDesc sceneDesc;
+	sceneDesc.width = renderWidth;
+	sceneDesc.height = renderHeight;
+	sceneDesc.format = GL_RGB8;
+	sceneDesc.filter = GL_LINEAR;
+	RenderTargetDesc depthDesc = sceneDesc;
+	depthDesc.format = GL_DEPTH_COMPONENT24;
+	// Screen space motion since last frame, written next to the colour by every scene shader
+	RenderTargetDesc velocityDesc = sceneDesc;
+	velocityDesc.format = GL_RG16F;
+	velocityDesc.filter = GL_NEAREST;
+
+	// Each frame samples a different sub-pixel position for TAA to accumulate
+	vec2 jitter = taaActive ? temporalAA.getJitter(viewportWidth, viewportHeight) : vec2(0.0f);
+	camera.setJitter(jitter);
+
+	// With MSAA the scene draws into multisampled targets, resolved before anything samples them
+	unsigned samples = (unsigned)(std::min)(1 << msaaLevel, maxSamples);
+	bool multisampled = samples > 1;
+	RenderTargetDesc drawColorDesc = sceneDesc;
+	RenderTargetDesc drawVelocityDesc = velocityDesc;
+	RenderTargetDesc drawDepthDesc = depthDesc;
+	drawColorDesc.samples = drawVelocityDesc.samples = drawDepthDesc.samples = samples;
 
-	framebuffer.bindColorAsTexture(0, 0);
-	glViewport(0, 0, windowWidth, windowHeight);
-	framebuffer.drawFSQ();
-	ShaderProgram::unbind();
-	framebuffer.unbindTexture(0);
+	FrameResource backbuffer = frameGraph.importBackbuffer("Backbuffer", windowWidth, windowHeight);
+	FrameResource drawColor = InvalidFrameResource;
+	FrameResource drawVelocity = InvalidFrameResource;
+	FrameResource drawDepth = InvalidFrameResource;
+
+	frameGraph.addPass("Skybox", [&](FrameGraph::Builder& builder)
+	{
+		drawColor = builder.write(builder.create(multisampled ? "Scene Color MSAA" : "Scene Color", drawColorDesc));
+		if (taaActive)
+		{
+			drawVelocity = builder.write(builder.create(multisampled ? "Scene Velocity MSAA" : "Scene Velocity", drawVelocityDesc));
+		}
+	}, [=](const FrameGraph&)
+	{
+		glViewport(0, 0, viewportWidth, viewportHeight);
+		uniformBufferCamera.sendMatrix(camera.getProjection(), 0);
+		uniformBufferCamera.sendMatrix(camera.getLocalToWorld(), sizeof(mat4));
+		uniformBufferCamera.sendMatrix(camera.getUnjitteredViewProjection(), sizeof(mat4) * 2);
+		uniformBufferCamera.sendMatrix(camera.getPreviousViewProjection(), sizeof(mat4) * 3);
+		goSkybox.draw();
+	});
+
+	frameGraph.addPass("Scene", [&](FrameGraph::Builder& builder)
+	{
+		builder.write(drawColor);
+		if (taaActive)
+		{
+			builder.write(drawVelocity);
+		}
+		drawDepth = builder.write(builder.create(multisampled ? "Scene Depth MSAA" : "Scene Depth", drawDepthDesc));
+	}, [=, &drawDepth](const FrameGraph& graph)
+	{
+		// drawDepth is only created by the setup above, after this function was captured
+		glViewport(0, 0, viewportWidth, viewportHeight);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		uniformBufferTime.sendFloat(TotalGameTime, 0);
+		uniformBufferCamera.sendMatrix(camera.getProjection(), 0);
+		uniformBufferCamera.sendMatrix(camera.getView(), sizeof(mat4));
+		uniformBufferCamera.sendMatrix(camera.getUnjitteredViewProjection(), sizeof(mat4) * 2);
+		uniformBufferCamera.sendMatrix(camera.getPreviousViewProjection(), sizeof(mat4) * 3);
+
+		light.position = camera.getView() * vec4(goSun.getWorldPos(), 1.0f);
+
+		TextureStreamer::setView(camera.getProjection(), camera.getLocalToWorld().GetTranslation(), viewportHeight);
+		camera.occlusionCuller = occlusionCullingActive ? &hiZCuller : nullptr;
+		camera.occlusionQueries = occlusionQueriesActive ? &occlusionQueries : nullptr;
+		if (occlusionCullingActive)
+		{
+			hiZCuller.testPrevious(camera.getCullList());
+		}
+		if (depthPrepassActive)
+		{
+			camera.renderDepth(*shaderDepth);
+		}
+		camera.render();
+
+		// Second phase, whatever the new depth shows was wrongly culled is drawn now
+		if (occlusionCullingActive)
+		{
+			hiZCuller.build(graph.getTexture(drawDepth), graph.getDesc(drawDepth), viewportWidth, viewportHeight, camera.getViewProjection());
+			hiZCuller.testCurrent();
+			camera.render();
+		}
+	});
+
+	FrameResource sceneColor = drawColor;
+	FrameResource sceneVelocity = drawVelocity;
+	FrameResource sceneDepth = drawDepth;
+	if (multisampled)
+	{
+		// Only TAA reads motion and depth after the scene
+		frameGraph.addPass("Resolve", [&](FrameGraph::Builder& builder)
+		{
+			sceneColor = builder.resolve(drawColor, builder.create("Scene Color", sceneDesc));
+			if (taaActive)
+			{
+				sceneVelocity = builder.resolve(drawVelocity, builder.create("Scene Velocity", velocityDesc));
+				sceneDepth = builder.resolve(drawDepth, builder.create("Scene Depth", depthDesc));
+			}
+		}, [](const FrameGraph&) {});
+	}
+
+	// TAA resolves the jittered scene at window size, upscaling it when the viewport is smaller.
+	// Otherwise, below native resolution the scene is upscaled along its edges.
+	// Either way the result is sharpened before grading.
+	FrameResource finalColor = sceneColor;
+	unsigned finalWidth = viewportWidth, finalHeight = viewportHeight;
+	unsigned finalTargetWidth = renderWidth, finalTargetHeight = renderHeight;
+	RenderTargetDesc outputDesc = sceneDesc;
+	outputDesc.width = windowWidth;
+	outputDesc.height = windowHeight;
+	if (taaActive)
+	{
+		temporalAA.beginFrame(windowWidth, windowHeight);
+		FrameResource history = frameGraph.importTexture("TAA History", temporalAA.getHistory(), temporalAA.getDesc());
+		FrameResource resolved = frameGraph.importTexture("TAA Output", temporalAA.getOutput(), temporalAA.getDesc());
+		// Jitter in scene pixels, NDC spans two viewports
+		vec2 jitterPixels = vec2(jitter.x * viewportWidth, jitter.y * viewportHeight) * 0.5f;
+		bool historyValid = temporalAA.hasHistory();
+		float feedback = temporalAA.feedback;
+
+		frameGraph.addPass("Temporal AA", [&](FrameGraph::Builder& builder)
+		{
+			builder.read(sceneColor);
+			builder.read(sceneVelocity);
+			builder.read(sceneDepth);
+			builder.read(history);
+			finalColor = builder.write(resolved);
+		}, [=](const FrameGraph& graph)
+		{
+			sendResolution(viewportWidth, viewportHeight, renderWidth, renderHeight);
+			graph.bindTexture(sceneColor, 0);
+			graph.bindTexture(sceneVelocity, 1);
+			graph.bindTexture(sceneDepth, 2);
+			graph.bindTexture(history, 3);
+			shaderTAA->bind();
+			shaderTAA->sendUniform("uJitter", jitterPixels);
+			shaderTAA->sendUniform("uFeedback", feedback);
+			shaderTAA->sendUniform("uHistoryValid", historyValid ? 1 : 0);
+			Framebuffer::drawFSQ();
+			for (int slot = 1; slot <= 3; ++slot)
+			{
+				glBindTextureUnit(slot, GL_NONE);
+			}
+		});
+	}
+	else if (upscaleActive && (viewportWidth < (unsigned)windowWidth || viewportHeight < (unsigned)windowHeight))
+	{
+		frameGraph.addPass("Upscale", [&](FrameGraph::Builder& builder)
+		{
+			builder.read(sceneColor);
+			finalColor = builder.write(builder.create("Upscaled Color", outputDesc));
+		}, [=](const FrameGraph& graph)
+		{
+			sendResolution(viewportWidth, viewportHeight, renderWidth, renderHeight);
+			graph.bindTexture(sceneColor, 0);
+			shaderUpscale->bind();
+			Framebuffer::drawFSQ();
+		});
+	}
+
+	if (finalColor != sceneColor)
+	{
+		FrameResource resolvedColor = finalColor;
+		frameGraph.addPass("Sharpen", [&](FrameGraph::Builder& builder)
+		{
+			builder.read(resolvedColor);
+			finalColor = builder.write(builder.create("Sharpened Color", outputDesc));
+		}, [=](const FrameGraph& graph)
+		{
+			graph.bindTexture(resolvedColor, 0);
+			shaderSharpen->bind();
+			shaderSharpen->sendUniform("uSharpness", sharpness);
+			Framebuffer::drawFSQ();
+		});
+
+		finalWidth = finalTargetWidth = windowWidth;
+		finalHeight = finalTargetHeight = windowHeight;
+	}
+
+	frameGraph.addPass("Grade", [&](FrameGraph::Builder& builder)
+	{
+		builder.read(finalColor);
+		builder.write(backbuffer);
+	}, [=](const FrameGraph& graph)
+	{
+		sendResolution(finalWidth, finalHeight, finalTargetWidth, finalTargetHeight);
+		graph.bindTexture(finalColor, 0);
+		bool grading = gradeActive && textureLUT->getID() != 0;
+		if (grading)
+		{
+			shaderGrade->bind();
+			textureLUT->bind(30);
+		}
+		else
+		{
+			shaderPassthrough->bind();
+		}
+		Framebuffer::drawFSQ();
+		ShaderProgram::unbind();
+		if (grading)
+		{
+			textureLUT->unbind(30);
+		}
+		glBindTextureUnit(0, GL_NONE);
+	});
+
+	gpuTimer.begin();
+	frameGraph.compile();
+	frameGraph.execute();
+	gpuTimer.end();
+
+	// The TV's view, outside the frame graph since it has its own targets
+	framebufferTV.clear();
+	framebufferTV.bind();
+	framebufferTV.setViewport();
+	uniformBufferCamera.sendMatrix(cameraTV.getProjection(), 0);
+	uniformBufferCamera.sendMatrix(cameraTV.getView(), sizeof(mat4));
+	uniformBufferCamera.sendMatrix(cameraTV.getUnjitteredViewProjection(), sizeof(mat4) * 2);
+	uniformBufferCamera.sendMatrix(cameraTV.getPreviousViewProjection(), sizeof(mat4) * 3);
+	// Lighting is done in view space, and texture footprints are measured in the TV's own pixels
+	light.position = cameraTV.getView() * vec4(goSun.getWorldPos(), 1.0f);
+	light.update(0.0f);
+	TextureStreamer::setView(cameraTV.getProjection(), cameraTV.getLocalToWorld().GetTranslation(), framebufferTV._Height);
+	cameraTV.render();
+	framebufferTV.unbind();
+	if (taaActive)
+	{
+		temporalAA.endFrame();
+	}
 
 	if(guiEnabled)
 		GUI();
@@ -272,6 +568,16 @@ void Game::draw()
 	glutSwapBuffers();
 }
 
+void Game::sendResolution(unsigned viewportWidth, unsigned viewportHeight, unsigned targetWidth, unsigned targetHeight)
+{
+	float resolution[4] =
+	{
+		(float)viewportWidth / targetWidth, (float)viewportHeight / targetHeight,
+		(viewportWidth - 0.5f) / targetWidth, (viewportHeight - 0.5f) / targetHeight
+	};
+	uniformBufferResolution.sendData(resolution, sizeof(resolution));
+}
+
 int minCurrMode = 5;
 int magCurrMode = 1;
 void Game::GUI()
@@ -296,6 +602,44 @@ void Game::GUI()
 		uniformBufferSpecular.sendBool(specularActive, 0);
 	}
 
+	ImGui::Checkbox("Dynamic Resolution", &DynamicResolution::enabled);
+	ImGui::Text("GPU: %.2f ms, Resolution Scale: %.0f%%", gpuTimer.getMilliseconds(), DynamicResolution::getScale() * 100.0f);
+
+	ImGui::Checkbox("Upscaler Active", &upscaleActive);
+	ImGui::SliderFloat("Sharpness (stops)", &sharpness, 0.0f, 2.0f);
+	ImGui::Checkbox("Depth Pre-Pass", &depthPrepassActive);
+	if (ImGui::Checkbox("Occlusion Culling", &occlusionCullingActive))
+	{
+		// The pyramid is stale once the camera moved without it
+		hiZCuller.reset();
+	}
+	ImGui::Checkbox("Occlusion Queries", &occlusionQueriesActive);
+	if (occlusionQueriesActive)
+	{
+		ImGui::Text("Hidden by queries: %d", occlusionQueries.getNumHidden());
+	}
+	ImGui::Checkbox("Software Occlusion Culling", &softwareOcclusionActive);
+	if (softwareOcclusionActive)
+	{
+		ImGui::Text("Occluders: %d, Triangles: %d, Drawn: %d", depthRasterizer.getNumOccluders(), depthRasterizer.getNumTriangles(), (int)camera.getCullList().size());
+	}
+	ImGui::Text("TV Drawn: %d", (int)cameraTV.getCullList().size());
+	// Flipped, textures start at the bottom
+	ImGui::Image((ImTextureID)(intptr_t)framebufferTV._Color._Tex[0].getID(), ImVec2(128.0f, 128.0f), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+	ImGui::Combo("MSAA", &msaaLevel, "Off\0" "2x\0" "4x\0" "8x\0");
+	if (ImGui::Checkbox("Temporal AA Active", &taaActive))
+	{
+		// The history stopped following the camera while TAA was off
+		temporalAA.reset();
+	}
+	ImGui::SliderFloat("Temporal AA Feedback", &temporalAA.feedback, 0.5f, 0.98f);
+
+	ImGui::Checkbox("Color Grading Active", &gradeActive);
+	if (ImGui::SliderFloat("Color Grading Amount", &gradeAmount, 0.0f, 1.0f))
+	{
+		uniformBufferGrade.sendFloat(gradeAmount, 0);
+	}
+
 	if (ImGui::SliderInt("Toon Ramp Selection", &activeToonRamp, 0, (int)textureToonRamp.size()-1))
 	{
 
@@ -316,6 +660,12 @@ void Game::GUI()
 	
 	ImGui::Text("Radius: %f", light.radius);
 
+	ImGui::Text("Streamed Textures: %d (%.1f / %.1f MB)", TextureStreamer::getNumTextures(),
+		TextureStreamer::getResidentBytes() / (1024.0f * 1024.0f), TextureStreamer::budgetBytes / (1024.0f * 1024.0f));
+	ImGui::Text("Pooled Textures: %d in %d arrays", TextureArray::getNumLayers(), TextureArray::getNumPools());
+	ImGui::Text("Frame Graph: %d passes (%d culled), %d targets (%.1f MB)", frameGraph.getNumPasses(), frameGraph.getNumCulledPasses(),
+		frameGraph.getNumPooledTextures(), frameGraph.getPooledBytes() / (1024.0f * 1024.0f));
+
 	UI::End();
 }
 
@@ -804,6 +1154,5 @@ void Game::reshapeWindow(int w, int h)
 	float aspect = static_cast<float>(windowWidth) / static_cast<float>(windowHeight);
 	camera.perspective(90.0f, aspect, 0.05f, 1000.0f);
 	glViewport(0, 0, w, h);
-	framebuffer.reshape(w, h);
 
 }
@@ -17,6 +17,12 @@
 #include "UniformBuffer.h"
 #include "Light.h"
 #include "Framebuffer.h"
+#include "FrameGraph.h"
+#include "GpuTimer.h"
+#include "TemporalAA.h"
+#include "HiZCuller.h"
+#include "DepthRasterizer.h"
+#include "OcclusionQueries.h"
 
 #define WINDOW_SCREEN_WIDTH		640
 #define WINDOW_SCREEN_HEIGHT	432
@@ -53,14 +59,17 @@ public:
 	int windowHeight = WINDOW_HEIGHT;
 
 private:
+	// Tells the final passes which part of their source texture holds the image
+	void sendResolution(unsigned viewportWidth, unsigned viewportHeight, unsigned targetWidth, unsigned targetHeight);
+
 	// Scene Objects.
 	Camera camera;
-	Mesh meshSphere;
-	Mesh meshSkybox;
-	Mesh meshLight;
-	Mesh meshIsland;
-	Mesh meshTree;
-	Mesh meshLeaves;
+	std::shared_ptr<Mesh> meshSphere;
+	std::shared_ptr<Mesh> meshSkybox;
+	std::shared_ptr<Mesh> meshLight;
+	std::shared_ptr<Mesh> meshIsland;
+	std::shared_ptr<Mesh> meshTree;
+	std::shared_ptr<Mesh> meshLeaves;
 
 	GameObject goSun;
 	GameObject goSkybox;
@@ -69,10 +78,17 @@ private:
 	GameObject goLeaves;
 
 	// OpenGL Handles
-	ShaderProgram shaderBasic;
-	ShaderProgram shaderTexture;
-	ShaderProgram shaderRim;
-	ShaderProgram shaderSky;
+	std::shared_ptr<ShaderProgram> shaderBasic;
+	std::shared_ptr<ShaderProgram> shaderTexture;
+	std::shared_ptr<ShaderProgram> shaderRim;
+	std::shared_ptr<ShaderProgram> shaderSky;
+	std::shared_ptr<ShaderProgram> shaderPassthrough;
+	std::shared_ptr<ShaderProgram> shaderGrade;
+	std::shared_ptr<ShaderProgram> shaderUpscale;
+	std::shared_ptr<ShaderProgram> shaderSharpen;
+	std::shared_ptr<ShaderProgram> shaderTAA;
+	std::shared_ptr<ShaderProgram> shaderCutout;
+	std::shared_ptr<ShaderProgram> shaderDepth;
 
 	UniformBuffer uniformBufferCamera;
 	UniformBuffer uniformBufferTime;
@@ -81,12 +97,27 @@ private:
 	UniformBuffer uniformBufferRim;
 	UniformBuffer uniformBufferAmbient;
 	UniformBuffer uniformBufferSpecular;
-
-	Framebuffer framebuffer;
+	UniformBuffer uniformBufferToonRamp;
+	UniformBuffer uniformBufferGrade;
+	UniformBuffer uniformBufferResolution;
+
+	FrameGraph frameGraph;
+	GpuTimer gpuTimer;
+	TemporalAA temporalAA;
+	HiZCuller hiZCuller;
+	DepthRasterizer depthRasterizer;
+	OcclusionQueries occlusionQueries;
+	// Size of the scene targets, the largest the window has been
+	unsigned renderWidth = 0;
+	unsigned renderHeight = 0;
+	int maxSamples = 1;
 	Framebuffer framebufferTV;
+	// Looks down on the island into framebufferTV, culled alongside camera
+	Camera cameraTV;
 
 	Light light;
-	std::vector<Texture*> textureToonRamp;
+	std::vector<std::shared_ptr<Texture>> textureToonRamp;
+	std::shared_ptr<Texture> textureLUT;
 
 	bool guiEnabled = false;
 
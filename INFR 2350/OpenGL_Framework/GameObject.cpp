@@ -1,16 +1,19 @@
 #include "GameObject.h"
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <cfloat>
 
 GameObject::GameObject()
 {
 }
 
-GameObject::GameObject(Mesh * _mesh, Texture * _texture)
+GameObject::GameObject(std::shared_ptr<Mesh> _mesh, std::shared_ptr<Texture> _texture)
 {
 	setMesh(_mesh);
 	setTexture(_texture);
 }
 
-GameObject::GameObject(Mesh * _mesh, std::vector<Texture*> &_textures)
+GameObject::GameObject(std::shared_ptr<Mesh> _mesh, const std::vector<std::shared_ptr<Texture>> &_textures)
 {
 	setMesh(_mesh);
 	setTextures(_textures);
@@ -21,45 +24,192 @@ GameObject::~GameObject()
 
 }
 
-void GameObject::setMesh(Mesh * _mesh)
+void GameObject::setMesh(std::shared_ptr<Mesh> _mesh)
 {
 	mesh = _mesh;
 }
 
-void GameObject::setTexture(Texture * _texture)
+void GameObject::setTexture(std::shared_ptr<Texture> _texture)
 {
 	textures.clear();
 	textures.push_back(_texture);
 }
 
-void GameObject::setTextures(std::vector<Texture*> &_textures)
+void GameObject::setTextures(const std::vector<std::shared_ptr<Texture>> &_textures)
 {
-	textures.clear();
-	for (Texture* texture : _textures)
+	textures = _textures;
+}
+
+void GameObject::setShaderProgram(std::shared_ptr<ShaderProgram> _shaderProgram)
+{
+	material = _shaderProgram;
+}
+
+void GameObject::setAlphaToCoverage(bool enabled)
+{
+	alphaToCoverage = enabled;
+}
+
+void GameObject::setOccluder(bool enabled, std::shared_ptr<Mesh> _occluderMesh)
+{
+	occluder = enabled;
+	occluderMesh = _occluderMesh;
+}
+
+bool GameObject::drawDepth(const ShaderProgram & program)
+{
+	return drawMeshDepth(program, -1);
+}
+
+void GameObject::drawIndirect(size_t command)
+{
+	drawMesh((GLintptr)command);
+}
+
+bool GameObject::drawDepthIndirect(const ShaderProgram & program, size_t command)
+{
+	return drawMeshDepth(program, (GLintptr)command);
+}
+
+bool GameObject::getWorldBounds(vec3 & boundsMin, vec3 & boundsMax)
+{
+	if (!mesh || !mesh->isLoaded())
+	{
+		return false;
+	}
+
+	mat4 localToWorld = getLocalToWorld();
+	vec3 localMin = mesh->getBoundsMin();
+	vec3 localMax = mesh->getBoundsMax();
+	boundsMin = vec3(FLT_MAX);
+	boundsMax = vec3(-FLT_MAX);
+	for (int i = 0; i < 8; ++i)
 	{
-		textures.push_back(texture);
+		vec3 corner(i & 1 ? localMax.x : localMin.x, i & 2 ? localMax.y : localMin.y, i & 4 ? localMax.z : localMin.z);
+		vec3 world = vec3(localToWorld * vec4(corner, 1.0f));
+		boundsMin = vec3((std::min)(boundsMin.x, world.x), (std::min)(boundsMin.y, world.y), (std::min)(boundsMin.z, world.z));
+		boundsMax = vec3((std::max)(boundsMax.x, world.x), (std::max)(boundsMax.y, world.y), (std::max)(boundsMax.z, world.z));
 	}
+	return true;
 }
 
-void GameObject::setShaderProgram(ShaderProgram * _shaderProgram)
+unsigned int GameObject::getNumVertices()
 {
-	material = _shaderProgram;
+	return mesh && mesh->isLoaded() ? (unsigned int)mesh->getNumVertices() : 0;
+}
+
+const Mesh* GameObject::getOccluderMesh()
+{
+	if (!occluder)
+	{
+		return nullptr;
+	}
+	return occluderMesh ? occluderMesh.get() : mesh.get();
+}
+
+RenderState GameObject::getRenderState()
+{
+	RenderState state;
+	state.pass = alphaToCoverage ? RenderState::Cutout : RenderState::Opaque;
+	state.shader = material ? material->getID() : 0;
+	state.material = 0;
+	if (!textures.empty())
+	{
+		// Pooled textures are never bound, objects sharing a pool sort together
+		const TextureLayer &layer = textures[0]->layer;
+		state.material = layer.isValid() ? TextureArray::FirstUnit + layer.pool : textures[0]->getID();
+	}
+	return state;
+}
+
+bool GameObject::drawMeshDepth(const ShaderProgram & program, GLintptr indirectCommand)
+{
+	if (alphaToCoverage || !mesh->isLoaded())
+	{
+		return false;
+	}
+	program.sendUniform("uModel", getLocalToWorld());
+	if (indirectCommand >= 0)
+	{
+		mesh->drawDepthIndirect(indirectCommand);
+	}
+	else
+	{
+		mesh->drawDepth();
+	}
+	return true;
 }
 
 void GameObject::draw()
 {
+	drawMesh(-1);
+}
+
+void GameObject::drawMesh(GLintptr indirectCommand)
+{
+	// Tell the streamer how much of the screen the textures cover
+	if (mesh->isLoaded())
+	{
+		mat4 localToWorld = getLocalToWorld();
+		vec3 center = vec3(localToWorld * vec4(mesh->getBoundingCenter(), 1.0f));
+		float scale = (std::max)(localToWorld.GetRight().Length(), (std::max)(localToWorld.GetUp().Length(), localToWorld.GetForward().Length()));
+		float radius = mesh->getBoundingRadius() * scale;
+		for (const std::shared_ptr<Texture>& texture : textures)
+		{
+			TextureStreamer::request(texture.get(), center, radius);
+		}
+	}
+
 	material->bind();
 	material->sendUniform("uModel", getLocalToWorld());
-	int i = 0;
-	for (Texture* texture : textures)
+	material->sendUniform("uModelPrev", m_pPreviousLocalToWorld);
+
+	// Pooled textures are already bound through their TextureArray, the shader only needs their layers
+	bool pooling = material->usesTexturePools();
+	int pools[MaxPooledSlots] = { -1, -1, -1 };
+	int layers[MaxPooledSlots] = { -1, -1, -1 };
+	for (int slot = 0; slot < (int)textures.size(); ++slot)
+	{
+		const TextureLayer& layer = textures[slot]->layer;
+		if (pooling && slot < MaxPooledSlots && layer.isValid())
+		{
+			pools[slot] = layer.pool;
+			layers[slot] = layer.layer;
+		}
+		else
+		{
+			textures[slot]->bind(slot);
+		}
+	}
+	if (pooling)
+	{
+		material->sendUniform("uTexPool", pools, MaxPooledSlots);
+		material->sendUniform("uTexLayer", layers, MaxPooledSlots);
+	}
+
+	if (alphaToCoverage)
+	{
+		glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+	}
+	if (indirectCommand >= 0)
+	{
+		mesh->drawIndirect(indirectCommand);
+	}
+	else
+	{
+		mesh->bind();
+		mesh->draw();
+		mesh->unbind();
+	}
+	if (alphaToCoverage)
 	{
-		texture->bind(i++);
+		glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
 	}
-	mesh->bind();
-	mesh->draw();
-	mesh->unbind();
-	for (Texture* texture : textures)
+	for (int slot = 0; slot < (int)textures.size(); ++slot)
 	{
-		texture->unbind(--i);
+		if (slot >= MaxPooledSlots || pools[slot] < 0)
+		{
+			textures[slot]->unbind(slot);
+		}
 	}
 }
@@ -5,6 +5,7 @@
 #include "Texture.h"
 #include "ShaderProgram.h"
 #include <vector>
+#include <memory>
 
 class GameObject : public Transform
 {
@@ -12,18 +13,44 @@ public:
 	GameObject();
 	GameObject(const std::string &meshFile, const std::string &textureFile); // Not defined
 	GameObject(const std::string &meshFile, const std::vector <std::string> &textureFiles); // Not defined
-	GameObject(Mesh* _mesh, Texture *_texture);
-	GameObject(Mesh* _mesh, std::vector <Texture*>& _textures);
+	GameObject(std::shared_ptr<Mesh> _mesh, std::shared_ptr<Texture> _texture);
+	GameObject(std::shared_ptr<Mesh> _mesh, const std::vector <std::shared_ptr<Texture>>& _textures);
 	~GameObject();
 
-	void setMesh(Mesh* _mesh);
-	void setTexture(Texture* _texture);
-	void setTextures(std::vector <Texture*>& _textures);
-	void setShaderProgram(ShaderProgram* _shaderProgram);
+	// Handles are shared, assets from ResourceManager live as long as something draws them
+	void setMesh(std::shared_ptr<Mesh> _mesh);
+	void setTexture(std::shared_ptr<Texture> _texture);
+	void setTextures(const std::vector <std::shared_ptr<Texture>>& _textures);
+	void setShaderProgram(std::shared_ptr<ShaderProgram> _shaderProgram);
+	// Cutout materials that write coverage from alpha, rather than discarding, so depth testing stays early
+	void setAlphaToCoverage(bool enabled);
+	// Large solid objects that hide others on the CPU, see DepthRasterizer. A simpler _occluderMesh,
+	// inside this one's, can stand in for it, otherwise its own mesh is drawn.
+	void setOccluder(bool enabled, std::shared_ptr<Mesh> _occluderMesh = nullptr);
 	void draw();
+	// Cutout materials are left out, their depth depends on the alpha they sample
+	bool drawDepth(const ShaderProgram &program);
+	void drawIndirect(size_t command);
+	bool drawDepthIndirect(const ShaderProgram &program, size_t command);
+	// The mesh's bounds around its transformed corners, once it is loaded
+	bool getWorldBounds(vec3 &boundsMin, vec3 &boundsMax);
+	unsigned int getNumVertices();
+	const Mesh* getOccluderMesh();
+	// Grouped by program and first texture, cutouts after everything opaque
+	RenderState getRenderState();
+
+	// Albedo, emissive and specular, the slots shaders can sample from a TextureArray
+	static const int MaxPooledSlots = 3;
 
 private:
-	Mesh* mesh;
-	std::vector<Texture*> textures;
-	ShaderProgram* material;
+	// Draws directly when indirectCommand is negative
+	void drawMesh(GLintptr indirectCommand);
+	bool drawMeshDepth(const ShaderProgram &program, GLintptr indirectCommand);
+
+	std::shared_ptr<Mesh> mesh;
+	std::vector<std::shared_ptr<Texture>> textures;
+	std::shared_ptr<ShaderProgram> material;
+	bool alphaToCoverage = false;
+	bool occluder = false;
+	std::shared_ptr<Mesh> occluderMesh;
 };
\ No newline at end of file
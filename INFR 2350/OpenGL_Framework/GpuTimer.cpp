@@ -0,0 +1,78 @@
+#include "GpuTimer.h"
+#include "IO.h"
+
+GpuTimer::~GpuTimer()
+{
+	unload();
+}
+
+void GpuTimer::unload()
+{
+	if (_IsInit)
+	{
+		glDeleteQueries(NumQueries, _Queries);
+		_IsInit = false;
+	}
+}
+
+void GpuTimer::begin()
+{
+	SAT_ASSERT(!_IsTiming, "GpuTimer::begin called twice without end!");
+	if (!_IsInit)
+	{
+		glCreateQueries(GL_TIME_ELAPSED, NumQueries, _Queries);
+		_IsInit = true;
+	}
+
+	collect();
+
+	// Every query is still in flight, skip this frame rather than wait for one
+	if (_Pending[_Current])
+	{
+		return;
+	}
+	glBeginQuery(GL_TIME_ELAPSED, _Queries[_Current]);
+	_IsTiming = true;
+}
+
+void GpuTimer::end()
+{
+	if (!_IsTiming)
+	{
+		return;
+	}
+	glEndQuery(GL_TIME_ELAPSED);
+	_Pending[_Current] = true;
+	_Current = (_Current + 1) % NumQueries;
+	_IsTiming = false;
+}
+
+float GpuTimer::getMilliseconds() const
+{
+	return _Milliseconds;
+}
+
+void GpuTimer::collect()
+{
+	// Oldest first, so the newest finished result is the one kept
+	for (int i = 0; i < NumQueries; ++i)
+	{
+		int index = (_Current + i) % NumQueries;
+		if (!_Pending[index])
+		{
+			continue;
+		}
+
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(_Queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			break;
+		}
+
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(_Queries[index], GL_QUERY_RESULT, &nanoseconds);
+		_Milliseconds = (float)(nanoseconds / 1.0e6);
+		_Pending[index] = false;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "GL/glew.h"
+
+/*
+	///// // GpuTimer // /////
+
+	Measures how long the GPU spends on the commands between begin() and end() with
+	GL_TIME_ELAPSED queries.
+
+	Results arrive a few frames late. Each frame uses the next query in a small ring, and
+	getMilliseconds() returns the newest result that is already available, so reading it
+	never stalls the CPU waiting on the GPU.
+*/
+
+class GpuTimer
+{
+public:
+	~GpuTimer();
+	void unload();
+
+	void begin();
+	void end();
+
+	// Time of the most recent measured frame, 0 until the first result arrives
+	float getMilliseconds() const;
+
+	static const int NumQueries = 4;
+
+private:
+	void collect();
+
+	GLuint _Queries[NumQueries] = {};
+	bool _Pending[NumQueries] = {};
+	int _Current = 0;
+	bool _IsInit = false;
+	bool _IsTiming = false;
+	float _Milliseconds = 0.0f;
+};
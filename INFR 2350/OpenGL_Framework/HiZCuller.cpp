@@ -0,0 +1,261 @@
+#include "HiZCuller.h"
+#include "Transform.h"
+#include "Framebuffer.h"
+#include "ResourceManager.h"
+#include "IO.h"
+#include <algorithm>
+
+namespace
+{
+	// Levels down to 1x1, each half the size of the one below rounded up
+	int countLevels(unsigned width, unsigned height)
+	{
+		int levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width = (width + 1) / 2;
+			height = (height + 1) / 2;
+			++levels;
+		}
+		return levels;
+	}
+
+	unsigned nextPowerOfTwo(unsigned value)
+	{
+		unsigned power = 1;
+		while (power < value)
+		{
+			power *= 2;
+		}
+		return power;
+	}
+}
+
+HiZCuller::~HiZCuller()
+{
+	unload();
+}
+
+void HiZCuller::unload()
+{
+	glDeleteFramebuffers((GLsizei)_Framebuffers.size(), _Framebuffers.data());
+	_Framebuffers.clear();
+	glDeleteTextures(1, &_Pyramid);
+	glDeleteBuffers(1, &_BoundsBuffer);
+	glDeleteBuffers(1, &_CommandBuffer);
+	glDeleteVertexArrays(1, &_EmptyVAO);
+	_Pyramid = _BoundsBuffer = _CommandBuffer = _EmptyVAO = 0;
+	_AllocatedWidth = _AllocatedHeight = 0;
+	_NumAllocatedLevels = 0;
+	_Capacity = 0;
+	_HasPyramid = false;
+}
+
+void HiZCuller::init()
+{
+	for (int multisampled = 0; multisampled < 2; ++multisampled)
+	{
+		_CopyProgram[multisampled] = std::make_shared<ShaderProgram>();
+		_CopyProgram[multisampled]->setSpecialization("MULTISAMPLED", 0, multisampled);
+		_CopyProgram[multisampled]->load("passthrough.vert", "hiZCopy.frag");
+	}
+	_ReduceProgram = ResourceManager::getShader("passthrough.vert", "hiZReduce.frag");
+	// The tests only write the command buffer, nothing is rasterized
+	_TestProgram = ResourceManager::getShader("hiZTest.vert", "depthOnly.frag");
+	glCreateVertexArrays(1, &_EmptyVAO);
+}
+
+void HiZCuller::testPrevious(const std::vector<Transform*>& objects)
+{
+	_NumObjects = (int)objects.size();
+	_Bounds.resize(_NumObjects);
+	_Commands.assign(_NumObjects * 2, DrawCommand{ 0, 0, 0, 0 });
+	_Culled.assign(_NumObjects, false);
+
+	for (int i = 0; i < _NumObjects; ++i)
+	{
+		vec3 boundsMin, boundsMax;
+		if (!objects[i]->getWorldBounds(boundsMin, boundsMax))
+		{
+			continue;
+		}
+		_Culled[i] = true;
+		_Bounds[i].boundsMin = vec4(boundsMin, 1.0f);
+		_Bounds[i].boundsMax = vec4(boundsMax, 1.0f);
+		// The tests fill in the instance counts
+		_Commands[i * 2].count = _Commands[i * 2 + 1].count = objects[i]->getNumVertices();
+	}
+
+	if (_NumObjects == 0)
+	{
+		_Phase = 0;
+		return;
+	}
+
+	if ((size_t)_NumObjects > _Capacity)
+	{
+		glDeleteBuffers(1, &_BoundsBuffer);
+		glDeleteBuffers(1, &_CommandBuffer);
+		_Capacity = (std::max)((size_t)_NumObjects, _Capacity * 2);
+		glCreateBuffers(1, &_BoundsBuffer);
+		glNamedBufferStorage(_BoundsBuffer, _Capacity * sizeof(Bounds), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &_CommandBuffer);
+		glNamedBufferStorage(_CommandBuffer, _Capacity * 2 * sizeof(DrawCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+	glNamedBufferSubData(_BoundsBuffer, 0, _NumObjects * sizeof(Bounds), _Bounds.data());
+	glNamedBufferSubData(_CommandBuffer, 0, _NumObjects * 2 * sizeof(DrawCommand), _Commands.data());
+
+	test(0);
+}
+
+void HiZCuller::build(GLuint depthTexture, const RenderTargetDesc & desc, unsigned viewportWidth, unsigned viewportHeight, const mat4 & viewProjection)
+{
+	GLint previousFramebuffer = 0;
+	GLint previousViewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+	allocatePyramid(desc.width, desc.height);
+	_PyramidWidth = viewportWidth;
+	_PyramidHeight = viewportHeight;
+	_NumLevels = countLevels(viewportWidth, viewportHeight);
+
+	glDisable(GL_DEPTH_TEST);
+	glDepthMask(GL_FALSE);
+
+	// Level 0 is the depth itself, the farthest of its samples when multisampled
+	glBindFramebuffer(GL_FRAMEBUFFER, _Framebuffers[0]);
+	glViewport(0, 0, viewportWidth, viewportHeight);
+	_CopyProgram[desc.samples > 1 ? 1 : 0]->bind();
+	glBindTextureUnit(0, depthTexture);
+	Framebuffer::drawFSQ();
+
+	// Each level only samples the one below it, which keeps rendering to it from being a feedback loop
+	_ReduceProgram->bind();
+	glBindTextureUnit(0, _Pyramid);
+	unsigned width = viewportWidth, height = viewportHeight;
+	for (int level = 1; level < _NumLevels; ++level)
+	{
+		_ReduceProgram->sendUniform("uSourceSize", vec2((float)width, (float)height));
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+
+		glTextureParameteri(_Pyramid, GL_TEXTURE_BASE_LEVEL, level - 1);
+		glTextureParameteri(_Pyramid, GL_TEXTURE_MAX_LEVEL, level - 1);
+		glBindFramebuffer(GL_FRAMEBUFFER, _Framebuffers[level]);
+		glViewport(0, 0, width, height);
+		Framebuffer::drawFSQ();
+	}
+	glTextureParameteri(_Pyramid, GL_TEXTURE_BASE_LEVEL, 0);
+	glTextureParameteri(_Pyramid, GL_TEXTURE_MAX_LEVEL, _NumAllocatedLevels - 1);
+
+	glBindTextureUnit(0, GL_NONE);
+	ShaderProgram::unbind();
+	glEnable(GL_DEPTH_TEST);
+	glDepthMask(GL_TRUE);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+
+	_PyramidViewProjection = viewProjection;
+	_HasPyramid = true;
+}
+
+void HiZCuller::testCurrent()
+{
+	SAT_ASSERT(_HasPyramid, "Testing the second phase without a pyramid!");
+	test(1);
+}
+
+void HiZCuller::reset()
+{
+	_HasPyramid = false;
+}
+
+void HiZCuller::bindCommands() const
+{
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _CommandBuffer);
+}
+
+GLintptr HiZCuller::getCommand(size_t object) const
+{
+	if (object >= _Culled.size() || !_Culled[object])
+	{
+		return -1;
+	}
+	return (GLintptr)((object * 2 + _Phase) * sizeof(DrawCommand));
+}
+
+bool HiZCuller::isSecondPhase() const
+{
+	return _Phase == 1;
+}
+
+int HiZCuller::getNumLevels() const
+{
+	return _NumLevels;
+}
+
+void HiZCuller::test(int phase)
+{
+	_Phase = phase;
+	if (_NumObjects == 0)
+	{
+		return;
+	}
+
+	_TestProgram->bind();
+	_TestProgram->sendUniform("uViewProjection", _PyramidViewProjection);
+	_TestProgram->sendUniform("uPhase", phase);
+	_TestProgram->sendUniform("uHiZValid", _HasPyramid ? 1 : 0);
+	_TestProgram->sendUniform("uHiZSize", vec2((float)_PyramidWidth, (float)_PyramidHeight));
+	_TestProgram->sendUniform("uNumLevels", _NumLevels);
+	glBindTextureUnit(0, _Pyramid);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, _BoundsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, _CommandBuffer);
+
+	glEnable(GL_RASTERIZER_DISCARD);
+	glBindVertexArray(_EmptyVAO);
+	glDrawArrays(GL_POINTS, 0, _NumObjects);
+	glBindVertexArray(GL_NONE);
+	glDisable(GL_RASTERIZER_DISCARD);
+
+	// The draws read what the tests wrote as their commands
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	glBindTextureUnit(0, GL_NONE);
+	ShaderProgram::unbind();
+}
+
+void HiZCuller::allocatePyramid(unsigned width, unsigned height)
+{
+	if (width == _AllocatedWidth && height == _AllocatedHeight)
+	{
+		return;
+	}
+
+	glDeleteFramebuffers((GLsizei)_Framebuffers.size(), _Framebuffers.data());
+	glDeleteTextures(1, &_Pyramid);
+	_AllocatedWidth = width;
+	_AllocatedHeight = height;
+	_HasPyramid = false;
+
+	// GL rounds level sizes down, build() rounds them up. Halving a power of two is exact,
+	// so every level GL allocates holds what build() draws into it.
+	unsigned storageWidth = nextPowerOfTwo(width);
+	unsigned storageHeight = nextPowerOfTwo(height);
+	_NumAllocatedLevels = countLevels(storageWidth, storageHeight);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &_Pyramid);
+	glTextureStorage2D(_Pyramid, _NumAllocatedLevels, GL_R32F, storageWidth, storageHeight);
+	glTextureParameteri(_Pyramid, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTextureParameteri(_Pyramid, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTextureParameteri(_Pyramid, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(_Pyramid, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	_Framebuffers.resize(_NumAllocatedLevels);
+	glCreateFramebuffers(_NumAllocatedLevels, _Framebuffers.data());
+	for (int level = 0; level < _NumAllocatedLevels; ++level)
+	{
+		glNamedFramebufferTexture(_Framebuffers[level], GL_COLOR_ATTACHMENT0, _Pyramid, level);
+		glNamedFramebufferDrawBuffer(_Framebuffers[level], GL_COLOR_ATTACHMENT0);
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "GL/glew.h"
+#include "FrameGraph.h"
+#include "ShaderProgram.h"
+#include <MiniMath/Core.h>
+#include <vector>
+#include <memory>
+
+class Transform;
+
+/*
+	///// // HiZCuller // /////
+
+	Occlusion culling against a hierarchical depth buffer, entirely on the GPU.
+
+	The pyramid is built from the scene's depth attachment, each level keeping the farthest depth
+	of the 2x2 texels below it. An object's screen space bounding rectangle then covers at most
+	2x2 texels of some level, and if its nearest depth is behind all of them it is hidden.
+
+	The tests run in hiZTest.vert, one vertex per object with the rasterizer off. They write
+	the instance count of a glDrawArraysIndirect command per object, so a hidden object's draw
+	has no instances and costs the GPU nothing, and the CPU never waits on the results.
+
+	Drawing takes two phases each frame:
+		1. testPrevious(), objects are tested against last frame's pyramid, reprojected with
+		   the view projection it was built with. Those passing are drawn.
+		2. build() makes a new pyramid from that depth, then testCurrent() tests the objects
+		   that failed the first phase again. Those that are visible now, because they or the
+		   camera moved, are drawn as well.
+	The second phase catches everything the first missed, so nothing pops in a frame late.
+
+	Objects without bounds (see Transform::getWorldBounds) are never culled and are drawn in
+	the first phase. Requires shader storage writes from vertex shaders.
+*/
+
+class HiZCuller
+{
+public:
+	~HiZCuller();
+	void unload();
+
+	// Loads the shaders, call once
+	void init();
+
+	// Starts the first phase, testing objects against last frame's pyramid
+	void testPrevious(const std::vector<Transform*> &objects);
+	// Builds the pyramid from the depth drawn so far, restoring the bound framebuffer and viewport after.
+	// viewProjection is what the depth was drawn with.
+	void build(GLuint depthTexture, const RenderTargetDesc &desc, unsigned viewportWidth, unsigned viewportHeight, const mat4 &viewProjection);
+	// Starts the second phase, testing the objects that failed the first against the new pyramid
+	void testCurrent();
+	// Forgets the pyramid, so the next first phase draws everything
+	void reset();
+
+	// Binds the commands as the GL_DRAW_INDIRECT_BUFFER
+	void bindCommands() const;
+	// Offset of object's command for the current phase in the indirect buffer, -1 if it is not culled
+	GLintptr getCommand(size_t object) const;
+	bool isSecondPhase() const;
+	int getNumLevels() const;
+
+private:
+	struct Bounds
+	{
+		vec4 boundsMin;
+		vec4 boundsMax;
+	};
+
+	struct DrawCommand
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint first;
+		GLuint baseInstance;
+	};
+
+	void test(int phase);
+	void allocatePyramid(unsigned width, unsigned height);
+
+	std::shared_ptr<ShaderProgram> _CopyProgram[2];
+	std::shared_ptr<ShaderProgram> _ReduceProgram;
+	std::shared_ptr<ShaderProgram> _TestProgram;
+	// Core profiles need a vertex array bound to draw, even one without attributes
+	GLuint _EmptyVAO = 0;
+
+	GLuint _Pyramid = 0;
+	std::vector<GLuint> _Framebuffers;
+	// Size of level 0 the last build filled, which may be less than allocated.
+	// Each level is half the one below, rounded up, so texel p of level 0 is in texel p >> n of level n.
+	// The storage is a power of two in each direction, so its levels are never smaller than that.
+	unsigned _PyramidWidth = 0;
+	unsigned _PyramidHeight = 0;
+	int _NumLevels = 0;
+	int _NumAllocatedLevels = 0;
+	// The render target size the storage was made for
+	unsigned _AllocatedWidth = 0;
+	unsigned _AllocatedHeight = 0;
+	mat4 _PyramidViewProjection;
+	bool _HasPyramid = false;
+
+	GLuint _BoundsBuffer = 0;
+	// Two commands per object, one for each phase
+	GLuint _CommandBuffer = 0;
+	size_t _Capacity = 0;
+	std::vector<Bounds> _Bounds;
+	std::vector<DrawCommand> _Commands;
+	std::vector<bool> _Culled;
+	int _NumObjects = 0;
+	int _Phase = 0;
+};
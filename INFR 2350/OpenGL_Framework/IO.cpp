@@ -14,6 +14,51 @@ std::string readFile(const std::string & filename)
 	return data;
 }
 
+std::vector<char> readBinaryFile(const std::string & filename)
+{
+	std::ifstream inStream(filename, std::ios::binary | std::ios::ate);
+	if (!inStream.good())
+	{
+		SAT_DEBUG_LOG_ERROR("[IO.cpp] File not found:\"%s\"\n", filename.c_str());
+		return std::vector<char>();
+	}
+	std::vector<char> data(static_cast<size_t>(inStream.tellg()));
+	inStream.seekg(0, std::ios::beg);
+	if (!data.empty())
+	{
+		inStream.read(&data[0], data.size());
+	}
+	return data;
+}
+
+bool fileExists(const std::string & filename)
+{
+	DWORD attributes = GetFileAttributesA(filename.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+bool writeBinaryFile(const std::string & filename, const void * data, size_t size)
+{
+	std::ofstream outStream(filename, std::ios::binary | std::ios::trunc);
+	if (!outStream.good())
+	{
+		SAT_DEBUG_LOG_ERROR("[IO.cpp] Could not write file:\"%s\"\n", filename.c_str());
+		return false;
+	}
+	outStream.write(static_cast<const char*>(data), size);
+	return outStream.good();
+}
+
+unsigned long long getFileWriteTime(const std::string & filename)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesExA(filename.c_str(), GetFileExInfoStandard, &attributes))
+	{
+		return 0;
+	}
+	return (static_cast<unsigned long long>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+}
+
 std::string zeroPadNumber(unsigned int num, unsigned int padding)
 {
 	std::string ret = std::to_string(num);
@@ -21,4 +66,77 @@ std::string zeroPadNumber(unsigned int num, unsigned int padding)
 	for (unsigned int i = 0; i < padding - ret.length(); i++)
 	{	ret = "0" + ret;	}
 	return ret;
-}
\ No newline at end of file
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string & filename)
+{
+	close();
+
+	_File = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_File == INVALID_HANDLE_VALUE)
+	{
+		SAT_DEBUG_LOG_ERROR("[IO.cpp] File not found:\"%s\"\n", filename.c_str());
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_File, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	_Size = static_cast<size_t>(size.QuadPart);
+
+	_Mapping = CreateFileMappingA(_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_Mapping != nullptr)
+	{
+		_Data = static_cast<const char*>(MapViewOfFile(_Mapping, FILE_MAP_READ, 0, 0, 0));
+	}
+	if (_Data == nullptr)
+	{
+		SAT_DEBUG_LOG_ERROR("[IO.cpp] Could not map file:\"%s\"\n", filename.c_str());
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_Data)
+	{
+		UnmapViewOfFile(_Data);
+		_Data = nullptr;
+	}
+	if (_Mapping)
+	{
+		CloseHandle(_Mapping);
+		_Mapping = nullptr;
+	}
+	if (_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(_File);
+		_File = INVALID_HANDLE_VALUE;
+	}
+	_Size = 0;
+}
+
+bool MappedFile::isOpen() const
+{
+	return _Data != nullptr;
+}
+
+const char * MappedFile::getData() const
+{
+	return _Data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return _Size;
+}
@@ -1,11 +1,39 @@
 #pragma once
 #include <string>
+#include <vector>
 #include <Windows.h>
 
 std::string readFile(const std::string &filename);
+std::vector<char> readBinaryFile(const std::string &filename);
+bool fileExists(const std::string &filename);
+bool writeBinaryFile(const std::string &filename, const void* data, size_t size);
+// Last write time of a file as a comparable tick count, 0 if it does not exist
+unsigned long long getFileWriteTime(const std::string &filename);
 
 std::string zeroPadNumber(unsigned int num, unsigned int padding);
 
+// Read-only view of a whole file, pages are read from disk as they are touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string &filename);
+	void close();
+	bool isOpen() const;
+	const char* getData() const;
+	size_t getSize() const;
+
+private:
+	HANDLE _File = INVALID_HANDLE_VALUE;
+	HANDLE _Mapping = nullptr;
+	const char* _Data = nullptr;
+	size_t _Size = 0;
+};
+
 
 #define SAT_LOG_ERROR(message, ...)			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE),0x0C);\
 											printf(message, ##__VA_ARGS__);	SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE),0x07); printf("\n");
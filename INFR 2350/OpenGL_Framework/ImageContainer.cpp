@@ -0,0 +1,857 @@
+#include "ImageContainer.h"
+#include "IO.h"
+#include <cstring>
+#include <cstdint>
+#include <cctype>
+
+namespace
+{
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const uint32_t DDPF_FOURCC = 0x4;
+	const uint32_t DDPF_RGB = 0x40;
+	const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+	const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+	constexpr uint32_t makeFourCC(char a, char b, char c, char d)
+	{
+		return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+	}
+
+	struct DDSPixelFormat
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t rgbBitCount;
+		uint32_t rBitMask;
+		uint32_t gBitMask;
+		uint32_t bBitMask;
+		uint32_t aBitMask;
+	};
+
+	struct DDSHeader
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		uint32_t reserved1[11];
+		DDSPixelFormat pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+
+	struct DDSHeaderDX10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+
+	const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// The KTX2 header places 64-bit fields on 4-byte boundaries
+#pragma pack(push, 1)
+	struct KTX2Header
+	{
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct KTX2LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+#pragma pack(pop)
+
+	struct FormatMapping
+	{
+		uint32_t sourceFormat;
+		GLenum internalFormat;
+		GLenum format;
+		GLenum type;
+	};
+
+	// DXGI_FORMAT values used by the DX10 DDS header
+	const FormatMapping DXGIFormats[] =
+	{
+		{ 28, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ 29, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ 87, GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE },
+		{ 91, GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE },
+		{ 10, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
+		{ 71, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT },
+		{ 72, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT },
+		{ 74, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT },
+		{ 75, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT },
+		{ 77, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+		{ 78, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+		{ 80, GL_COMPRESSED_RED_RGTC1 },
+		{ 83, GL_COMPRESSED_RG_RGTC2 },
+		{ 98, GL_COMPRESSED_RGBA_BPTC_UNORM },
+		{ 99, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM },
+	};
+
+	// VkFormat values used by KTX2
+	const FormatMapping VkFormats[] =
+	{
+		{ 37, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ 43, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ 44, GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE },
+		{ 50, GL_SRGB8_ALPHA8, GL_BGRA, GL_UNSIGNED_BYTE },
+		{ 90, GL_RGB16F, GL_RGB, GL_HALF_FLOAT },
+		{ 97, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
+		{ 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT },
+		{ 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT },
+		{ 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT },
+		{ 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT },
+		{ 135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT },
+		{ 136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT },
+		{ 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+		{ 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT },
+		{ 139, GL_COMPRESSED_RED_RGTC1 },
+		{ 141, GL_COMPRESSED_RG_RGTC2 },
+		{ 145, GL_COMPRESSED_RGBA_BPTC_UNORM },
+		{ 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM },
+	};
+
+	template<size_t N>
+	const FormatMapping* findFormat(const FormatMapping (&formats)[N], uint32_t sourceFormat)
+	{
+		for (const FormatMapping& mapping : formats)
+		{
+			if (mapping.sourceFormat == sourceFormat)
+			{
+				return &mapping;
+			}
+		}
+		return nullptr;
+	}
+
+	bool endsWith(const std::string &str, const std::string &suffix)
+	{
+		if (str.size() < suffix.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < suffix.size(); ++i)
+		{
+			if (tolower(str[str.size() - suffix.size() + i]) != suffix[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool ImageContainer::load(const std::string & path)
+{
+	clear();
+	filename = path;
+	if (!_File.open(path))
+	{
+		return false;
+	}
+	_Bytes = _File.getData();
+	_Size = _File.getSize();
+
+	bool success = false;
+	if (_Size >= sizeof(KTX2_IDENTIFIER) && memcmp(_Bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0)
+	{
+		success = parseKTX2();
+	}
+	else if (_Size >= sizeof(uint32_t) && *reinterpret_cast<const uint32_t*>(_Bytes) == DDS_MAGIC)
+	{
+		success = parseDDS();
+	}
+	else
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s is not a DDS or KTX2 file", path.c_str());
+	}
+
+	success = success && validateLevels();
+	if (!success)
+	{
+		clear();
+	}
+	return success;
+}
+
+bool ImageContainer::save(const std::string & path) const
+{
+	if (_Levels.empty())
+	{
+		return false;
+	}
+	return endsWith(path, ".ktx2") ? saveKTX2(path) : saveDDS(path);
+}
+
+void ImageContainer::create(GLenum newInternalFormat, int newWidth, int newHeight, int numLevels, int numFaces)
+{
+	clear();
+	internalFormat = newInternalFormat;
+	width = newWidth;
+	height = newHeight;
+	_NumLevels = numLevels;
+	_NumFaces = numFaces;
+
+	if (!isCompressed())
+	{
+		format = internalFormat == GL_RGB16F ? GL_RGB : GL_RGBA;
+		type = (internalFormat == GL_RGB16F || internalFormat == GL_RGBA16F) ? GL_HALF_FLOAT : GL_UNSIGNED_BYTE;
+	}
+
+	size_t offset = 0;
+	_Levels.resize(_NumLevels * _NumFaces);
+	for (int level = 0; level < _NumLevels; ++level)
+	{
+		for (int face = 0; face < _NumFaces; ++face)
+		{
+			ImageLevel& image = _Levels[level * _NumFaces + face];
+			image.width = (std::max)(1, width >> level);
+			image.height = (std::max)(1, height >> level);
+			image.size = calculateLevelSize(internalFormat, image.width, image.height);
+			image.offset = offset;
+			offset += image.size;
+		}
+	}
+	_Data.resize(offset);
+	_Bytes = _Data.data();
+	_Size = _Data.size();
+}
+
+void ImageContainer::clear()
+{
+	_File.close();
+	_Data.clear();
+	_Data.shrink_to_fit();
+	_Bytes = nullptr;
+	_Size = 0;
+	_Levels.clear();
+	_NumLevels = 0;
+	_NumFaces = 0;
+	_PixelBase = nullptr;
+	_UseDataAsBase = true;
+	width = 0;
+	height = 0;
+	internalFormat = GL_NONE;
+	format = GL_NONE;
+	type = GL_NONE;
+}
+
+bool ImageContainer::isContainerFile(const std::string & path)
+{
+	return endsWith(path, ".dds") || endsWith(path, ".ktx2");
+}
+
+bool ImageContainer::isCompressed() const
+{
+	return isCompressedFormat(internalFormat);
+}
+
+bool ImageContainer::isCube() const
+{
+	return _NumFaces == 6;
+}
+
+int ImageContainer::getNumLevels() const
+{
+	return _NumLevels;
+}
+
+int ImageContainer::getNumFaces() const
+{
+	return _NumFaces;
+}
+
+const ImageLevel & ImageContainer::getLevel(int level, int face) const
+{
+	return _Levels[level * _NumFaces + face];
+}
+
+const char * ImageContainer::getData() const
+{
+	return _Bytes;
+}
+
+size_t ImageContainer::getDataSize() const
+{
+	return _Size;
+}
+
+void ImageContainer::getLevelSpan(int firstLevel, size_t & offset, size_t & size) const
+{
+	// DDS stores the largest level first and KTX2 the smallest, either way the levels of a 2D image are
+	// contiguous. DDS cube maps store face by face, so their span also covers larger levels.
+	size_t begin = _Size;
+	size_t end = 0;
+	for (int level = firstLevel; level < _NumLevels; ++level)
+	{
+		for (int face = 0; face < _NumFaces; ++face)
+		{
+			const ImageLevel& data = getLevel(level, face);
+			begin = (std::min)(begin, data.offset);
+			end = (std::max)(end, data.offset + data.size);
+		}
+	}
+	offset = begin < end ? begin : 0;
+	size = begin < end ? end - begin : 0;
+}
+
+char * ImageContainer::getLevelData(int level, int face)
+{
+	// Only containers from create() own writable memory
+	SAT_ASSERT(!_File.isOpen(), "Cannot write to a mapped file");
+	return _Data.data() + getLevel(level, face).offset;
+}
+
+const void * ImageContainer::getPixels(int level, int face) const
+{
+	size_t offset = getLevel(level, face).offset;
+	if (_UseDataAsBase)
+	{
+		return _Bytes + offset;
+	}
+	return reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(_PixelBase) + offset);
+}
+
+void ImageContainer::setPixelBase(const void * base)
+{
+	_PixelBase = static_cast<const char*>(base);
+	_UseDataAsBase = false;
+}
+
+int ImageContainer::countMipLevels(int width, int height)
+{
+	int levels = 1;
+	for (int largest = (std::max)(width, height); largest > 1; largest >>= 1)
+	{
+		++levels;
+	}
+	return levels;
+}
+
+size_t ImageContainer::calculateLevelSize(GLenum internalFormat, int width, int height)
+{
+	size_t blocksX = (size_t)((width + 3) / 4);
+	size_t blocksY = (size_t)((height + 3) / 4);
+
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+		return blocksX * blocksY * 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return blocksX * blocksY * 16;
+	case GL_RGB16F:
+		return (size_t)width * height * 6;
+	case GL_RGBA16F:
+		return (size_t)width * height * 8;
+	default:
+		return (size_t)width * height * 4;
+	}
+}
+
+bool ImageContainer::isCompressedFormat(GLenum internalFormat)
+{
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint16_t ImageContainer::floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+	uint32_t mantissa = bits & 0x7FFFFF;
+
+	if (exponent <= 0)
+	{
+		// Subnormal, or too small for a half
+		if (exponent < -10)
+		{
+			return sign;
+		}
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint16_t half = (uint16_t)(mantissa >> shift);
+		if ((mantissa >> (shift - 1)) & 1)
+		{
+			++half;
+		}
+		return sign | half;
+	}
+	if (exponent >= 31)
+	{
+		// Clamp to the largest finite half
+		return sign | 0x7BFF;
+	}
+
+	// Rounding may carry into the exponent, which is still the right result
+	uint16_t half = (uint16_t)(sign | (exponent << 10) | (mantissa >> 13));
+	if (mantissa & 0x1000)
+	{
+		++half;
+	}
+	return half;
+}
+
+bool ImageContainer::parseDDS()
+{
+	size_t offset = sizeof(uint32_t);
+	if (_Size < offset + sizeof(DDSHeader))
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s has a truncated DDS header", filename.c_str());
+		return false;
+	}
+
+	DDSHeader header;
+	memcpy(&header, _Bytes + offset, sizeof(DDSHeader));
+	offset += sizeof(DDSHeader);
+
+	width = (int)header.width;
+	height = (int)header.height;
+	_NumLevels = (std::max)(1, (int)header.mipMapCount);
+	_NumFaces = (header.caps2 & DDSCAPS2_CUBEMAP) ? 6 : 1;
+
+	const DDSPixelFormat& pf = header.pixelFormat;
+	if (pf.flags & DDPF_FOURCC)
+	{
+		switch (pf.fourCC)
+		{
+		case makeFourCC('D', 'X', 'T', '1'): internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+		case makeFourCC('D', 'X', 'T', '3'): internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+		case makeFourCC('D', 'X', 'T', '5'): internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+		case makeFourCC('A', 'T', 'I', '1'):
+		case makeFourCC('B', 'C', '4', 'U'): internalFormat = GL_COMPRESSED_RED_RGTC1; break;
+		case makeFourCC('A', 'T', 'I', '2'):
+		case makeFourCC('B', 'C', '5', 'U'): internalFormat = GL_COMPRESSED_RG_RGTC2; break;
+		case makeFourCC('D', 'X', '1', '0'):
+		{
+			if (_Size < offset + sizeof(DDSHeaderDX10))
+			{
+				SAT_DEBUG_LOG_ERROR("[ImageContainer] %s has a truncated DX10 header", filename.c_str());
+				return false;
+			}
+			DDSHeaderDX10 dx10;
+			memcpy(&dx10, _Bytes + offset, sizeof(DDSHeaderDX10));
+			offset += sizeof(DDSHeaderDX10);
+
+			if (dx10.arraySize > 1)
+			{
+				SAT_DEBUG_LOG_ERROR("[ImageContainer] %s is a texture array, which is not supported", filename.c_str());
+				return false;
+			}
+			if (dx10.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			{
+				_NumFaces = 6;
+			}
+
+			const FormatMapping* mapping = findFormat(DXGIFormats, dx10.dxgiFormat);
+			if (mapping == nullptr)
+			{
+				SAT_DEBUG_LOG_ERROR("[ImageContainer] %s uses unsupported DXGI format %u", filename.c_str(), dx10.dxgiFormat);
+				return false;
+			}
+			internalFormat = mapping->internalFormat;
+			format = mapping->format;
+			type = mapping->type;
+			break;
+		}
+		default:
+			SAT_DEBUG_LOG_ERROR("[ImageContainer] %s uses an unsupported FourCC", filename.c_str());
+			return false;
+		}
+	}
+	else if ((pf.flags & DDPF_RGB) && (pf.flags & DDPF_ALPHAPIXELS) && pf.rgbBitCount == 32)
+	{
+		internalFormat = GL_RGBA8;
+		type = GL_UNSIGNED_BYTE;
+		if (pf.rBitMask == 0x000000FF && pf.gBitMask == 0x0000FF00 && pf.bBitMask == 0x00FF0000)
+		{
+			format = GL_RGBA;
+		}
+		else if (pf.rBitMask == 0x00FF0000 && pf.gBitMask == 0x0000FF00 && pf.bBitMask == 0x000000FF)
+		{
+			format = GL_BGRA;
+		}
+		else
+		{
+			SAT_DEBUG_LOG_ERROR("[ImageContainer] %s uses an unsupported channel layout", filename.c_str());
+			return false;
+		}
+	}
+	else
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s uses an unsupported pixel format", filename.c_str());
+		return false;
+	}
+
+	// DDS stores every level of a face before moving on to the next face
+	_Levels.resize(_NumLevels * _NumFaces);
+	for (int face = 0; face < _NumFaces; ++face)
+	{
+		for (int level = 0; level < _NumLevels; ++level)
+		{
+			ImageLevel& image = _Levels[level * _NumFaces + face];
+			image.width = (std::max)(1, width >> level);
+			image.height = (std::max)(1, height >> level);
+			image.size = calculateLevelSize(internalFormat, image.width, image.height);
+			image.offset = offset;
+			offset += image.size;
+		}
+	}
+	return true;
+}
+
+bool ImageContainer::parseKTX2()
+{
+	size_t offset = sizeof(KTX2_IDENTIFIER);
+	if (_Size < offset + sizeof(KTX2Header))
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s has a truncated KTX2 header", filename.c_str());
+		return false;
+	}
+
+	KTX2Header header;
+	memcpy(&header, _Bytes + offset, sizeof(KTX2Header));
+	offset += sizeof(KTX2Header);
+
+	if (header.supercompressionScheme != 0)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s is supercompressed, which is not supported", filename.c_str());
+		return false;
+	}
+	if (header.pixelDepth > 1 || header.layerCount > 1)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s is a 3D texture or texture array, which is not supported", filename.c_str());
+		return false;
+	}
+
+	const FormatMapping* mapping = findFormat(VkFormats, header.vkFormat);
+	if (mapping == nullptr)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s uses unsupported VkFormat %u", filename.c_str(), header.vkFormat);
+		return false;
+	}
+	internalFormat = mapping->internalFormat;
+	format = mapping->format;
+	type = mapping->type;
+
+	width = (int)header.pixelWidth;
+	height = (std::max)(1, (int)header.pixelHeight);
+	// A level count of 0 asks the loader to generate the mip chain
+	_NumLevels = (std::max)(1, (int)header.levelCount);
+	_NumFaces = (int)header.faceCount;
+	if (_NumFaces != 1 && _NumFaces != 6)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s has %d faces", filename.c_str(), _NumFaces);
+		return false;
+	}
+
+	if (_Size < offset + sizeof(KTX2LevelIndex) * _NumLevels)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s has a truncated level index", filename.c_str());
+		return false;
+	}
+
+	// Faces of a level are stored back to back, level 0 is listed first in the index
+	_Levels.resize(_NumLevels * _NumFaces);
+	for (int level = 0; level < _NumLevels; ++level)
+	{
+		KTX2LevelIndex index;
+		memcpy(&index, _Bytes + offset + sizeof(KTX2LevelIndex) * level, sizeof(KTX2LevelIndex));
+
+		size_t faceSize = (size_t)(index.byteLength / _NumFaces);
+		for (int face = 0; face < _NumFaces; ++face)
+		{
+			ImageLevel& image = _Levels[level * _NumFaces + face];
+			image.width = (std::max)(1, width >> level);
+			image.height = (std::max)(1, height >> level);
+			image.size = faceSize;
+			image.offset = (size_t)index.byteOffset + faceSize * face;
+		}
+	}
+	return true;
+}
+
+bool ImageContainer::saveDDS(const std::string & path) const
+{
+	// BC1 without alpha is stored the same way as BC1 with it
+	GLenum storedFormat = internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : internalFormat;
+	const FormatMapping* mapping = nullptr;
+	for (const FormatMapping& dxgi : DXGIFormats)
+	{
+		if (dxgi.internalFormat == storedFormat && (isCompressed() || dxgi.format == format))
+		{
+			mapping = &dxgi;
+			break;
+		}
+	}
+	if (mapping == nullptr)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s cannot be stored as DDS", path.c_str());
+		return false;
+	}
+
+	DDSHeader header = {};
+	header.size = sizeof(DDSHeader);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000; // Caps, height, width, pixel format, mip count
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.mipMapCount = (uint32_t)_NumLevels;
+	header.pixelFormat.size = sizeof(DDSPixelFormat);
+	header.pixelFormat.flags = DDPF_FOURCC;
+	header.pixelFormat.fourCC = makeFourCC('D', 'X', '1', '0');
+	header.caps = 0x1000 | 0x8 | 0x400000; // Texture, complex, mipmap
+	header.caps2 = isCube() ? 0xFE00 : 0; // Cube map with all six faces
+
+	DDSHeaderDX10 dx10 = {};
+	dx10.dxgiFormat = mapping->sourceFormat;
+	dx10.resourceDimension = 3; // Texture2D
+	dx10.miscFlag = isCube() ? DDS_RESOURCE_MISC_TEXTURECUBE : 0;
+	dx10.arraySize = 1;
+
+	std::vector<char> file(sizeof(DDS_MAGIC) + sizeof(DDSHeader) + sizeof(DDSHeaderDX10));
+	memcpy(file.data(), &DDS_MAGIC, sizeof(DDS_MAGIC));
+	memcpy(file.data() + sizeof(DDS_MAGIC), &header, sizeof(DDSHeader));
+	memcpy(file.data() + sizeof(DDS_MAGIC) + sizeof(DDSHeader), &dx10, sizeof(DDSHeaderDX10));
+
+	for (int face = 0; face < _NumFaces; ++face)
+	{
+		for (int level = 0; level < _NumLevels; ++level)
+		{
+			const ImageLevel& image = getLevel(level, face);
+			file.insert(file.end(), _Bytes + image.offset, _Bytes + image.offset + image.size);
+		}
+	}
+	return writeBinaryFile(path, file.data(), file.size());
+}
+
+bool ImageContainer::saveKTX2(const std::string & path) const
+{
+	const FormatMapping* mapping = nullptr;
+	for (const FormatMapping& vk : VkFormats)
+	{
+		if (vk.internalFormat == internalFormat && (isCompressed() || vk.format == format))
+		{
+			mapping = &vk;
+			break;
+		}
+	}
+	if (mapping == nullptr)
+	{
+		SAT_DEBUG_LOG_ERROR("[ImageContainer] %s cannot be stored as KTX2", path.c_str());
+		return false;
+	}
+
+	std::vector<char> descriptor;
+	writeDataFormatDescriptor(descriptor);
+
+	KTX2Header header = {};
+	header.vkFormat = mapping->sourceFormat;
+	header.typeSize = type == GL_HALF_FLOAT ? 2 : 1;
+	header.pixelWidth = (uint32_t)width;
+	header.pixelHeight = (uint32_t)height;
+	header.faceCount = (uint32_t)_NumFaces;
+	header.levelCount = (uint32_t)_NumLevels;
+
+	size_t indexOffset = sizeof(KTX2_IDENTIFIER) + sizeof(KTX2Header);
+	header.dfdByteOffset = (uint32_t)(indexOffset + sizeof(KTX2LevelIndex) * _NumLevels);
+	header.dfdByteLength = (uint32_t)descriptor.size();
+
+	std::vector<char> file(header.dfdByteOffset);
+	file.insert(file.end(), descriptor.begin(), descriptor.end());
+
+	// Level data goes smallest level first, each level aligned to the lowest common multiple of its block size and 4
+	size_t alignment = isCompressed() ? calculateLevelSize(internalFormat, 4, 4) : calculateLevelSize(internalFormat, 1, 1);
+	alignment = alignment % 4 == 0 ? alignment : (alignment % 2 == 0 ? alignment * 2 : alignment * 4);
+	std::vector<KTX2LevelIndex> index(_NumLevels);
+	for (int level = _NumLevels - 1; level >= 0; --level)
+	{
+		file.resize((file.size() + alignment - 1) / alignment * alignment);
+		index[level].byteOffset = file.size();
+		for (int face = 0; face < _NumFaces; ++face)
+		{
+			const ImageLevel& image = getLevel(level, face);
+			file.insert(file.end(), _Bytes + image.offset, _Bytes + image.offset + image.size);
+		}
+		index[level].byteLength = file.size() - index[level].byteOffset;
+		index[level].uncompressedByteLength = index[level].byteLength;
+	}
+
+	memcpy(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	memcpy(file.data() + sizeof(KTX2_IDENTIFIER), &header, sizeof(KTX2Header));
+	memcpy(file.data() + indexOffset, index.data(), sizeof(KTX2LevelIndex) * _NumLevels);
+	return writeBinaryFile(path, file.data(), file.size());
+}
+
+void ImageContainer::writeDataFormatDescriptor(std::vector<char>& file) const
+{
+	// Khronos Data Format basic descriptor block, see the KTX2 and Khronos Data Format specifications
+	struct Sample
+	{
+		uint32_t bitOffset;
+		uint32_t bitLength;
+		uint32_t channel;
+	};
+
+	const uint32_t MODEL_RGBSDA = 1, MODEL_BC1A = 128, MODEL_BC2 = 129, MODEL_BC3 = 130, MODEL_BC4 = 131, MODEL_BC5 = 132, MODEL_BC7 = 134;
+	const uint32_t CHANNEL_ALPHA = 15, QUALIFIER_LINEAR = 0x10, QUALIFIER_SIGNED = 0x40, QUALIFIER_FLOAT = 0x80;
+
+	bool isSRGB = internalFormat == GL_SRGB8_ALPHA8 || internalFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT ||
+		internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT ||
+		internalFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT || internalFormat == GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+	bool isFloat = type == GL_HALF_FLOAT;
+
+	uint32_t model = MODEL_RGBSDA;
+	uint32_t blockBytes = (uint32_t)calculateLevelSize(internalFormat, isCompressed() ? 4 : 1, isCompressed() ? 4 : 1);
+	std::vector<Sample> samples;
+	switch (internalFormat)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+		model = MODEL_BC1A;
+		samples.push_back({ 0, 64, 0 });
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+		model = MODEL_BC1A;
+		samples.push_back({ 0, 64, 1 }); // Alpha present
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+		model = MODEL_BC2;
+		samples.push_back({ 0, 64, CHANNEL_ALPHA });
+		samples.push_back({ 64, 64, 0 });
+		break;
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		model = MODEL_BC3;
+		samples.push_back({ 0, 64, CHANNEL_ALPHA });
+		samples.push_back({ 64, 64, 0 });
+		break;
+	case GL_COMPRESSED_RED_RGTC1:
+		model = MODEL_BC4;
+		samples.push_back({ 0, 64, 0 });
+		break;
+	case GL_COMPRESSED_RG_RGTC2:
+		model = MODEL_BC5;
+		samples.push_back({ 0, 64, 0 });
+		samples.push_back({ 64, 64, 1 });
+		break;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+		model = MODEL_BC7;
+		samples.push_back({ 0, 128, 0 });
+		break;
+	default:
+	{
+		uint32_t bits = isFloat ? 16 : 8;
+		uint32_t numChannels = format == GL_RGB ? 3 : 4;
+		for (uint32_t c = 0; c < numChannels; ++c)
+		{
+			// BGRA swaps where red and blue live
+			uint32_t position = (format == GL_BGRA && c != 1 && c != 3) ? 2 - c : c;
+			uint32_t channel = c == 3 ? CHANNEL_ALPHA : c;
+			samples.push_back({ position * bits, bits, channel });
+		}
+		break;
+	}
+	}
+
+	uint32_t blockSize = 24 + 16 * (uint32_t)samples.size();
+	std::vector<uint32_t> words;
+	words.push_back(4 + blockSize); // Total size
+	words.push_back(0); // Khronos vendor, basic descriptor type
+	words.push_back(2 | (blockSize << 16)); // Version 1.3
+	words.push_back(model | (1 << 8) | ((isSRGB ? 2u : 1u) << 16)); // BT.709 primaries, sRGB or linear transfer
+	words.push_back(isCompressed() ? (3 | (3 << 8)) : 0); // Texel block dimensions minus one
+	words.push_back(blockBytes);
+	words.push_back(0);
+
+	for (const Sample& sample : samples)
+	{
+		uint32_t qualifiers = 0;
+		if (isFloat)
+		{
+			qualifiers = QUALIFIER_FLOAT | QUALIFIER_SIGNED;
+		}
+		else if (isSRGB && sample.channel == CHANNEL_ALPHA && !isCompressed())
+		{
+			qualifiers = QUALIFIER_LINEAR;
+		}
+
+		words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | ((sample.channel | qualifiers) << 24));
+		words.push_back(0); // Sample position
+		words.push_back(isFloat ? 0xBF800000 : 0); // Lower
+		words.push_back(isFloat ? 0x3F800000 : (isCompressed() ? 0xFFFFFFFF : (1u << sample.bitLength) - 1)); // Upper
+	}
+
+	const char* bytes = reinterpret_cast<const char*>(words.data());
+	file.insert(file.end(), bytes, bytes + words.size() * sizeof(uint32_t));
+}
+
+bool ImageContainer::validateLevels() const
+{
+	for (const ImageLevel& image : _Levels)
+	{
+		if (image.size < calculateLevelSize(internalFormat, image.width, image.height) || image.offset + image.size > _Size)
+		{
+			SAT_DEBUG_LOG_ERROR("[ImageContainer] %s is truncated or has a corrupt level", filename.c_str());
+			return false;
+		}
+	}
+	return !_Levels.empty();
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "GL/glew.h"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "IO.h"
+
+/*
+	///// // ImageContainer // /////
+
+	CPU side copy of a DDS or KTX2 file, with every mip level (and cube face) already laid out
+	the way the GPU wants it. Containers can also be created empty, filled (see BlockCompressor) and
+	saved as DDS. Nothing here touches OpenGL, so containers can be used on worker threads.
+
+	Supported formats:
+		BC1, BC2, BC3, BC4, BC5, BC7 (UNORM and SRGB where the format has it)
+		RGBA8 / BGRA8, RGBA16F and RGB16F uncompressed
+
+	KTX2 files must not be supercompressed (BasisLZ / Zstandard).
+*/
+
+struct ImageLevel
+{
+	int width = 0;
+	int height = 0;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+class ImageContainer
+{
+public:
+	// Maps a .dds or .ktx2 file, the format is detected from the file contents.
+	// Level data is only read from disk when it is first touched.
+	bool load(const std::string &path);
+	// Writes the container as .ktx2 or .dds, picked by the extension of path
+	bool save(const std::string &path) const;
+	// Allocates tightly packed, uninitialized levels to be filled through getLevelData()
+	void create(GLenum internalFormat, int width, int height, int numLevels, int numFaces = 1);
+	void clear();
+
+	// True if the path names a file type this class can read
+	static bool isContainerFile(const std::string &path);
+
+	bool isCompressed() const;
+	bool isCube() const;
+	int getNumLevels() const;
+	int getNumFaces() const;
+	const ImageLevel& getLevel(int level, int face = 0) const;
+	const char* getData() const;
+	char* getLevelData(int level, int face = 0);
+	size_t getDataSize() const;
+	// The byte range of getData() that holds firstLevel and every smaller level, for all faces
+	void getLevelSpan(int firstLevel, size_t &offset, size_t &size) const;
+
+	// Pointer to a level that can be passed straight to glCompressedTextureSubImage / glTextureSubImage.
+	// By default this points into getData(), after setPixelBase(nullptr) it is an offset into a
+	// GL_PIXEL_UNPACK_BUFFER that holds a copy of getData().
+	const void* getPixels(int level, int face = 0) const;
+	void setPixelBase(const void* base);
+
+	// Number of levels in a full mip chain down to 1x1
+	static int countMipLevels(int width, int height);
+	// Bytes taken by one level of the given size in the given internal format
+	static size_t calculateLevelSize(GLenum internalFormat, int width, int height);
+	static bool isCompressedFormat(GLenum internalFormat);
+	// Rounds to the nearest half float, clamping to the largest finite one
+	static uint16_t floatToHalf(float value);
+
+	std::string filename;
+
+	int width = 0;
+	int height = 0;
+	GLenum internalFormat = GL_NONE;
+	// Only used for uncompressed formats
+	GLenum format = GL_NONE;
+	GLenum type = GL_NONE;
+
+private:
+	bool parseDDS();
+	bool parseKTX2();
+	bool saveDDS(const std::string &path) const;
+	bool saveKTX2(const std::string &path) const;
+	void writeDataFormatDescriptor(std::vector<char> &file) const;
+	bool validateLevels() const;
+
+	// Loaded containers map their file, created ones own _Data
+	MappedFile _File;
+	std::vector<char> _Data;
+	const char* _Bytes = nullptr;
+	size_t _Size = 0;
+	// Indexed by level * _NumFaces + face
+	std::vector<ImageLevel> _Levels;
+	int _NumLevels = 0;
+	int _NumFaces = 0;
+	const char* _PixelBase = nullptr;
+	bool _UseDataAsBase = true;
+};
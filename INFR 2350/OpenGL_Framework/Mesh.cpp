@@ -6,6 +6,7 @@
 #include <vector>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 
 struct MeshFace
 {
@@ -140,6 +141,18 @@ void Mesh::initMeshSphere(const unsigned int xSlices, const unsigned int ySlices
 }
 
 bool Mesh::LoadFromObj(const std::string & file)
+{
+	if (!ParseObj(file, dataVertex, dataTexture, dataNormal))
+	{
+		_IsLoaded = false;
+		return false;
+	}
+
+	uploadToGPU();
+	return true;
+}
+
+bool Mesh::ParseObj(const std::string & file, std::vector<vec4>& vertices, std::vector<vec4>& uvs, std::vector<vec4>& normals)
 {
 	std::ifstream input;
 	input.open("../assets/models/" + file);
@@ -147,7 +160,6 @@ bool Mesh::LoadFromObj(const std::string & file)
 	if (!input)
 	{
 		SAT_ERROR_LOC("Error: Could not open file \"%s\"!\n", file.c_str());
-		_IsLoaded = false;
 		return false;
 	}
 	char line[CHAR_BUFFER_SIZE];
@@ -215,19 +227,19 @@ bool Mesh::LoadFromObj(const std::string & file)
 				vertexDataLoad[faceData[i].vertices[j] - 1].y,
 				vertexDataLoad[faceData[i].vertices[j] - 1].z,
 				1.0f);
-			dataVertex.push_back(vec4(
+			vertices.push_back(vec4(
 				vertexDataLoad[faceData[i].vertices[j] - 1].x,
 				vertexDataLoad[faceData[i].vertices[j] - 1].y,
 				vertexDataLoad[faceData[i].vertices[j] - 1].z,
 				1.0f));
 
-			dataTexture.push_back(vec4(
+			uvs.push_back(vec4(
 				textureDataLoad[faceData[i].textureUVs[j] - 1].x,
 				textureDataLoad[faceData[i].textureUVs[j] - 1].y,
 				0.0f,
 				1.0f));
 
-			dataNormal.push_back(vec4(
+			normals.push_back(vec4(
 				normalDataLoad[faceData[i].normals[j] - 1].x,
 				normalDataLoad[faceData[i].normals[j] - 1].y,
 				normalDataLoad[faceData[i].normals[j] - 1].z,
@@ -238,15 +250,67 @@ bool Mesh::LoadFromObj(const std::string & file)
 
 	}
 
-	uploadToGPU();
-
-	vertexDataLoad.clear(); //Clear the vectors from RAM now that everything's in the GPU.
+	vertexDataLoad.clear(); //Clear the vectors from RAM now that everything's unpacked.
 	textureDataLoad.clear();
 	normalDataLoad.clear();
 	faceData.clear();
 	return true;
 }
 
+void Mesh::setData(std::vector<vec4>& vertices, std::vector<vec4>& uvs, std::vector<vec4>& normals)
+{
+	dataVertex.swap(vertices);
+	dataTexture.swap(uvs);
+	dataNormal.swap(normals);
+	uploadToGPU();
+}
+
+bool Mesh::isLoaded() const
+{
+	return _IsLoaded;
+}
+
+vec3 Mesh::getBoundsMin() const
+{
+	return _BoundsMin;
+}
+
+vec3 Mesh::getBoundsMax() const
+{
+	return _BoundsMax;
+}
+
+vec3 Mesh::getBoundingCenter() const
+{
+	return (_BoundsMin + _BoundsMax) * 0.5f;
+}
+
+float Mesh::getBoundingRadius() const
+{
+	return (_BoundsMax - _BoundsMin).Length() * 0.5f;
+}
+
+void Mesh::calculateBounds()
+{
+	if (dataVertex.empty())
+	{
+		_BoundsMin = _BoundsMax = vec3(0.0f);
+		return;
+	}
+
+	_BoundsMin = _BoundsMax = vec3(dataVertex[0].x, dataVertex[0].y, dataVertex[0].z);
+	for (const vec4& vertex : dataVertex)
+	{
+		_BoundsMin = vec3((std::min)(_BoundsMin.x, vertex.x), (std::min)(_BoundsMin.y, vertex.y), (std::min)(_BoundsMin.z, vertex.z));
+		_BoundsMax = vec3((std::max)(_BoundsMax.x, vertex.x), (std::max)(_BoundsMax.y, vertex.y), (std::max)(_BoundsMax.z, vertex.z));
+	}
+}
+
+Mesh::~Mesh()
+{
+	glDeleteVertexArrays(1, &_DepthVAO);
+}
+
 void Mesh::bind() const
 {
 	vao.bind();
@@ -262,8 +326,44 @@ void Mesh::draw() const
 	vao.draw();
 }
 
+void Mesh::drawDepth() const
+{
+	if (_DepthVAO)
+	{
+		glBindVertexArray(_DepthVAO);
+		glDrawArrays(GL_TRIANGLES, 0, _NumVertices);
+		glBindVertexArray(GL_NONE);
+	}
+}
+
+void Mesh::drawIndirect(GLintptr command) const
+{
+	if (vao.getVaoHandle())
+	{
+		vao.bind();
+		glDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void*>(command));
+		vao.unbind();
+	}
+}
+
+void Mesh::drawDepthIndirect(GLintptr command) const
+{
+	if (_DepthVAO)
+	{
+		glBindVertexArray(_DepthVAO);
+		glDrawArraysIndirect(GL_TRIANGLES, reinterpret_cast<const void*>(command));
+		glBindVertexArray(GL_NONE);
+	}
+}
+
+GLsizei Mesh::getNumVertices() const
+{
+	return _NumVertices;
+}
+
 void Mesh::uploadToGPU()
 {
+	calculateBounds();
 	unsigned int numTris = (unsigned int)(dataVertex.size() / 3);
 
 	if (dataVertex.size() > 0)
@@ -315,5 +415,20 @@ void Mesh::uploadToGPU()
 	}
 
 	vao.createVAO();
+
+	if (_DepthVAO)
+	{
+		glDeleteVertexArrays(1, &_DepthVAO);
+		_DepthVAO = 0;
+	}
+	if (dataVertex.size() > 0)
+	{
+		_NumVertices = (GLsizei)(numTris * 3);
+		glCreateVertexArrays(1, &_DepthVAO);
+		glVertexArrayVertexBuffer(_DepthVAO, 0, vao.getVboHandle(AttributeLocations::VERTEX), 0, sizeof(vec4));
+		glEnableVertexArrayAttrib(_DepthVAO, AttributeLocations::VERTEX);
+		glVertexArrayAttribFormat(_DepthVAO, AttributeLocations::VERTEX, 4, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(_DepthVAO, AttributeLocations::VERTEX, 0);
+	}
 	_IsLoaded = true;
 }
@@ -10,18 +10,42 @@ public:
 	void initMeshSphere(const unsigned int xSlices, const unsigned int ySlices, bool invert = false);
 	
 	bool LoadFromObj(const std::string &file);
+	// Parses and unpacks an OBJ on the CPU without touching OpenGL, safe to call from worker threads
+	static bool ParseObj(const std::string &file, std::vector<vec4> &vertices, std::vector<vec4> &uvs, std::vector<vec4> &normals);
+	// Takes ownership of CPU side vertex data and uploads it
+	void setData(std::vector<vec4> &vertices, std::vector<vec4> &uvs, std::vector<vec4> &normals);
+	bool isLoaded() const;
+	// Object space bounding box of the vertices, valid once the mesh is loaded
+	vec3 getBoundsMin() const;
+	vec3 getBoundsMax() const;
+	vec3 getBoundingCenter() const;
+	float getBoundingRadius() const;
 
 	std::vector<vec4> dataVertex;
 	std::vector<vec4> dataTexture;
 	std::vector<vec4> dataNormal;
 	std::vector<vec4> dataColor;
 
+	~Mesh();
+
 	void draw() const;
+	// Positions only, for depth passes that need nothing else from the vertices
+	void drawDepth() const;
+	// Draws with the command at an offset into the bound GL_DRAW_INDIRECT_BUFFER
+	void drawIndirect(GLintptr command) const;
+	void drawDepthIndirect(GLintptr command) const;
+	GLsizei getNumVertices() const;
 	void Mesh::bind() const;
 	static void Mesh::unbind();
 private:
 	VertexArrayObject vao;
+	// Reads the position buffer of vao, so depth-only draws fetch a quarter of the vertex data
+	GLuint _DepthVAO = 0;
+	GLsizei _NumVertices = 0;
 	bool _IsLoaded = false;
+	vec3 _BoundsMin;
+	vec3 _BoundsMax;
 
+	void calculateBounds();
 	void uploadToGPU();
 };
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "OcclusionQueries.h"
+#include "Transform.h"
+#include "ResourceManager.h"
+
+OcclusionQueries::~OcclusionQueries()
+{
+	unload();
+}
+
+void OcclusionQueries::unload()
+{
+	for (auto& entry : _Queries)
+	{
+		glDeleteQueries(RingSize, entry.second.ids);
+	}
+	_Queries.clear();
+	glDeleteVertexArrays(1, &_EmptyVAO);
+	_EmptyVAO = 0;
+}
+
+void OcclusionQueries::init()
+{
+	// The boxes only count samples, nothing is written
+	_BoxProgram = ResourceManager::getShader("occlusionBox.vert", "depthOnly.frag");
+	glCreateVertexArrays(1, &_EmptyVAO);
+}
+
+void OcclusionQueries::draw(Transform & object, const vec3 & eye, float nearPlane)
+{
+	vec3 boundsMin, boundsMax;
+	if (object.getNumVertices() < minVertices || !object.getWorldBounds(boundsMin, boundsMax))
+	{
+		object.draw();
+		return;
+	}
+
+	Query& query = _Queries[&object];
+	if (query.ids[0] == 0)
+	{
+		glCreateQueries(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, RingSize, query.ids);
+	}
+	// Results arrive in the order the queries were issued, those still in flight are not stalled on
+	while (query.numPending > 0)
+	{
+		GLuint available = 0;
+		glGetQueryObjectuiv(query.ids[query.first], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+		{
+			break;
+		}
+		GLuint samplesPassed = 0;
+		glGetQueryObjectuiv(query.ids[query.first], GL_QUERY_RESULT, &samplesPassed);
+		query.visible = samplesPassed != 0;
+		query.first = (query.first + 1) % RingSize;
+		--query.numPending;
+	}
+
+	// A box around the camera would be clipped by the near plane, and may pass no samples while the object is in view
+	bool eyeInside =
+		eye.x > boundsMin.x - nearPlane && eye.x < boundsMax.x + nearPlane &&
+		eye.y > boundsMin.y - nearPlane && eye.y < boundsMax.y + nearPlane &&
+		eye.z > boundsMin.z - nearPlane && eye.z < boundsMax.z + nearPlane;
+
+	// Every query is in flight, beginning one again would throw its result away
+	if (query.numPending == RingSize)
+	{
+		if (query.visible || eyeInside)
+		{
+			object.draw();
+		}
+		else
+		{
+			glBeginConditionalRender(query.ids[(query.first + RingSize - 1) % RingSize], GL_QUERY_NO_WAIT);
+			object.draw();
+			glEndConditionalRender();
+		}
+		return;
+	}
+
+	GLuint id = query.ids[(query.first + query.numPending) % RingSize];
+	++query.numPending;
+	if (query.visible || eyeInside)
+	{
+		glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, id);
+		object.draw();
+		glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+		return;
+	}
+
+	drawBox(boundsMin, boundsMax, id);
+	glBeginConditionalRender(id, GL_QUERY_NO_WAIT);
+	object.draw();
+	glEndConditionalRender();
+}
+
+int OcclusionQueries::getNumHidden() const
+{
+	int hidden = 0;
+	for (const auto& entry : _Queries)
+	{
+		hidden += entry.second.visible ? 0 : 1;
+	}
+	return hidden;
+}
+
+void OcclusionQueries::drawBox(const vec3 & boundsMin, const vec3 & boundsMax, GLuint query)
+{
+	GLint depthFunc = GL_LESS;
+	GLboolean depthMask = GL_TRUE;
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+
+	// Back faces too, so a box partly behind the near plane still counts what is left of it
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDepthFunc(GL_LEQUAL);
+	glDisable(GL_CULL_FACE);
+
+	_BoxProgram->bind();
+	_BoxProgram->sendUniform("uBoundsMin", boundsMin);
+	_BoxProgram->sendUniform("uBoundsMax", boundsMax);
+	glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, query);
+	glBindVertexArray(_EmptyVAO);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+	glBindVertexArray(GL_NONE);
+	glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+	ShaderProgram::unbind();
+
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	glDepthMask(depthMask);
+	glDepthFunc(depthFunc);
+	if (cullFace)
+	{
+		glEnable(GL_CULL_FACE);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "GL/glew.h"
+#include "ShaderProgram.h"
+#include <MiniMath/Core.h>
+#include <unordered_map>
+#include <memory>
+
+class Transform;
+
+/*
+	///// // OcclusionQueries // /////
+
+	Occlusion culling of heavy meshes with hardware queries and conditional rendering, without the
+	CPU ever waiting on the GPU.
+
+	Each object keeps a GL_ANY_SAMPLES_PASSED_CONSERVATIVE query across frames:
+		- If it was visible last frame, it is drawn as usual and the draw itself is the query
+		  for next frame, so visible objects cost nothing extra.
+		- If it was hidden, its bounding box is drawn first with writes off, inside the query,
+		  and the object is drawn with glBeginConditionalRender(GL_QUERY_NO_WAIT). The GPU skips
+		  the draw if no sample of the box passed, or draws it if the result is not in yet.
+	Results are only read once they are available, until then the previous answer stands. Each
+	object cycles through a few queries, so a GPU running frames behind still gets to finish
+	them. If all of them are in flight the object is drawn without a new one.
+
+	Objects below minVertices are drawn directly, the box would cost about as much as they do.
+	Objects drawn through a HiZCuller's commands are left to it, see Camera::render.
+*/
+
+class OcclusionQueries
+{
+public:
+	~OcclusionQueries();
+	void unload();
+
+	// Loads the box shader, call once
+	void init();
+
+	// Draws object, skipped on the GPU if it is hidden behind the depth drawn so far.
+	// eye and nearPlane keep boxes the camera is inside of from being tested.
+	void draw(Transform &object, const vec3 &eye, float nearPlane);
+
+	// Objects whose last result was hidden
+	int getNumHidden() const;
+
+	unsigned int minVertices = 2000;
+
+private:
+	// Queries per object, how many frames the GPU may be behind before results are skipped
+	static const int RingSize = 3;
+
+	struct Query
+	{
+		GLuint ids[RingSize] = {};
+		// Issued and waiting on a result, oldest first starting at ids[first]
+		int first = 0;
+		int numPending = 0;
+		bool visible = true;
+	};
+
+	void drawBox(const vec3 &boundsMin, const vec3 &boundsMax, GLuint query);
+
+	std::shared_ptr<ShaderProgram> _BoxProgram;
+	// Core profiles need a vertex array bound to draw, even one without attributes
+	GLuint _EmptyVAO = 0;
+	std::unordered_map<Transform*, Query> _Queries;
+};
@@ -0,0 +1,126 @@
+#include "RenderQueue.h"
+#include <algorithm>
+
+namespace
+{
+	const int DepthBits = 24;
+	const int ShaderBits = 11;
+	const int MaterialBits = 14;
+	const int UnusedBits = 12;
+
+	uint64_t mask(unsigned int value, int bits)
+	{
+		return (uint64_t)value & ((1ull << bits) - 1);
+	}
+}
+
+void RenderQueue::clear()
+{
+	_Entries.clear();
+}
+
+void RenderQueue::push(Transform * object, const RenderState & state, float depth)
+{
+	_Entries.push_back({ makeKey(state, depth), object });
+}
+
+void RenderQueue::resize(size_t size)
+{
+	_Entries.resize(size);
+}
+
+void RenderQueue::set(size_t index, Transform * object, const RenderState & state, float depth)
+{
+	_Entries[index] = { makeKey(state, depth), object };
+}
+
+void RenderQueue::sort()
+{
+	size_t count = _Entries.size();
+	if (count < 2)
+	{
+		return;
+	}
+	_Sorted.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = {};
+		for (const Entry& entry : _Entries)
+		{
+			++offsets[(entry.key >> shift) & 0xFF];
+		}
+		// Every key has the same byte here, the pass would not move anything
+		if (offsets[(_Entries[0].key >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		size_t total = 0;
+		for (size_t& offset : offsets)
+		{
+			size_t bucket = offset;
+			offset = total;
+			total += bucket;
+		}
+		// Stable, keys equal in this byte keep the order the less significant bytes gave them
+		for (const Entry& entry : _Entries)
+		{
+			_Sorted[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+		}
+		_Entries.swap(_Sorted);
+	}
+}
+
+void RenderQueue::sortIncremental()
+{
+	size_t budget = _Entries.size() * 4;
+	size_t moves = 0;
+	for (size_t i = 1; i < _Entries.size(); ++i)
+	{
+		Entry entry = _Entries[i];
+		size_t j = i;
+		while (j > 0 && _Entries[j - 1].key > entry.key)
+		{
+			_Entries[j] = _Entries[j - 1];
+			--j;
+			if (++moves > budget)
+			{
+				_Entries[j] = entry;
+				sort();
+				return;
+			}
+		}
+		_Entries[j] = entry;
+	}
+}
+
+size_t RenderQueue::size() const
+{
+	return _Entries.size();
+}
+
+Transform * RenderQueue::operator[](size_t index) const
+{
+	return _Entries[index].object;
+}
+
+uint64_t RenderQueue::makeKey(const RenderState & state, float depth)
+{
+	uint64_t quantized = (uint64_t)((std::min)((std::max)(depth, 0.0f), 1.0f) * (float)((1 << DepthBits) - 1));
+	uint64_t key = mask(state.pass, 2) << 62;
+	if (state.translucent)
+	{
+		key |= 1ull << 61;
+		key |= (((1ull << DepthBits) - 1) - quantized) << (61 - DepthBits);
+		key |= mask(state.shader, ShaderBits) << (61 - DepthBits - ShaderBits);
+		key |= mask(state.material, MaterialBits) << UnusedBits;
+	}
+	else
+	{
+		key |= mask(state.shader, ShaderBits) << (61 - ShaderBits);
+		key |= mask(state.material, MaterialBits) << (61 - ShaderBits - MaterialBits);
+		key |= quantized << UnusedBits;
+	}
+	return key;
+}
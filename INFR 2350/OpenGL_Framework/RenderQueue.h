@@ -0,0 +1,72 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class Transform;
+
+// What decides where a draw goes in a RenderQueue, see Transform::getRenderState
+struct RenderState
+{
+	// Drawn in increasing order, opaque first
+	enum Pass
+	{
+		Opaque = 0,
+		Cutout = 1
+	};
+
+	unsigned int pass = Opaque;
+	// Sorted back to front within its pass, rather than by state
+	bool translucent = false;
+	// Any ids that are the same when the state is, such as the GL handles of the program and first texture
+	unsigned int shader = 0;
+	unsigned int material = 0;
+};
+
+/*
+	///// // RenderQueue // /////
+
+	Orders draws by a 64 bit key, so the sort is a linear radix sort rather than a comparison sort.
+
+	From the most significant bits down, keys are:
+		opaque       pass (2) | 0 | shader (11) | material (14) | depth (24)  | 12 unused
+		translucent  pass (2) | 1 | inverted depth (24) | shader (11) | material (14) | 12 unused
+	so opaque draws are grouped by program and then textures to keep state changes down, and
+	drawn front to back within a group for early depth rejection. Translucent draws blend
+	correctly back to front, and only share state with neighbours at the same depth.
+
+	Shader and material ids are masked to their bits, ids that collide still sort correctly
+	but may split a group. Depth is quantized from [0, 1].
+*/
+
+class RenderQueue
+{
+public:
+	void clear();
+	// depth is normalized, 0 at the camera
+	void push(Transform *object, const RenderState &state, float depth);
+	// For filling the queue from several threads, each setting different indices
+	void resize(size_t size);
+	void set(size_t index, Transform *object, const RenderState &state, float depth);
+	// LSD radix sort, a byte per pass, skipping bytes that are the same in every key
+	void sort();
+	// Insertion sort, close to linear when entries were pushed nearly in order, such as last frame's.
+	// Falls back to sort() once it has moved entries a few times over.
+	void sortIncremental();
+
+	size_t size() const;
+	Transform* operator[](size_t index) const;
+
+	static uint64_t makeKey(const RenderState &state, float depth);
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		Transform* object;
+	};
+
+	std::vector<Entry> _Entries;
+	// Ping-pong buffer for the sort passes
+	std::vector<Entry> _Sorted;
+};
@@ -1,14 +1,233 @@
 #include "ResourceManager.h"
+#include "AssetLoader.h"
+#include <algorithm>
+#include <cctype>
 
 std::vector<Transform*> ResourceManager::Transforms;
 std::vector<ShaderProgram*> ResourceManager::Shaders;
+AABBTree ResourceManager::SceneTree;
+unsigned int ResourceManager::SceneVersion = 0;
+std::vector<Transform*> ResourceManager::ChangedTransforms;
+std::vector<Transform*> ResourceManager::UnboundedTransforms;
+std::vector<int> ResourceManager::_Proxies;
+std::vector<mat4> ResourceManager::_IndexedTransforms;
+ResourceManager::Cache<Texture> ResourceManager::_Textures;
+ResourceManager::Cache<TextureCube> ResourceManager::_TextureCubes;
+ResourceManager::Cache<Mesh> ResourceManager::_Meshes;
+ResourceManager::Cache<ShaderProgram> ResourceManager::_Shaders;
 
 void ResourceManager::addEntity(Transform * entity)
 {
 	Transforms.push_back(entity);
+	_Proxies.push_back(AABBTree::Null);
+	_IndexedTransforms.push_back(mat4());
+}
+
+void ResourceManager::updateScene()
+{
+	++SceneVersion;
+	UnboundedTransforms.clear();
+	ChangedTransforms.clear();
+	for (size_t i = 0; i < Transforms.size(); ++i)
+	{
+		mat4 localToWorld = Transforms[i]->getLocalToWorld();
+		if (_Proxies[i] >= 0 && localToWorld == _IndexedTransforms[i])
+		{
+			continue;
+		}
+
+		vec3 boundsMin, boundsMax;
+		if (!Transforms[i]->getWorldBounds(boundsMin, boundsMax))
+		{
+			if (_Proxies[i] >= 0)
+			{
+				SceneTree.remove(_Proxies[i]);
+			}
+			// Looked at again every update, until its bounds are known
+			if (_Proxies[i] != UnboundedProxy)
+			{
+				ChangedTransforms.push_back(Transforms[i]);
+				_Proxies[i] = UnboundedProxy;
+			}
+			UnboundedTransforms.push_back(Transforms[i]);
+			continue;
+		}
+
+		ChangedTransforms.push_back(Transforms[i]);
+		if (_Proxies[i] < 0)
+		{
+			_Proxies[i] = SceneTree.insert(Transforms[i], boundsMin, boundsMax);
+		}
+		else
+		{
+			SceneTree.move(_Proxies[i], boundsMin, boundsMax);
+		}
+		_IndexedTransforms[i] = localToWorld;
+	}
 }
 
 void ResourceManager::addShader(ShaderProgram * shader)
 {
 	Shaders.push_back(shader);
 }
+
+std::shared_ptr<Texture> ResourceManager::getTexture(const std::string & file, const TextureOptions & options)
+{
+	std::string key = normalizePath("../assets/textures/" + file) + "|" + 
+		std::to_string(options.mipmap) + "|" + 
+		std::to_string(options.wrap) + "|" + 
+		std::to_string(options.magFilter) + "|" + 
+		std::to_string(options.minFilter) + "|" + 
+		std::to_string((int)options.usage) + "|" + 
+		std::to_string((int)options.compression);
+
+	if (std::shared_ptr<Texture> cached = _Textures[key].lock())
+	{
+		return cached;
+	}
+
+	// Parameters are set before loading so they carry over to the uploaded texture
+	std::shared_ptr<Texture> texture = track(new Texture(), _Textures, key);
+	texture->setWrapParameters(options.wrap);
+	texture->setFilterParameters(options.magFilter, options.minFilter);
+	texture->usage = options.usage;
+	texture->compression = options.compression;
+	AssetLoader::loadTexture(texture, file, options.mipmap, options.placeholder);
+	return texture;
+}
+
+std::shared_ptr<TextureCube> ResourceManager::getTextureCube(const std::vector<std::string>& files, bool mipmap)
+{
+	std::string key;
+	for (const std::string& file : files)
+	{
+		key += normalizePath("../assets/textures/cubemap/" + file) + "|";
+	}
+	key += std::to_string(mipmap);
+
+	if (std::shared_ptr<TextureCube> cached = _TextureCubes[key].lock())
+	{
+		return cached;
+	}
+
+	std::shared_ptr<TextureCube> texture = track(new TextureCube(), _TextureCubes, key);
+	AssetLoader::loadTextureCube(texture, files, mipmap);
+	return texture;
+}
+
+std::shared_ptr<Mesh> ResourceManager::getMesh(const std::string & file)
+{
+	std::string key = normalizePath("../assets/models/" + file);
+
+	if (std::shared_ptr<Mesh> cached = _Meshes[key].lock())
+	{
+		return cached;
+	}
+
+	std::shared_ptr<Mesh> mesh = track(new Mesh(), _Meshes, key);
+	AssetLoader::loadMesh(mesh, file);
+	return mesh;
+}
+
+std::shared_ptr<ShaderProgram> ResourceManager::getShader(const std::string & vertFile, const std::string & fragFile)
+{
+	std::string key = normalizePath(vertFile) + "|" + normalizePath(fragFile);
+
+	if (std::shared_ptr<ShaderProgram> cached = _Shaders[key].lock())
+	{
+		return cached;
+	}
+
+	// A shader that fails to compile still draws, with the default error shader
+	std::shared_ptr<ShaderProgram> shader = track(new ShaderProgram(), _Shaders, key, std::function<void(ShaderProgram*)>([](ShaderProgram* released)
+	{
+		Shaders.erase(std::remove(Shaders.begin(), Shaders.end(), released), Shaders.end());
+	}));
+	shader->load(vertFile, fragFile);
+	addShader(shader.get());
+	return shader;
+}
+
+unsigned int ResourceManager::getNumAssets()
+{
+	return countAlive(_Textures) + countAlive(_TextureCubes) + countAlive(_Meshes) + countAlive(_Shaders);
+}
+
+std::string ResourceManager::normalizePath(const std::string & path)
+{
+	// Windows paths are case insensitive
+	std::string lowered = path;
+	for (char& c : lowered)
+	{
+		c = c == '\\' ? '/' : (char)tolower((unsigned char)c);
+	}
+
+	std::vector<std::string> segments;
+	size_t start = 0;
+	while (start <= lowered.size())
+	{
+		size_t end = lowered.find('/', start);
+		if (end == std::string::npos)
+		{
+			end = lowered.size();
+		}
+		std::string segment = lowered.substr(start, end - start);
+		start = end + 1;
+
+		if (segment.empty() || segment == ".")
+		{
+			continue;
+		}
+		// Leading ".." segments have nothing to cancel and are kept
+		if (segment == ".." && !segments.empty() && segments.back() != "..")
+		{
+			segments.pop_back();
+			continue;
+		}
+		segments.push_back(segment);
+	}
+
+	std::string normalized = !lowered.empty() && lowered[0] == '/' ? "/" : "";
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		normalized += (i > 0 ? "/" : "") + segments[i];
+	}
+	return normalized;
+}
+
+template<typename T>
+std::shared_ptr<T> ResourceManager::track(T * asset, Cache<T> & cache, const std::string & key, std::function<void(T*)> release)
+{
+	std::shared_ptr<T> shared(asset, [&cache, key, release](T* released)
+	{
+		// Worker threads can hold the last reference while a load is still in flight
+		AssetLoader::runOnMainThread([&cache, key, release, released]()
+		{
+			if (release)
+			{
+				release(released);
+			}
+			delete released;
+
+			// The key may already have been reused by a newer request for the same asset
+			auto entry = cache.find(key);
+			if (entry != cache.end() && entry->second.expired())
+			{
+				cache.erase(entry);
+			}
+		});
+	});
+	cache[key] = shared;
+	return shared;
+}
+
+template<typename T>
+unsigned int ResourceManager::countAlive(const Cache<T>& cache)
+{
+	unsigned int count = 0;
+	for (const auto& entry : cache)
+	{
+		count += entry.second.expired() ? 0 : 1;
+	}
+	return count;
+}
@@ -1,5 +1,23 @@
 #pragma once
 #include "GameObject.h"
+#include "TextureCube.h"
+#include "AABBTree.h"
+#include <memory>
+#include <unordered_map>
+#include <functional>
+
+// Everything that decides how a texture ends up on the GPU. Requests that differ in any of these
+// get their own texture, only the placeholder color is shared with the first request.
+struct TextureOptions
+{
+	bool mipmap = true;
+	unsigned char placeholder = 255;
+	GLenum wrap = GL_REPEAT;
+	GLenum magFilter = GL_LINEAR;
+	GLenum minFilter = GL_LINEAR_MIPMAP_LINEAR;
+	TextureUsage usage = TextureUsage::Color;
+	TextureCompression compression = TextureCompression::Default;
+};
 
 class ResourceManager
 {
@@ -7,6 +25,56 @@ public:
 	static void addEntity(Transform* entity);
 	static void addShader(ShaderProgram* shader);
 
+	// Asset registry, call from the main thread only.
+	// Asking for an asset that is already alive returns the same object, so load time and VRAM
+	// scale with unique assets rather than with references. Textures and meshes load through
+	// AssetLoader and are usable right away. An asset is freed, GPU memory included, when its
+	// last handle is released.
+	static std::shared_ptr<Texture> getTexture(const std::string &file, const TextureOptions &options = TextureOptions());
+	static std::shared_ptr<TextureCube> getTextureCube(const std::vector<std::string> &files, bool mipmap = true);
+	static std::shared_ptr<Mesh> getMesh(const std::string &file);
+	// Also registered in Shaders so it is recompiled with the rest
+	static std::shared_ptr<ShaderProgram> getShader(const std::string &vertFile, const std::string &fragFile);
+	// Number of registered assets that are still alive
+	static unsigned int getNumAssets();
+
+	// Lower case with forward slashes, "." and ".." segments resolved
+	static std::string normalizePath(const std::string &path);
+
 	static std::vector<ShaderProgram*> Shaders;
 	static std::vector<Transform*> Transforms;
-};
\ No newline at end of file
+
+	// Keeps SceneTree fitted to the entities, call once a frame after updating them.
+	// Only entities whose world matrix changed are looked at again.
+	static void updateScene();
+
+	// Spatial index of the entities with bounds, for culling and other scene queries
+	static AABBTree SceneTree;
+	// Entities without bounds, such as meshes still loading, which every query should keep
+	static std::vector<Transform*> UnboundedTransforms;
+	// Counts updateScene() calls, so cameras know whether ChangedTransforms is all that changed since they last culled
+	static unsigned int SceneVersion;
+	// Entities added, moved, or that gained or lost bounds in the last updateScene()
+	static std::vector<Transform*> ChangedTransforms;
+
+private:
+	template<typename T>
+	using Cache = std::unordered_map<std::string, std::weak_ptr<T>>;
+
+	// Hands out asset under key. The deleter runs on the main thread, where the OpenGL context lives.
+	template<typename T>
+	static std::shared_ptr<T> track(T* asset, Cache<T> &cache, const std::string &key, std::function<void(T*)> release = nullptr);
+	template<typename T>
+	static unsigned int countAlive(const Cache<T> &cache);
+
+	static Cache<Texture> _Textures;
+	static Cache<TextureCube> _TextureCubes;
+	static Cache<Mesh> _Meshes;
+	static Cache<ShaderProgram> _Shaders;
+
+	// Proxy of an entity known to have no bounds, rather than one not looked at yet
+	static const int UnboundedProxy = -2;
+	// Parallel to Transforms, each entity's proxy in SceneTree and the world matrix it was indexed with
+	static std::vector<int> _Proxies;
+	static std::vector<mat4> _IndexedTransforms;
+};
@@ -1,11 +1,23 @@
 #include "ShaderProgram.h"
 #include "IO.h"
 #include <fstream>
+#include <cstring>
+#include <cstdint>
 #include "Camera.h"
+#include "GL/freeglut.h"
+
+// ARB_gl_spirv is newer than our GLEW, so the entry point is fetched by hand
+#ifndef GL_SHADER_BINARY_FORMAT_SPIR_V_ARB
+#define GL_SHADER_BINARY_FORMAT_SPIR_V_ARB 0x9551
+#endif
+typedef void (GLAPIENTRY *SpecializeShaderProc)(GLuint shader, const GLchar *pEntryPoint,
+	GLuint numSpecializationConstants, const GLuint *pConstantIndex, const GLuint *pConstantValue);
+static SpecializeShaderProc glSpecializeShaderARB = nullptr;
 
 bool ShaderProgram::_IsInitDefault = false;
 
 std::string ShaderProgram::_ShaderDirectory = "../assets/shaders/";
+std::string ShaderProgram::_BinaryDirectory = "../assets/shaders/spirv/";
 GLuint ShaderProgram::_VertShaderDefault = 0;
 GLuint ShaderProgram::_FragShaderDefault = 0;
 GLuint ShaderProgram::_ProgramDefault = 0;
@@ -59,40 +71,84 @@ bool ShaderProgram::load(const std::string & vertFile, const std::string & fragF
 {
 	_VertFilename = vertFile;
 	_FragFilename = fragFile;
+	_IsSPIRV = false;
+	_UsesTexturePools = false;
+	_SPIRVUniformLocations.clear();
 
 	// Create shader and program objects
 	_VertShader = glCreateShader(GL_VERTEX_SHADER);
 	_FragShader = glCreateShader(GL_FRAGMENT_SHADER);
 	_Program = glCreateProgram();
 
+	// Precompiled modules skip the driver's GLSL front end entirely.
+	// Both stages have to come from SPIR-V, a program cannot mix the two.
+	std::vector<char> vertBinary, fragBinary;
+	if (isSPIRVSupported() && 
+		fileExists(_BinaryDirectory + vertFile + ".spv") && 
+		fileExists(_BinaryDirectory + fragFile + ".spv"))
+	{
+		vertBinary = readBinaryFile(_BinaryDirectory + vertFile + ".spv");
+		fragBinary = readBinaryFile(_BinaryDirectory + fragFile + ".spv");
+		_IsSPIRV = !vertBinary.empty() && !fragBinary.empty();
+	}
 
-	// Load our source code for shaders
-	std::string source = readFile(_ShaderDirectory + vertFile);
-	const GLchar *temp = static_cast<const GLchar *>(source.c_str());
-	glShaderSource(_VertShader, 1, &temp, NULL);
+	if (_IsSPIRV)
+	{
+		bool spirvSuccess = loadShaderBinary(_VertShader, vertBinary) && loadShaderBinary(_FragShader, fragBinary);
+		if (spirvSuccess)
+		{
+			glAttachShader(_Program, _VertShader);
+			glAttachShader(_Program, _FragShader);
+			spirvSuccess = linkProgram();
+		}
 
-	source = readFile(_ShaderDirectory + fragFile);
-	temp = static_cast<const GLchar *>(source.c_str());
-	glShaderSource(_FragShader, 1, &temp, NULL);
+		// Modules the driver rejects are compiled from source like any other shader
+		if (!spirvSuccess)
+		{
+			SAT_DEBUG_LOG_WARNING("[ShaderProgram.cpp] SPIR-V of %s and %s failed to load, compiling the GLSL instead.", vertFile.c_str(), fragFile.c_str());
+			unload();
+			_VertShader = glCreateShader(GL_VERTEX_SHADER);
+			_FragShader = glCreateShader(GL_FRAGMENT_SHADER);
+			_Program = glCreateProgram();
+			_IsSPIRV = false;
+		}
+	}
 
-	// Compile vertex and frag shaders
-	if (!compileShader(_VertShader))
+	if (!_IsSPIRV && !compileAndLink())
 	{
-		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] Vertex Shader failed to compile.");
-		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", vertFile.c_str());
-		outputShaderLog(_VertShader);
 		unload();
 		setDefault();
 		return false;
 	}
 
-	if (!compileShader(_FragShader))
+	if (_IsSPIRV)
+	{
+		reflectSPIRV(vertBinary);
+		reflectSPIRV(fragBinary);
+	}
+	// Looked up once here, getUniformLocation() warns about uniforms that are missing
+	_UsesTexturePools = _SPIRVUniformLocations.count("uTexPool") > 0 || glGetUniformLocation(_Program, "uTexPool") >= 0;
+
+	_IsInit = true;
+	return true;
+}
+
+bool ShaderProgram::compileAndLink()
+{
+	// Load our source code for shaders, and compile them
+	if (!loadShaderSource(_VertShader, _VertFilename) || !compileShader(_VertShader))
+	{
+		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] Vertex Shader failed to compile.");
+		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", _VertFilename.c_str());
+		outputShaderLog(_VertShader);
+		return false;
+	}
+
+	if (!loadShaderSource(_FragShader, _FragFilename) || !compileShader(_FragShader))
 	{
 		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] Fragment Shader failed to compile.");
-		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", fragFile.c_str());
+		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", _FragFilename.c_str());
 		outputShaderLog(_FragShader);
-		unload();
-		setDefault();
 		return false;
 	}
 
@@ -102,15 +158,11 @@ bool ShaderProgram::load(const std::string & vertFile, const std::string & fragF
 	if (!linkProgram())
 	{
 		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] Shader Program failed to link.");
-		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", vertFile.c_str());
-		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", fragFile.c_str());
+		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", _VertFilename.c_str());
+		SAT_DEBUG_LOG_ERROR("[ShaderProgram.cpp] %s", _FragFilename.c_str());
 		outputProgramLog();
-		unload();
-		setDefault();
 		return false;
 	}
-
-	_IsInit = true;
 	return true;
 }
 
@@ -124,6 +176,59 @@ bool ShaderProgram::isLoaded() const
 	return _IsInit;
 }
 
+bool ShaderProgram::isSPIRV() const
+{
+	return _IsSPIRV;
+}
+
+bool ShaderProgram::usesTexturePools() const
+{
+	return _UsesTexturePools;
+}
+
+GLuint ShaderProgram::getID() const
+{
+	return _Program;
+}
+
+void ShaderProgram::setSpecialization(const std::string & name, GLuint constantID, GLuint value)
+{
+	for (ShaderSpecialization& specialization : _Specializations)
+	{
+		if (specialization.constantID == constantID)
+		{
+			specialization.name = name;
+			specialization.value = value;
+			return;
+		}
+	}
+	_Specializations.push_back({ name, constantID, value });
+}
+
+bool ShaderProgram::isSPIRVSupported()
+{
+	static bool isChecked = false;
+	static bool isSupported = false;
+	if (!isChecked)
+	{
+		isChecked = true;
+		GLint numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (GLint i = 0; i < numExtensions && !isSupported; ++i)
+		{
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			isSupported = extension && strcmp(extension, "GL_ARB_gl_spirv") == 0;
+		}
+		if (isSupported)
+		{
+			glSpecializeShaderARB = reinterpret_cast<SpecializeShaderProc>(glutGetProcAddress("glSpecializeShaderARB"));
+			isSupported = glSpecializeShaderARB != nullptr;
+		}
+		SAT_DEBUG_LOG("SPIR-V shaders: %s", isSupported ? "supported" : "unsupported, using GLSL source");
+	}
+	return isSupported;
+}
+
 void ShaderProgram::unload()
 {
 	if (_VertShader != 0 && _VertShader != _VertShaderDefault) //If the Vertex shader exists, remove it.
@@ -172,6 +277,14 @@ void ShaderProgram::bindUBO(const std::string & uniformBlockName, unsigned int b
 
 GLint ShaderProgram::getUniformLocation(const std::string & uniformName) const
 {
+	if (_IsSPIRV)
+	{
+		auto reflected = _SPIRVUniformLocations.find(uniformName);
+		if (reflected != _SPIRVUniformLocations.end())
+		{
+			return reflected->second;
+		}
+	}
 	GLint uniformLoc = glGetUniformLocation(_Program, uniformName.c_str());	
 #if _DEBUG
 	if (uniformLoc == -1)
@@ -188,6 +301,24 @@ void ShaderProgram::sendUniform(const std::string & name, const float scalar) co
 	glUniform1f(location, scalar);
 }
 
+void ShaderProgram::sendUniform(const std::string & name, const int integer) const
+{
+	GLint location = getUniformLocation(name);
+	glUniform1i(location, integer);
+}
+
+void ShaderProgram::sendUniform(const std::string & name, const int * integers, int count) const
+{
+	GLint location = getUniformLocation(name);
+	glUniform1iv(location, count, integers);
+}
+
+void ShaderProgram::sendUniform(const std::string & name, const vec2 & vector) const
+{
+	GLint location = getUniformLocation(name);
+	glUniform2fv(location, 1, &vector.x);
+}
+
 void ShaderProgram::sendUniform(const std::string & name, const vec3 & vector) const
 {
 	GLint location = getUniformLocation(name);
@@ -220,6 +351,113 @@ bool ShaderProgram::compileShader(GLuint shader) const
 	return success == GL_TRUE;
 }
 
+bool ShaderProgram::loadShaderSource(GLuint shader, const std::string & file) const
+{
+	std::string source = readFile(_ShaderDirectory + file);
+	if (source.empty())
+	{
+		return false;
+	}
+
+	// Bake specialization constants into the source, they must follow the #version directive
+	if (!_Specializations.empty())
+	{
+		std::string defines;
+		for (const ShaderSpecialization& specialization : _Specializations)
+		{
+			defines += "#define " + specialization.name + " " + std::to_string(specialization.value) + "\n";
+		}
+		size_t versionLine = source.find("#version");
+		size_t insertAt = versionLine == std::string::npos ? 0 : source.find('\n', versionLine);
+		insertAt = insertAt == std::string::npos ? source.size() : insertAt + 1;
+		source.insert(insertAt, defines);
+	}
+
+	const GLchar *temp = static_cast<const GLchar *>(source.c_str());
+	glShaderSource(shader, 1, &temp, NULL);
+	return true;
+}
+
+bool ShaderProgram::loadShaderBinary(GLuint shader, const std::vector<char>& binary)
+{
+	glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, &binary[0], (GLsizei)binary.size());
+
+	std::vector<GLuint> constantIndex, constantValue;
+	for (const ShaderSpecialization& specialization : _Specializations)
+	{
+		constantIndex.push_back(specialization.constantID);
+		constantValue.push_back(specialization.value);
+	}
+	// Specialization takes the place of compilation, constants not present in the module are ignored
+	glSpecializeShaderARB(shader, "main", (GLuint)constantIndex.size(), 
+		constantIndex.empty() ? nullptr : &constantIndex[0], 
+		constantValue.empty() ? nullptr : &constantValue[0]);
+
+	GLint success;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	return success == GL_TRUE;
+}
+
+void ShaderProgram::reflectSPIRV(const std::vector<char>& binary)
+{
+	// Walk the module for OpName/OpDecorate Location/OpVariable UniformConstant
+	// so uniforms can still be found by name when the driver discards the names.
+	enum
+	{
+		OpName = 5,
+		OpVariable = 59,
+		OpDecorate = 71,
+		DecorationLocation = 30,
+		StorageClassUniformConstant = 0
+	};
+
+	const uint32_t* words = reinterpret_cast<const uint32_t*>(&binary[0]);
+	size_t numWords = binary.size() / sizeof(uint32_t);
+	if (numWords < 5 || words[0] != 0x07230203)
+	{
+		SAT_DEBUG_LOG_WARNING("[ShaderProgram.cpp] Invalid SPIR-V module.");
+		return;
+	}
+
+	std::unordered_map<uint32_t, std::string> names;
+	std::unordered_map<uint32_t, GLint> locations;
+	std::vector<uint32_t> uniforms;
+	for (size_t i = 5; i < numWords;)
+	{
+		uint32_t opcode = words[i] & 0xFFFF;
+		uint32_t wordCount = words[i] >> 16;
+		if (wordCount == 0 || i + wordCount > numWords)
+		{
+			break;
+		}
+
+		if (opcode == OpName && wordCount > 2)
+		{
+			const char* name = reinterpret_cast<const char*>(&words[i + 2]);
+			names[words[i + 1]] = std::string(name, strnlen(name, (wordCount - 2) * sizeof(uint32_t)));
+		}
+		else if (opcode == OpDecorate && wordCount > 3 && words[i + 2] == DecorationLocation)
+		{
+			locations[words[i + 1]] = static_cast<GLint>(words[i + 3]);
+		}
+		else if (opcode == OpVariable && wordCount > 3 && words[i + 3] == StorageClassUniformConstant)
+		{
+			uniforms.push_back(words[i + 2]);
+		}
+		i += wordCount;
+	}
+
+	for (uint32_t id : uniforms)
+	{
+		auto name = names.find(id);
+		auto location = locations.find(id);
+		if (name != names.end() && location != locations.end())
+		{
+			_SPIRVUniformLocations[name->second] = location->second;
+		}
+	}
+}
+
 void ShaderProgram::outputShaderLog(GLuint shader) const
 {
 	std::vector<char> infoLog;
@@ -3,10 +3,27 @@
 #include "MiniMath/Core.h"
 #include "GL\glew.h"
 #include <vector>
+#include <unordered_map>
 
 class Camera;
 class Transform;
 
+// Specialization constants replace #define permutations.
+// SPIR-V modules receive them through glSpecializeShader, while the GLSL
+// fallback path injects them as "#define name value" after the #version line.
+// Shaders should declare them as:
+//	#ifdef GL_SPIRV
+//	layout(constant_id = 0) const int NAME = 1;
+//	#elif !defined(NAME)
+//	#define NAME 1
+//	#endif
+struct ShaderSpecialization
+{
+	std::string name;
+	GLuint constantID;
+	GLuint value;
+};
+
 class ShaderProgram
 {
 public: 
@@ -20,9 +37,17 @@ public:
 	bool load(const std::string &vertFile, const std::string &fragFile);
 	bool reload();
 	bool isLoaded() const;
+	bool isSPIRV() const;
+	// True if the program samples pooled textures through uTexPool / uTexLayer (see TextureArray)
+	bool usesTexturePools() const;
+	GLuint getID() const;
 	void unload();
 	bool linkProgram();
 
+	// Must be set before load(), reload() will reapply them.
+	void setSpecialization(const std::string &name, GLuint constantID, GLuint value);
+	static bool isSPIRVSupported();
+
 	void bind() const;
 	static void unbind();
 	void bindUBO(const std::string & uniformBlockName, unsigned int bindSlot) const;
@@ -30,6 +55,9 @@ public:
 	GLint getUniformLocation(const std::string &uniformName) const;
 
 	void sendUniform(const std::string &name, const float scalar) const;
+	void sendUniform(const std::string &name, const int integer) const;
+	void sendUniform(const std::string &name, const int* integers, int count) const;
+	void sendUniform(const std::string &name, const vec2 &vector) const;
 	void sendUniform(const std::string &name, const vec3 &vector) const;
 	void sendUniform(const std::string &name, const vec4 &vector) const;
 	void sendUniform(const std::string &name, const mat4 &matrix, bool transpose = false) const;
@@ -37,6 +65,8 @@ public:
 
 private: 
 	bool _IsInit = false;
+	bool _IsSPIRV = false;
+	bool _UsesTexturePools = false;
 	GLuint _VertShader = 0;
 	GLuint _FragShader = 0;
 	GLuint _Program = 0;
@@ -44,7 +74,12 @@ private:
 	std::string _VertFilename;
 	std::string _FragFilename;
 
+	std::vector<ShaderSpecialization> _Specializations;
+	// Default-block uniform locations reflected from SPIR-V, since the driver is not required to keep names
+	std::unordered_map<std::string, GLint> _SPIRVUniformLocations;
+
 	static std::string _ShaderDirectory;
+	static std::string _BinaryDirectory;
 
 	static bool _IsInitDefault;
 	static GLuint _VertShaderDefault;
@@ -52,6 +87,11 @@ private:
 	static GLuint _ProgramDefault;
 
 	bool compileShader(GLuint shader) const;
+	bool loadShaderSource(GLuint shader, const std::string &file) const;
+	bool loadShaderBinary(GLuint shader, const std::vector<char> &binary);
+	// Builds the program from the GLSL of _VertFilename and _FragFilename, logging what failed
+	bool compileAndLink();
+	void reflectSPIRV(const std::vector<char> &binary);
 	void outputShaderLog(GLuint shader) const;
 	void outputProgramLog() const;
 };
\ No newline at end of file
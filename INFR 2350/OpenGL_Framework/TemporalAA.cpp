@@ -0,0 +1,98 @@
+#include "TemporalAA.h"
+
+int TemporalAA::NumJitterPhases = 8;
+
+TemporalAA::~TemporalAA()
+{
+	unload();
+}
+
+void TemporalAA::unload()
+{
+	if (_History[0])
+	{
+		glDeleteTextures(2, _History);
+		_History[0] = _History[1] = 0;
+	}
+	_HasHistory = false;
+}
+
+void TemporalAA::beginFrame(unsigned width, unsigned height)
+{
+	if (_History[0] && _Desc.width == width && _Desc.height == height)
+	{
+		return;
+	}
+
+	unload();
+	_Desc.width = width;
+	_Desc.height = height;
+	// Bilinear, history is read between texels after reprojection
+	_Desc.format = GL_RGBA16F;
+	_Desc.filter = GL_LINEAR;
+	_Desc.wrap = GL_CLAMP_TO_EDGE;
+
+	glCreateTextures(GL_TEXTURE_2D, 2, _History);
+	for (GLuint handle : _History)
+	{
+		glTextureStorage2D(handle, 1, _Desc.format, width, height);
+		glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, _Desc.filter);
+		glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, _Desc.filter);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_S, _Desc.wrap);
+		glTextureParameteri(handle, GL_TEXTURE_WRAP_T, _Desc.wrap);
+	}
+}
+
+void TemporalAA::endFrame()
+{
+	_Current = 1 - _Current;
+	_HasHistory = true;
+	++_Frame;
+}
+
+void TemporalAA::reset()
+{
+	_HasHistory = false;
+}
+
+vec2 TemporalAA::getJitter(unsigned viewportWidth, unsigned viewportHeight) const
+{
+	// Skip index 0, which is 0 in every base
+	int index = (int)(_Frame % NumJitterPhases) + 1;
+	vec2 offset(halton(index, 2) - 0.5f, halton(index, 3) - 0.5f);
+	// A pixel is 2 / size wide in NDC
+	return vec2(offset.x * 2.0f / viewportWidth, offset.y * 2.0f / viewportHeight);
+}
+
+GLuint TemporalAA::getHistory() const
+{
+	return _History[1 - _Current];
+}
+
+GLuint TemporalAA::getOutput() const
+{
+	return _History[_Current];
+}
+
+const RenderTargetDesc & TemporalAA::getDesc() const
+{
+	return _Desc;
+}
+
+bool TemporalAA::hasHistory() const
+{
+	return _HasHistory;
+}
+
+float TemporalAA::halton(int index, int base)
+{
+	float result = 0.0f;
+	float fraction = 1.0f / base;
+	while (index > 0)
+	{
+		result += (index % base) * fraction;
+		index /= base;
+		fraction /= base;
+	}
+	return result;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "GL/glew.h"
+#include "FrameGraph.h"
+#include <MiniMath/Core.h>
+
+/*
+	///// // TemporalAA // /////
+
+	Keeps the history that temporal anti-aliasing accumulates into, and the sub-pixel
+	jitter that gives each frame different samples to accumulate.
+
+	Each frame the camera's projection is offset by the next point of a Halton (2, 3)
+	sequence (see Camera::setJitter). taa.frag reprojects last frame's output with the
+	motion vectors the scene writes, clips it to the colours around the new sample so
+	disoccluded or changed pixels do not ghost, and blends the two. The output can be
+	larger than the scene's viewport, which makes the pass a temporal upscaler: over a
+	few frames the jittered samples fill in the extra detail.
+
+	The two history textures are owned here and swap roles every frame. They are
+	imported into the frame graph, since they have to outlive it.
+*/
+
+class TemporalAA
+{
+public:
+	~TemporalAA();
+	void unload();
+
+	// Makes the history match the output size, dropping it when that changes
+	void beginFrame(unsigned width, unsigned height);
+	// Call once the frame's pass has written getOutput()
+	void endFrame();
+	// Forgets the history, for camera cuts or after TAA was switched off
+	void reset();
+
+	// This frame's jitter in normalized device coordinates for a viewport of the given size
+	vec2 getJitter(unsigned viewportWidth, unsigned viewportHeight) const;
+
+	GLuint getHistory() const;
+	GLuint getOutput() const;
+	const RenderTargetDesc& getDesc() const;
+	bool hasHistory() const;
+
+	// Length of the jitter sequence
+	static int NumJitterPhases;
+	// Weight kept from the history every frame
+	float feedback = 0.9f;
+
+private:
+	static float halton(int index, int base);
+
+	GLuint _History[2] = {};
+	int _Current = 0;
+	unsigned int _Frame = 0;
+	bool _HasHistory = false;
+	RenderTargetDesc _Desc;
+};
@@ -2,6 +2,10 @@
 
 #include "Texture.h"
 #include "SOIL/SOIL.h"
+#include "ImageContainer.h"
+#include "BlockCompressor.h"
+#include "TextureStreamer.h"
+#include "TextureArray.h"
 #include <vector>
 #include "IO.h"
 #include <iostream>
@@ -9,7 +13,10 @@
 #include <math.h>
 #include <string>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
 float Texture::anisotropyAmount = 16.0f; 
+TextureCompression Texture::defaultCompression = TextureCompression::Fast;
 GLenum Texture::magFilterOverride = GL_LINEAR;
 GLenum Texture::minFilterOverride = GL_LINEAR_MIPMAP_LINEAR;
 
@@ -33,57 +40,386 @@ Texture::~Texture()
 	this->unload();
 }
 
-struct RGB
+namespace
 {
-	float r, g, b;
+	// Binary cache of a parsed .cube, written next to it as .lut
+	struct LUTCacheHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t size;
+		uint32_t reserved;
+	};
+	const char LUTCacheMagic[4] = { 'L', 'U', 'T', '3' };
+	const uint32_t LUTCacheVersion = 1;
+
+	const char* skipBlanks(const char* c)
+	{
+		while (*c == ' ' || *c == '\t' || *c == '\r')
+		{
+			++c;
+		}
+		return c;
+	}
 
-};
+	const char* skipLine(const char* c)
+	{
+		while (*c != '\0' && *c != '\n')
+		{
+			++c;
+		}
+		return *c == '\n' ? c + 1 : c;
+	}
 
-bool Texture::loadLUT(const std::string file)
+	bool isKeyword(const char* c, const char* keyword)
+	{
+		size_t length = strlen(keyword);
+		return strncmp(c, keyword, length) == 0 && (c[length] == ' ' || c[length] == '\t');
+	}
+}
+
+bool Texture::loadLUT(const std::string &file)
 {
-	glEnable(GL_TEXTURE_3D);
-	std::vector<RGB> LUT;
-	std::string LUTPath = ("../assets/CUBE/" + file);
-	std::ifstream LUTfile(LUTPath.c_str());
-	//int LUTSize;
+	this->filename = "../assets/CUBE/" + file;
+	std::string cachePath = getLUTCachePath(this->filename);
 
-	while (!LUTfile.eof())
+	int size = 0;
+	std::vector<uint16_t> texels;
+	unsigned long long cacheTime = getFileWriteTime(cachePath);
+	if (cacheTime == 0 || cacheTime < getFileWriteTime(this->filename) || !readLUTCache(cachePath, size, texels))
 	{
-		std::string LUTline;
-		std::getline(LUTfile, LUTline);
+		if (!parseCubeLUT(this->filename, size, texels))
+		{
+			SAT_DEBUG_LOG_ERROR("LUT BROKE: %s", this->filename.c_str());
+			return false;
+		}
+		writeLUTCache(cachePath, size, texels);
+	}
 
-		if (LUTline.empty()) continue;
+	uploadLUT(size, texels.data());
+	return true;
+}
 
-		RGB line;
-		if (sscanf_s(LUTline.c_str(), "%f %f %f", &line.r, &line.g, &line.b) == 3) LUT.push_back(line);
+bool Texture::parseCubeLUT(const std::string &path, int &size, std::vector<uint16_t> &texels)
+{
+	std::vector<char> file = readBinaryFile(path);
+	if (file.empty())
+	{
+		return false;
+	}
+	file.push_back('\0');
 
+	size = 0;
+	texels.clear();
+	size_t numTexels = 0;
+	const char* c = file.data();
+	while (*c != '\0')
+	{
+		c = skipBlanks(c);
+		if (*c == '#' || *c == '\n' || *c == '\0')
+		{
+			c = skipLine(c);
+			continue;
+		}
+
+		// Keywords only come before the table, everything after LUT_3D_SIZE that is not one is a row
+		if ((*c >= 'A' && *c <= 'Z') || *c == '_')
+		{
+			if (isKeyword(c, "LUT_3D_SIZE"))
+			{
+				size = (int)strtol(c + 11, nullptr, 10);
+				if (size < 2 || size > 256)
+				{
+					SAT_DEBUG_LOG_ERROR("[Texture] %s has an unsupported LUT_3D_SIZE of %d", path.c_str(), size);
+					return false;
+				}
+				numTexels = (size_t)size * size * size;
+				texels.reserve(numTexels * 4);
+			}
+			else if (isKeyword(c, "LUT_1D_SIZE"))
+			{
+				SAT_DEBUG_LOG_ERROR("[Texture] %s is a 1D LUT, only 3D LUTs are supported", path.c_str());
+				return false;
+			}
+			else if (isKeyword(c, "DOMAIN_MIN") || isKeyword(c, "DOMAIN_MAX"))
+			{
+				// The grade samples the cube with colours in 0..1
+				float expected = c[7] == 'M' && c[8] == 'I' ? 0.0f : 1.0f;
+				char* value = const_cast<char*>(c + 10);
+				for (int i = 0; i < 3; ++i)
+				{
+					if (strtof(value, &value) != expected)
+					{
+						SAT_DEBUG_LOG_WARNING("[Texture] %s has a domain other than 0..1, it will be treated as 0..1", path.c_str());
+						break;
+					}
+				}
+			}
+			c = skipLine(c);
+			continue;
+		}
+
+		if (size == 0)
+		{
+			SAT_DEBUG_LOG_ERROR("[Texture] %s has table data before LUT_3D_SIZE", path.c_str());
+			return false;
+		}
+		if (texels.size() == numTexels * 4)
+		{
+			SAT_DEBUG_LOG_ERROR("[Texture] %s has more than %d^3 rows", path.c_str(), size);
+			return false;
+		}
+
+		// Red changes fastest, then green, then blue, the same order as a 3D texture's x, y and z
+		char* next = const_cast<char*>(c);
+		for (int i = 0; i < 3; ++i)
+		{
+			const char* start = next;
+			float value = strtof(start, &next);
+			if (next == start)
+			{
+				SAT_DEBUG_LOG_ERROR("[Texture] %s has a malformed row", path.c_str());
+				return false;
+			}
+			texels.push_back(ImageContainer::floatToHalf(value));
+		}
+		texels.push_back(ImageContainer::floatToHalf(1.0f));
+		c = skipLine(next);
 	}
-	glGenTextures(1, &this->_TexHandle);
-	glBindTexture(GL_TEXTURE_3D, this->_TexHandle);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_REPEAT);
-	glTexImage3D(GL_TEXTURE_3D, 0, GL_RGB, LUT.size(), LUT.size(), LUT.size(), 0, GL_RGB, GL_FLOAT, &LUT[0]);
-	glBindTexture(GL_TEXTURE_3D, 0);
-	//glDisable(GL_TEXTURE_3D);
 
+	if (size == 0 || texels.size() != numTexels * 4)
+	{
+		SAT_DEBUG_LOG_ERROR("[Texture] %s has %d rows, expected %d", path.c_str(), (int)(texels.size() / 4), (int)numTexels);
+		return false;
+	}
+	return true;
+}
+
+std::string Texture::getLUTCachePath(const std::string &path)
+{
+	return path.substr(0, path.find_last_of('.')) + ".lut";
+}
+
+bool Texture::readLUTCache(const std::string &path, int &size, std::vector<uint16_t> &texels)
+{
+	std::vector<char> file = readBinaryFile(path);
+	LUTCacheHeader header;
+	if (file.size() < sizeof(header))
+	{
+		return false;
+	}
+	memcpy(&header, file.data(), sizeof(header));
+
+	size_t numValues = (size_t)header.size * header.size * header.size * 4;
+	if (memcmp(header.magic, LUTCacheMagic, sizeof(LUTCacheMagic)) != 0 || header.version != LUTCacheVersion ||
+		header.size < 2 || header.size > 256 || file.size() != sizeof(header) + numValues * sizeof(uint16_t))
+	{
+		SAT_DEBUG_LOG_WARNING("[Texture] %s is not a valid LUT cache, parsing the .cube instead", path.c_str());
+		return false;
+	}
+
+	size = (int)header.size;
+	texels.resize(numValues);
+	memcpy(texels.data(), file.data() + sizeof(header), numValues * sizeof(uint16_t));
+	return true;
+}
+
+bool Texture::writeLUTCache(const std::string &path, int size, const std::vector<uint16_t> &texels)
+{
+	LUTCacheHeader header = {};
+	memcpy(header.magic, LUTCacheMagic, sizeof(LUTCacheMagic));
+	header.version = LUTCacheVersion;
+	header.size = (uint32_t)size;
+
+	std::vector<char> file(sizeof(header) + texels.size() * sizeof(uint16_t));
+	memcpy(file.data(), &header, sizeof(header));
+	memcpy(file.data() + sizeof(header), texels.data(), texels.size() * sizeof(uint16_t));
+	if (!writeBinaryFile(path, file.data(), file.size()))
+	{
+		SAT_DEBUG_LOG_WARNING("[Texture] Could not cache %s", path.c_str());
+		return false;
+	}
 	return true;
 }
+
+void Texture::uploadLUT(int size, const uint16_t* texels)
+{
+	unload();
+	_Target = GL_TEXTURE_3D;
+	_InternalFormat = GL_RGBA16F;
+	sizeX = size;
+	sizeY = size;
+	channels = 4;
+	poolable = false;
+
+	glCreateTextures(GL_TEXTURE_3D, 1, &_TexHandle);
+	glTextureStorage3D(_TexHandle, 1, GL_RGBA16F, size, size, size);
+	glTextureSubImage3D(_TexHandle, 0, 0, 0, 0, size, size, size, GL_RGBA, GL_HALF_FLOAT, texels);
+
+	// Clamped so the ends of the table map exactly to black and white
+	glTextureParameteri(_TexHandle, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(_TexHandle, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(_TexHandle, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(_TexHandle, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(_TexHandle, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
 bool Texture::load(const std::string & file, bool mipmap)
 {
 	this->filename = "../assets/textures/" + file;
 
-	unsigned char* textureData = SOIL_load_image((this->filename).c_str(),
-		&this->sizeX, &this->sizeY, &this->channels, SOIL_LOAD_RGBA);
+	std::string precompressed = findPrecompressed(this->filename);
+	if (!ImageContainer::isContainerFile(precompressed))
+	{
+		precompressed = findCompressionCache(this->filename);
+	}
+	if (ImageContainer::isContainerFile(precompressed))
+	{
+		return loadContainer(precompressed, mipmap);
+	}
 
-	if (this->sizeX == 0 || this->sizeY == 0 || this->channels == 0)
+	unsigned char* textureData = decodeImage(this->filename, this->sizeX, this->sizeY, this->channels);
+
+	if (textureData == nullptr)
 	{
 		SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", this->filename.c_str());
 		return false;
 	}
-	
+
+	ImageContainer image;
+	if (compressImage(this->filename, textureData, this->sizeX, this->sizeY, mipmap, image))
+	{
+		upload(image, mipmap);
+	}
+	else
+	{
+		upload(textureData, mipmap);
+	}
+	freeImage(textureData);
+	return true;
+}
+
+bool Texture::loadContainer(const std::string & path, bool mipmap)
+{
+	ImageContainer image;
+	if (!image.load(path))
+	{
+		SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", path.c_str());
+		return false;
+	}
+	if (image.isCube())
+	{
+		SAT_DEBUG_LOG_ERROR("[Texture] %s is a cube map, load it with TextureCube", path.c_str());
+		return false;
+	}
+
+	upload(image, mipmap);
+	return true;
+}
+
+std::string Texture::findPrecompressed(const std::string & path)
+{
+	if (ImageContainer::isContainerFile(path))
+	{
+		return path;
+	}
+
+	std::string base = path.substr(0, path.find_last_of('.'));
+	unsigned long long sourceTime = getFileWriteTime(path);
+	for (const char* extension : { ".ktx2", ".dds" })
+	{
+		unsigned long long siblingTime = getFileWriteTime(base + extension);
+		if (siblingTime != 0 && siblingTime >= sourceTime)
+		{
+			return base + extension;
+		}
+	}
+	return path;
+}
+
+std::string Texture::getCompressionCachePath(const std::string & path) const
+{
+	TextureCompression mode = compression == TextureCompression::Default ? defaultCompression : compression;
+	if (mode == TextureCompression::None || mode == TextureCompression::Default)
+	{
+		return std::string();
+	}
+
+	// The usage asked for rather than the one picked, the same image always picks the same
+	const char* usageName = "color";
+	switch (usage)
+	{
+	case TextureUsage::ColorAlpha: usageName = "coloralpha"; break;
+	case TextureUsage::Normal: usageName = "normal"; break;
+	case TextureUsage::Mask: usageName = "mask"; break;
+	default: break;
+	}
+	return path.substr(0, path.find_last_of('.')) + (mode == TextureCompression::Quality ? ".quality." : ".fast.") + usageName + ".dds";
+}
+
+std::string Texture::findCompressionCache(const std::string & path) const
+{
+	std::string cachePath = getCompressionCachePath(path);
+	if (cachePath.empty())
+	{
+		return cachePath;
+	}
+	unsigned long long cacheTime = getFileWriteTime(cachePath);
+	return cacheTime != 0 && cacheTime >= getFileWriteTime(path) ? cachePath : std::string();
+}
+
+bool Texture::compressImage(const std::string & path, const unsigned char * pixels, int width, int height, bool mipmap, ImageContainer & image) const
+{
+	std::string cachePath = getCompressionCachePath(path);
+	if (cachePath.empty())
+	{
+		return false;
+	}
+	TextureCompression mode = compression == TextureCompression::Default ? defaultCompression : compression;
+
+	TextureUsage effectiveUsage = usage;
+	if (effectiveUsage == TextureUsage::Color && BlockCompressor::hasAlpha(pixels, width, height))
+	{
+		effectiveUsage = TextureUsage::ColorAlpha;
+	}
+
+	GLenum format = getCompressedFormat(effectiveUsage, mode == TextureCompression::Quality);
+	if (!BlockCompressor::compress(pixels, width, height, format, mipmap, image))
+	{
+		return false;
+	}
+
+	// Only complete chains are cached, a later load with mipmaps would otherwise pick up a single level
+	if (mipmap)
+	{
+		image.save(cachePath);
+	}
+	return true;
+}
+
+unsigned char * Texture::decodeImage(const std::string & path, int & width, int & height, int & numChannels)
+{
+	width = height = numChannels = 0;
+	unsigned char* pixels = SOIL_load_image(path.c_str(), &width, &height, &numChannels, SOIL_LOAD_RGBA);
+
+	if (width == 0 || height == 0 || numChannels == 0)
+	{
+		SOIL_free_image_data(pixels);
+		return nullptr;
+	}
+	return pixels;
+}
+
+void Texture::freeImage(unsigned char * pixels)
+{
+	SOIL_free_image_data(pixels);
+}
+
+void Texture::upload(const void * pixels, bool mipmap)
+{
+	// Immutable storage cannot be resized, so a placeholder is swapped out for a new texture
+	unload();
+
 	// If the texture is 2D, set it to be a 2D texture;
 	_Target = GL_TEXTURE_2D;
 	_InternalFormat = GL_RGBA8;	
@@ -97,7 +433,7 @@ bool Texture::load(const std::string & file, bool mipmap)
 		0, 0, // No offset
 		this->sizeX, this->sizeY, // the dimensions of our image loaded
 		GL_RGBA, GL_UNSIGNED_BYTE, // Data format and type
-		textureData); // Pointer to the texture data
+		pixels); // Pointer to the texture data
 
 	if (mipmap)
 	{
@@ -110,15 +446,125 @@ bool Texture::load(const std::string & file, bool mipmap)
 	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_T, this->_Wrap.y);
 
 	this->unbind();
-	SOIL_free_image_data(textureData);
-	return true;
+
+	if (poolable)
+	{
+		layer = TextureArray::pack(*this, levels);
+	}
+}
+
+void Texture::upload(const ImageContainer & image, bool mipmap, int firstLevel)
+{
+	unload();
+
+	_Target = GL_TEXTURE_2D;
+	_InternalFormat = image.internalFormat;
+	sizeX = image.width;
+	sizeY = image.height;
+	channels = 4;
+
+	// Compressed levels cannot be generated by the GPU, only what the file holds is used
+	bool generate = mipmap && image.getNumLevels() == 1 && !image.isCompressed();
+	int levels = 1;
+	if (mipmap)
+	{
+		levels = generate ? countMipMapLevels(true) : image.getNumLevels() - firstLevel;
+	}
+	else
+	{
+		firstLevel = 0;
+	}
+
+	const ImageLevel& first = image.getLevel(firstLevel);
+	glGenTextures(1, &this->_TexHandle);
+	this->bind();
+	glTextureStorage2D(this->_TexHandle, levels, this->_InternalFormat, first.width, first.height);
+
+	for (int level = 0; level < levels && firstLevel + level < image.getNumLevels(); ++level)
+	{
+		const ImageLevel& data = image.getLevel(firstLevel + level);
+		if (image.isCompressed())
+		{
+			glCompressedTextureSubImage2D(this->_TexHandle, level, 0, 0, data.width, data.height, this->_InternalFormat, (GLsizei)data.size, image.getPixels(firstLevel + level));
+		}
+		else
+		{
+			glTextureSubImage2D(this->_TexHandle, level, 0, 0, data.width, data.height, image.format, image.type, image.getPixels(firstLevel + level));
+		}
+	}
+
+	if (generate)
+	{
+		generateMipMaps();
+	}
+	sendSamplerParameters(this->_TexHandle, levels);
+
+	this->unbind();
+
+	// Streamed textures are too large to pool, and their storage keeps changing
+	if (poolable && firstLevel == 0)
+	{
+		layer = TextureArray::pack(*this, levels);
+	}
+}
+
+void Texture::adoptStorage(GLuint handle, int numLevels)
+{
+	// Deleted directly, unload() would also drop the texture from the streamer
+	if (this->_TexHandle)
+	{
+		glDeleteTextures(1, &this->_TexHandle);
+	}
+	this->_TexHandle = handle;
+	sendSamplerParameters(handle, numLevels);
+}
+
+void Texture::sendSamplerParameters(GLuint handle, int numLevels) const
+{
+	if (numLevels > 1)
+	{
+		glTextureParameterf(handle, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropyAmount);
+	}
+	glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, numLevels > 1 ? this->_Filter.min : this->_Filter.mag);
+	glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, this->_Filter.mag);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_S, this->_Wrap.x);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_T, this->_Wrap.y);
+}
+
+GLenum Texture::getCompressedFormat(TextureUsage usage, bool highQuality)
+{
+	switch (usage)
+	{
+	case TextureUsage::ColorAlpha:
+		return highQuality ? GL_COMPRESSED_RGBA_BPTC_UNORM : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TextureUsage::Normal:
+		return GL_COMPRESSED_RG_RGTC2;
+	case TextureUsage::Mask:
+		return GL_COMPRESSED_RED_RGTC1;
+	case TextureUsage::Color:
+	default:
+		return highQuality ? GL_COMPRESSED_RGBA_BPTC_UNORM : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	}
+}
+
+void Texture::createPlaceholder(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+	unsigned char pixel[4] = { r, g, b, a };
+	sizeX = 1;
+	sizeY = 1;
+	channels = 4;
+	upload(pixel, false);
 }
 
 bool Texture::unload()
 {
+	TextureStreamer::remove(this);
+	TextureArray::release(layer);
+	layer = TextureLayer();
 	if (this->_TexHandle)
 	{
 		glDeleteTextures(1, &this->_TexHandle);
+		this->_TexHandle = 0;
 		return true;
 	}
 	return false;
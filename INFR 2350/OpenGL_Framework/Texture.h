@@ -1,7 +1,11 @@
 #pragma once
 #include "GL/glew.h"
 #include <string>
-#include "Texture.h"
+#include <vector>
+#include <cstdint>
+#include "TextureArray.h"
+
+class ImageContainer;
 
 struct TextureFilter
 {
@@ -31,6 +35,24 @@ struct TextureWrap
 };
 #pragma warning(pop)
 
+// What the channels of a texture hold, decides which block compressed format suits it
+enum class TextureUsage
+{
+	Color,		// RGB, alpha unused: BC1 (BC7 at high quality)
+	ColorAlpha,	// RGBA: BC3 (BC7 at high quality)
+	Normal,		// Tangent space XY, Z rebuilt in the shader: BC5
+	Mask		// Single channel: BC4
+};
+
+// How images without a precompressed .dds/.ktx2 are stored on the GPU
+enum class TextureCompression
+{
+	Default,	// Use Texture::defaultCompression
+	None,		// Uncompressed RGBA8
+	Fast,		// BC1/BC3 (BC4/BC5 for masks and normals)
+	Quality		// BC7 (BC4/BC5 for masks and normals)
+};
+
 class Texture
 {
 public:
@@ -39,8 +61,51 @@ public:
 	~Texture();
 
 	// Loads the texture
+	// A precompressed file.dds or file.ktx2 next to the image is used in its place when one exists,
+	// then the cache compressImage() made with the same compression and usage.
 	bool load(const std::string &file, bool mipmap = true);
-	bool loadLUT(const std::string file);
+	// Loads a DDS or KTX2 container with all of its mip levels
+	bool loadContainer(const std::string &path, bool mipmap = true);
+	// Returns the path of a precompressed .ktx2 or .dds sibling of path, or path itself if there is none.
+	// Siblings older than the image they were made from are ignored.
+	static std::string findPrecompressed(const std::string &path);
+	// Block compresses decoded RGBA8 pixels according to compression and usage, and caches the result
+	// next to path, see getCompressionCachePath(). Returns false if the texture should stay uncompressed.
+	// Does not touch OpenGL, safe to call from worker threads.
+	bool compressImage(const std::string &path, const unsigned char* pixels, int width, int height, bool mipmap, ImageContainer &image) const;
+	// Decodes an image to RGBA8 on the CPU without touching OpenGL, safe to call from worker threads.
+	// Free the result with freeImage().
+	static unsigned char* decodeImage(const std::string &path, int &width, int &height, int &numChannels);
+	static void freeImage(unsigned char* pixels);
+	// Where compressImage() caches path, named after the compression and usage it was made with
+	// (such as file.fast.color.dds). Empty if this texture stays uncompressed.
+	std::string getCompressionCachePath(const std::string &path) const;
+	// The cache compressImage() left for path with this texture's settings, or an empty string if there
+	// is none or it is older than the image
+	std::string findCompressionCache(const std::string &path) const;
+	// Replaces the texture with immutable RGBA8 storage of sizeX by sizeY and uploads level 0.
+	// pixels may be an offset into a bound GL_PIXEL_UNPACK_BUFFER.
+	void upload(const void* pixels, bool mipmap);
+	// Replaces the texture with immutable storage in the container's format and uploads every level it has,
+	// or only firstLevel and below when the larger levels are left to TextureStreamer.
+	// Uncompressed containers without a mip chain get one generated if mipmap is set.
+	void upload(const ImageContainer &image, bool mipmap, int firstLevel = 0);
+	// Swaps in storage created elsewhere (see TextureStreamer) and applies this texture's sampler state
+	void adoptStorage(GLuint handle, int numLevels);
+	// The block compressed internal format best suited to a usage
+	static GLenum getCompressedFormat(TextureUsage usage, bool highQuality = false);
+	// A 1x1 texture of a solid color, used while the real image is still loading
+	void createPlaceholder(unsigned char r, unsigned char g, unsigned char b, unsigned char a = 255);
+	// Loads a .cube 3D colour lookup table from assets/CUBE as an RGBA16F 3D texture.
+	// The parsed table is cached as a .lut next to the .cube, which later loads read instead.
+	bool loadLUT(const std::string &file);
+	// Parses a .cube into size^3 RGBA16F texels, safe to call from worker threads
+	static bool parseCubeLUT(const std::string &path, int &size, std::vector<uint16_t> &texels);
+	static std::string getLUTCachePath(const std::string &path);
+	static bool readLUTCache(const std::string &path, int &size, std::vector<uint16_t> &texels);
+	static bool writeLUTCache(const std::string &path, int size, const std::vector<uint16_t> &texels);
+	// Replaces the texture with immutable RGBA16F 3D storage of size^3 texels
+	void uploadLUT(int size, const uint16_t* texels);
 	// Unloads the texture
 	bool unload();
 
@@ -62,26 +127,33 @@ public:
 	GLuint getID();
 
 	void sendTexParameters();
+	void sendSamplerParameters(GLuint handle, int numLevels) const;
 	void setFilterParameters(GLenum mag, GLenum min);
 	void setWrapParameters(GLenum wrap);
 
 	static GLenum minFilterOverride;
 	static GLenum magFilterOverride;
 	static float anisotropyAmount;
+	static TextureCompression defaultCompression;
 
 	int countMipMapLevels(bool mipmap);
 	void generateMipMaps();
-	GLuint _TexHandle;
+	GLuint _TexHandle = 0;
 
 	std::string filename;
 	std::string filetype;
+	TextureUsage usage = TextureUsage::Color;
+	TextureCompression compression = TextureCompression::Default;
+	// Small textures are also copied into a shared TextureArray when uploaded
+	bool poolable = true;
+	TextureLayer layer;
 
-	GLenum _InternalFormat;
-	GLenum _Target;
+	GLenum _InternalFormat = GL_RGBA8;
+	GLenum _Target = GL_TEXTURE_2D;
 	TextureFilter _Filter;
 	TextureWrap _Wrap;
 		
-	int sizeX;
-	int sizeY;
-	int channels;
+	int sizeX = 0;
+	int sizeY = 0;
+	int channels = 0;
 };
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include "TextureArray.h"
+#include "Texture.h"
+#include "IO.h"
+#include <algorithm>
+
+std::vector<TextureArray::Pool> TextureArray::_Pools;
+
+TextureLayer TextureArray::pack(const Texture & texture, int numLevels)
+{
+	if (texture._Target != GL_TEXTURE_2D || texture._TexHandle == 0 ||
+		(std::max)(texture.sizeX, texture.sizeY) > MaxSize)
+	{
+		return TextureLayer();
+	}
+
+	int index = 0;
+	while (index < (int)_Pools.size() && !matches(_Pools[index], texture, numLevels))
+	{
+		++index;
+	}
+	if (index == (int)_Pools.size())
+	{
+		if (index == MaxPools)
+		{
+			return TextureLayer();
+		}
+
+		Pool pool;
+		pool.width = texture.sizeX;
+		pool.height = texture.sizeY;
+		pool.numLevels = numLevels;
+		pool.internalFormat = texture._InternalFormat;
+		pool.wrap = texture._Wrap.x;
+		pool.magFilter = texture._Filter.mag;
+		pool.minFilter = texture._Filter.min;
+		_Pools.push_back(pool);
+	}
+
+	Pool& pool = _Pools[index];
+	int layer = (int)(std::find(pool.used.begin(), pool.used.end(), false) - pool.used.begin());
+	if (layer == (int)pool.used.size() && !grow(pool, FirstUnit + index))
+	{
+		return TextureLayer();
+	}
+
+	for (int level = 0; level < numLevels; ++level)
+	{
+		glCopyImageSubData(
+			texture._TexHandle, GL_TEXTURE_2D, level, 0, 0, 0,
+			pool.handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer,
+			(std::max)(1, pool.width >> level), (std::max)(1, pool.height >> level), 1);
+	}
+	pool.used[layer] = true;
+
+	TextureLayer result;
+	result.pool = index;
+	result.layer = layer;
+	return result;
+}
+
+void TextureArray::release(const TextureLayer & layer)
+{
+	if (layer.isValid())
+	{
+		_Pools[layer.pool].used[layer.layer] = false;
+	}
+}
+
+int TextureArray::getNumPools()
+{
+	return (int)_Pools.size();
+}
+
+int TextureArray::getNumLayers()
+{
+	int count = 0;
+	for (const Pool& pool : _Pools)
+	{
+		count += (int)std::count(pool.used.begin(), pool.used.end(), true);
+	}
+	return count;
+}
+
+bool TextureArray::matches(const Pool & pool, const Texture & texture, int numLevels)
+{
+	return pool.width == texture.sizeX && pool.height == texture.sizeY &&
+		pool.numLevels == numLevels &&
+		pool.internalFormat == texture._InternalFormat &&
+		pool.wrap == texture._Wrap.x &&
+		pool.magFilter == texture._Filter.mag &&
+		pool.minFilter == texture._Filter.min;
+}
+
+bool TextureArray::grow(Pool & pool, int unit)
+{
+	int numLayers = (int)pool.used.size();
+	if (numLayers >= MaxLayers)
+	{
+		SAT_DEBUG_LOG_WARNING("[TextureArray] Pool of %dx%d textures is full", pool.width, pool.height);
+		return false;
+	}
+	int newNumLayers = (std::min)(MaxLayers, (std::max)(4, numLayers * 2));
+
+	GLuint handle = 0;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &handle);
+	glTextureStorage3D(handle, pool.numLevels, pool.internalFormat, pool.width, pool.height, newNumLayers);
+	glTextureParameteri(handle, GL_TEXTURE_MIN_FILTER, pool.numLevels > 1 ? pool.minFilter : pool.magFilter);
+	glTextureParameteri(handle, GL_TEXTURE_MAG_FILTER, pool.magFilter);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_S, pool.wrap);
+	glTextureParameteri(handle, GL_TEXTURE_WRAP_T, pool.wrap);
+	if (pool.numLevels > 1)
+	{
+		glTextureParameterf(handle, GL_TEXTURE_MAX_ANISOTROPY_EXT, Texture::anisotropyAmount);
+	}
+
+	if (pool.handle)
+	{
+		for (int level = 0; level < pool.numLevels; ++level)
+		{
+			glCopyImageSubData(
+				pool.handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+				handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+				(std::max)(1, pool.width >> level), (std::max)(1, pool.height >> level), numLayers);
+		}
+		glDeleteTextures(1, &pool.handle);
+	}
+
+	pool.handle = handle;
+	pool.used.resize(newNumLayers, false);
+	glBindTextureUnit(unit, handle);
+	return true;
+}
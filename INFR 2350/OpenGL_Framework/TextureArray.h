@@ -0,0 +1,69 @@
+#pragma once
+#include "GL/glew.h"
+#include <vector>
+
+class Texture;
+
+// Where a pooled texture lives: a pool index and a layer within it
+struct TextureLayer
+{
+	int pool = -1;
+	int layer = -1;
+
+	bool isValid() const
+	{
+		return pool >= 0;
+	}
+};
+
+/*
+	///// // TextureArray // /////
+
+	Packs small textures into the layers of shared GL_TEXTURE_2D_ARRAYs, one pool for each
+	combination of size, format, mip count and sampler state. Textures pack themselves as they are
+	uploaded and keep their own storage, so they can still be bound to shaders that know nothing of pools.
+
+	Every pool stays bound to its own unit from FirstUnit up. Shaders pick a pooled texture with
+	a pool and a layer (uTexPool / uTexLayer, see shaderTexture.frag), so objects whose textures
+	are all pooled draw without binding any textures at all.
+	Pools start small and double, copying the layers they already hold on the GPU.
+*/
+
+class TextureArray
+{
+public:
+	// Copies every level of texture into a free layer of a matching pool.
+	// Returns an invalid layer for textures that are too large or when all pools are taken.
+	static TextureLayer pack(const Texture &texture, int numLevels);
+	static void release(const TextureLayer &layer);
+
+	static int getNumPools();
+	static int getNumLayers();
+
+	// Units FirstUnit to FirstUnit + MaxPools - 1 are reserved for pools
+	static const int FirstUnit = 16;
+	static const int MaxPools = 8;
+	// Largest width or height of a texture that is pooled
+	static const int MaxSize = 256;
+	static const int MaxLayers = 256;
+
+private:
+	struct Pool
+	{
+		GLuint handle = 0;
+		int width = 0;
+		int height = 0;
+		int numLevels = 0;
+		GLenum internalFormat = GL_NONE;
+		GLenum wrap = GL_NONE;
+		GLenum magFilter = GL_NONE;
+		GLenum minFilter = GL_NONE;
+		std::vector<bool> used;
+	};
+
+	static bool matches(const Pool &pool, const Texture &texture, int numLevels);
+	// Reallocates a pool with twice the layers, returns false if it is already as large as it can be
+	static bool grow(Pool &pool, int unit);
+
+	static std::vector<Pool> _Pools;
+};
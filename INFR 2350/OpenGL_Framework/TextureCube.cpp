@@ -1,8 +1,88 @@
 #include "TextureCube.h"
 #include "SOIL/SOIL.h"
 #include "IO.h"
+#include "ImageContainer.h"
+#include "ThreadPool.h"
+#include "ResourceManager.h"
+#include "Framebuffer.h"
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
 #include <vector>
 
+namespace
+{
+	// Reads one scanline of RGBE texels, either flat or with the per-channel run length encoding.
+	// The older run length encoding (1, 1, 1, count) is not supported.
+	bool readScanline(const std::vector<char> &file, size_t &position, int width, unsigned char* scanline)
+	{
+		const unsigned char* data = reinterpret_cast<const unsigned char*>(file.data());
+		size_t size = file.size();
+
+		bool encoded = width >= 8 && width < 0x8000 && position + 4 <= size &&
+			data[position] == 2 && data[position + 1] == 2 && (data[position + 2] & 0x80) == 0;
+		if (!encoded)
+		{
+			size_t bytes = (size_t)width * 4;
+			if (position + bytes > size)
+			{
+				return false;
+			}
+			memcpy(scanline, data + position, bytes);
+			position += bytes;
+			return true;
+		}
+
+		if (((data[position + 2] << 8) | data[position + 3]) != width)
+		{
+			return false;
+		}
+		position += 4;
+
+		for (int channel = 0; channel < 4; ++channel)
+		{
+			int x = 0;
+			while (x < width)
+			{
+				if (position >= size)
+				{
+					return false;
+				}
+				int count = data[position++];
+				if (count > 128)
+				{
+					// A run of one value
+					count -= 128;
+					if (position >= size || x + count > width)
+					{
+						return false;
+					}
+					unsigned char value = data[position++];
+					for (int i = 0; i < count; ++i)
+					{
+						scanline[(x++) * 4 + channel] = value;
+					}
+				}
+				else
+				{
+					// count literal values
+					if (count == 0 || x + count > width || position + count > size)
+					{
+						return false;
+					}
+					for (int i = 0; i < count; ++i)
+					{
+						scanline[(x++) * 4 + channel] = data[position++];
+					}
+				}
+			}
+		}
+		return true;
+	}
+}
+
 std::string facePath[] = 
 {
 	"Right",
@@ -25,6 +105,12 @@ TextureCube::TextureCube(const std::vector<std::string>& file)
 
 bool TextureCube::load(const std::string & file, bool mipmap)
 {
+	// A file that exists as named is a panorama, otherwise it names a set of six faces
+	if (fileExists("../assets/textures/cubemap/" + file))
+	{
+		return loadEquirectangular(file, mipmap);
+	}
+
 	filename = file;
 	size_t offset = file.find_last_of('.');
 	filetype = file.substr(offset + 1);
@@ -42,64 +128,418 @@ bool TextureCube::load(const std::string & file, bool mipmap)
 
 bool TextureCube::load(const std::vector<std::string>& file, bool mipmap)
 {
+	if (file.size() == 1)
+	{
+		return loadEquirectangular(file[0], mipmap);
+	}
+
 	filename = "../assets/textures/cubemap/" + file[0];
 	size_t offset = file[0].find_last_of('.');
 	filetype = file[0].substr(offset + 1);
 
+	std::string precompressed = findPrecompressed(file);
+	if (!precompressed.empty())
+	{
+		ImageContainer image;
+		if (image.load(precompressed) && image.isCube())
+		{
+			uploadCube(image, mipmap);
+			return true;
+		}
+		SAT_DEBUG_LOG_WARNING("[TextureCube] %s is not a usable cube map, loading the faces instead", precompressed.c_str());
+	}
+
+	std::vector<unsigned char*> textureData;
+	if (!decodeFaces(file, textureData, sizeX, sizeY))
+	{
+		SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", this->filename.c_str());
+		return false;
+	}
+	channels = 4;
+
+	uploadFaces(textureData, mipmap);
+	for (unsigned char* face : textureData)
+	{
+		freeImage(face);
+	}
+	return true;
+}
+
+std::string TextureCube::findPrecompressed(const std::vector<std::string>& file)
+{
+	std::string firstFace = "../assets/textures/cubemap/" + file[0];
+	std::string precompressed = Texture::findPrecompressed(firstFace);
+	return precompressed == firstFace ? std::string() : precompressed;
+}
+
+bool TextureCube::decodeFaces(const std::vector<std::string>& file, std::vector<unsigned char*>& faces, int & width, int & height)
+{
+	faces.assign(6, nullptr);
+	int widths[6] = {};
+	int heights[6] = {};
+
+	// Faces decode side by side, parallelFor lets the calling job help out
+	ThreadPool::shared().parallelFor(6, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; ++i)
+		{
+			int numChannels = 0;
+			faces[i] = SOIL_load_image(("../assets/textures/cubemap/" + file[i]).c_str(),
+				&widths[i], &heights[i], &numChannels, SOIL_LOAD_RGBA);
+			if (faces[i] == nullptr || widths[i] == 0 || heights[i] == 0)
+			{
+				continue;
+			}
+
+			// Cube maps are addressed with +Y up, images are stored top row first
+			size_t rowSize = (size_t)widths[i] * 4;
+			std::vector<unsigned char> row(rowSize);
+			for (int y = 0; y < heights[i] / 2; ++y)
+			{
+				unsigned char* top = faces[i] + (size_t)y * rowSize;
+				unsigned char* bottom = faces[i] + (size_t)(heights[i] - y - 1) * rowSize;
+				memcpy(row.data(), top, rowSize);
+				memcpy(top, bottom, rowSize);
+				memcpy(bottom, row.data(), rowSize);
+			}
+		}
+	});
+
+	bool success = true;
+	for (int i = 0; i < 6; ++i)
+	{
+		if (faces[i] == nullptr || widths[i] == 0 || heights[i] == 0)
+		{
+			SAT_DEBUG_LOG_ERROR("[TextureCube] Could not read %s", file[i].c_str());
+			success = false;
+		}
+		else if (widths[i] != widths[0] || heights[i] != heights[0])
+		{
+			SAT_DEBUG_LOG_ERROR("[TextureCube] %s does not match the size of the other faces", file[i].c_str());
+			success = false;
+		}
+	}
+
+	if (!success)
+	{
+		for (unsigned char* face : faces)
+		{
+			SOIL_free_image_data(face);
+		}
+		faces.clear();
+		return false;
+	}
+
+	width = widths[0];
+	height = heights[0];
+	return true;
+}
+
+void TextureCube::uploadFaces(const std::vector<unsigned char*>& faces, bool mipmap)
+{
+	unload();
+
 	_Target = GL_TEXTURE_CUBE_MAP;
-	_InternalFormat = GL_RGB8;
+	_InternalFormat = GL_RGBA8;
+
+	int levels = countMipMapLevels(mipmap);
 
 	glGenTextures(1, &this->_TexHandle);
 	bind();
+	glTextureStorage2D(this->_TexHandle, levels, this->_InternalFormat, sizeX, sizeY);
 
-	std::vector<unsigned char*> textureData(6);
+	// Cube map faces are addressed as layers of a 2D array through DSA
+	for (int face = 0; face < 6; ++face)
+	{
+		glTextureSubImage3D(this->_TexHandle, 0, 0, 0, face, sizeX, sizeY, 1, GL_RGBA, GL_UNSIGNED_BYTE, faces[face]);
+	}
+	if (levels > 1)
+	{
+		generateMipMaps();
+	}
 
-	for (int i = 0; i < 6; ++i)
+	_Wrap.x = GL_CLAMP_TO_EDGE;
+	_Wrap.y = GL_CLAMP_TO_EDGE;
+
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MIN_FILTER, levels > 1 ? this->_Filter.min : this->_Filter.mag);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MAG_FILTER, this->_Filter.mag);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_S, this->_Wrap.x);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_T, this->_Wrap.y);
+
+	this->unbind();
+}
+
+void TextureCube::uploadCube(const ImageContainer & image, bool mipmap)
+{
+	unload();
+
+	_Target = GL_TEXTURE_CUBE_MAP;
+	_InternalFormat = image.internalFormat;
+	sizeX = image.width;
+	sizeY = image.height;
+	channels = 4;
+
+	int levels = mipmap ? image.getNumLevels() : 1;
+
+	glGenTextures(1, &this->_TexHandle);
+	bind();
+	glTextureStorage2D(this->_TexHandle, levels, this->_InternalFormat, sizeX, sizeY);
+
+	// Cube map faces are addressed as layers of a 2D array through DSA
+	for (int level = 0; level < levels; ++level)
+	{
+		for (int face = 0; face < 6; ++face)
+		{
+			const ImageLevel& data = image.getLevel(level, face);
+			if (image.isCompressed())
+			{
+				glCompressedTextureSubImage3D(this->_TexHandle, level, 0, 0, face, data.width, data.height, 1, this->_InternalFormat, (GLsizei)data.size, image.getPixels(level, face));
+			}
+			else
+			{
+				glTextureSubImage3D(this->_TexHandle, level, 0, 0, face, data.width, data.height, 1, image.format, image.type, image.getPixels(level, face));
+			}
+		}
+	}
+
+	_Wrap.x = GL_CLAMP_TO_EDGE;
+	_Wrap.y = GL_CLAMP_TO_EDGE;
+
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MIN_FILTER, levels > 1 ? this->_Filter.min : this->_Filter.mag);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MAG_FILTER, this->_Filter.mag);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_S, this->_Wrap.x);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_T, this->_Wrap.y);
+
+	this->unbind();
+}
+
+void TextureCube::createPlaceholder(unsigned char r, unsigned char g, unsigned char b)
+{
+	unsigned char pixel[4] = { r, g, b, 255 };
+	std::vector<unsigned char*> faces(6, pixel);
+	sizeX = 1;
+	sizeY = 1;
+	channels = 4;
+	uploadFaces(faces, false);
+}
+
+bool TextureCube::loadEquirectangular(const std::string & file, bool mipmap)
+{
+	filename = "../assets/textures/cubemap/" + file;
+	filetype = file.substr(file.find_last_of('.') + 1);
+
+	std::string cached = findPrecompressed({ file });
+	if (!cached.empty())
 	{
-		textureData[i] = SOIL_load_image(("../assets/textures/cubemap/" + file[i]).c_str(),
-			&this->sizeX, &this->sizeY, &this->channels, SOIL_LOAD_RGB);
+		ImageContainer image;
+		if (image.load(cached) && image.isCube())
+		{
+			uploadCube(image, mipmap);
+			return true;
+		}
+	}
 
-		if (this->sizeX == 0 || this->sizeY == 0 || this->channels == 0)
+	ImageContainer panorama;
+	if (!decodePanorama(filename, panorama))
+	{
+		SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", filename.c_str());
+		return false;
+	}
+	convertEquirectangular(panorama, mipmap);
+
+	// Only complete cubes are cached, a later load may want the mips
+	if (mipmap)
+	{
+		ImageContainer cube;
+		readBack(cube);
+		if (!cube.save(getPanoramaCachePath(filename)))
+		{
+			SAT_DEBUG_LOG_WARNING("[TextureCube] Could not cache %s", filename.c_str());
+		}
+	}
+	return true;
+}
+
+bool TextureCube::decodePanorama(const std::string & path, ImageContainer & image)
+{
+	std::string extension = path.substr(path.find_last_of('.') + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	if (extension == "hdr")
+	{
+		return decodeRGBE(path, image);
+	}
+
+	int width = 0, height = 0, numChannels = 0;
+	unsigned char* pixels = SOIL_load_image(path.c_str(), &width, &height, &numChannels, SOIL_LOAD_RGBA);
+	if (pixels == nullptr || width == 0 || height == 0)
+	{
+		SOIL_free_image_data(pixels);
+		return false;
+	}
+	image.create(GL_RGBA8, width, height, 1);
+	memcpy(image.getLevelData(0), pixels, (size_t)width * height * 4);
+	SOIL_free_image_data(pixels);
+	return true;
+}
+
+bool TextureCube::decodeRGBE(const std::string & path, ImageContainer & image)
+{
+	std::vector<char> file = readBinaryFile(path);
+	size_t position = 0;
+	auto readLine = [&](std::string &line)
+	{
+		line.clear();
+		while (position < file.size() && file[position] != '\n')
+		{
+			line += file[position++];
+		}
+		if (position >= file.size())
 		{
-			SAT_DEBUG_LOG_ERROR("TEXTURE BROKE: %s", this->filename.c_str());
-			unload();
 			return false;
 		}
+		++position;
+		return true;
+	};
 
-		for (int x = 0; x < sizeX; ++x)
+	std::string line;
+	if (!readLine(line) || line.compare(0, 2, "#?") != 0)
+	{
+		SAT_DEBUG_LOG_ERROR("[TextureCube] %s is not a Radiance HDR file", path.c_str());
+		return false;
+	}
+
+	// Header lines run up to an empty line
+	while (readLine(line) && !line.empty())
+	{
+		if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
 		{
-			for (int y = 0; y < sizeY / 2; ++y)
+			SAT_DEBUG_LOG_ERROR("[TextureCube] %s: %s is not supported", path.c_str(), line.c_str());
+			return false;
+		}
+	}
+
+	// Only the standard orientation, rows from the top with pixels left to right
+	int width = 0, height = 0;
+	if (!readLine(line) || sscanf(line.c_str(), "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0)
+	{
+		SAT_DEBUG_LOG_ERROR("[TextureCube] %s: unsupported resolution line", path.c_str());
+		return false;
+	}
+
+	image.create(GL_RGB16F, width, height, 1);
+	uint16_t* output = reinterpret_cast<uint16_t*>(image.getLevelData(0));
+	std::vector<unsigned char> scanline((size_t)width * 4);
+	for (int y = 0; y < height; ++y)
+	{
+		if (!readScanline(file, position, width, scanline.data()))
+		{
+			SAT_DEBUG_LOG_ERROR("[TextureCube] %s is truncated or corrupt", path.c_str());
+			image.clear();
+			return false;
+		}
+
+		for (int x = 0; x < width; ++x)
+		{
+			const unsigned char* rgbe = &scanline[x * 4];
+			float scale = rgbe[3] == 0 ? 0.0f : ldexpf(1.0f, rgbe[3] - (128 + 8));
+			for (int c = 0; c < 3; ++c)
 			{
-				for (int c = 0; c < 3; ++c)
-				{
-					std::swap(textureData[i][(x + (y*sizeX)) * 3 + c], textureData[i][(x + ((sizeY - y - 1)*sizeX)) * 3 + c]);
-				}
+				*output++ = ImageContainer::floatToHalf(rgbe[c] * scale);
 			}
 		}
 	}
+	return true;
+}
 
-	//int levels = countMipMapLevels(mipmap);
+void TextureCube::convertEquirectangular(const ImageContainer & panorama, bool mipmap, int faceSize)
+{
+	// A face spans a quarter of the panorama's width
+	if (faceSize <= 0)
+	{
+		faceSize = 16;
+		while (faceSize * 2 <= panorama.width / 4 && faceSize < 2048)
+		{
+			faceSize *= 2;
+		}
+	}
 
-	for (int i = 0; i < 6; ++i)
+	Texture source;
+	source.poolable = false;
+	source.setFilterParameters(GL_LINEAR, GL_LINEAR);
+	source.setWrapParameters(GL_REPEAT);
+	source._Wrap.y = GL_CLAMP_TO_EDGE;
+	// RGB16F rows are not always 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	source.upload(panorama, false);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	unload();
+	_Target = GL_TEXTURE_CUBE_MAP;
+	_InternalFormat = GL_RGB16F;
+	sizeX = faceSize;
+	sizeY = faceSize;
+	channels = 3;
+	int levels = countMipMapLevels(mipmap);
+	glGenTextures(1, &this->_TexHandle);
+	bind();
+	glTextureStorage2D(this->_TexHandle, levels, this->_InternalFormat, sizeX, sizeY);
+	this->unbind();
+
+	// One full screen pass per face, each face attached as a layer of the cube
+	std::shared_ptr<ShaderProgram> shader = ResourceManager::getShader("passthrough.vert", "equirectToCube.frag");
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLint previousFramebuffer = 0;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+
+	GLuint framebuffer = 0;
+	glCreateFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, faceSize, faceSize);
+	shader->bind();
+	source.bind(0);
+	for (int face = 0; face < 6; ++face)
 	{
-		glTexImage2D(
-			GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-			0, GL_RGB, sizeX, sizeY, 0, GL_RGB, GL_UNSIGNED_BYTE, textureData[i]);
-		SOIL_free_image_data(textureData[i]);
+		glNamedFramebufferTextureLayer(framebuffer, GL_COLOR_ATTACHMENT0, this->_TexHandle, 0, face);
+		shader->sendUniform("uFace", face);
+		Framebuffer::drawFSQ();
 	}
-	if (mipmap)
+	source.unbind(0);
+	ShaderProgram::unbind();
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glDeleteFramebuffers(1, &framebuffer);
+
+	if (levels > 1)
 	{
 		generateMipMaps();
 	}
 
 	_Wrap.x = GL_CLAMP_TO_EDGE;
 	_Wrap.y = GL_CLAMP_TO_EDGE;
-
-	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MIN_FILTER, this->_Filter.min);
+	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MIN_FILTER, levels > 1 ? this->_Filter.min : this->_Filter.mag);
 	glTextureParameteri(this->_TexHandle, GL_TEXTURE_MAG_FILTER, this->_Filter.mag);
 	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_S, this->_Wrap.x);
 	glTextureParameteri(this->_TexHandle, GL_TEXTURE_WRAP_T, this->_Wrap.y);
+}
 
-	this->unbind();
-	return true;
+void TextureCube::readBack(ImageContainer & image) const
+{
+	GLint levels = 1;
+	glGetTextureParameteriv(this->_TexHandle, GL_TEXTURE_IMMUTABLE_LEVELS, &levels);
+	image.create(GL_RGB16F, sizeX, sizeY, levels, 6);
+
+	// The faces of a level are consecutive in the container, the same order glGetTextureImage returns them in
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (int level = 0; level < levels; ++level)
+	{
+		GLsizei size = (GLsizei)(image.getLevel(level).size * 6);
+		glGetTextureImage(this->_TexHandle, level, image.format, image.type, size, image.getLevelData(level));
+	}
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+std::string TextureCube::getPanoramaCachePath(const std::string & path)
+{
+	return path.substr(0, path.find_last_of('.')) + ".ktx2";
 }
@@ -10,6 +10,30 @@ public:
 	TextureCube(const std::vector<std::string> &file);
 	bool load(const std::string &file, bool mipmap = true);
 	bool load(const std::vector<std::string> &file, bool mipmap = true);
-private:
 
+	// Cooked cube maps are stored next to the first face as a single .ktx2 or .dds
+	static std::string findPrecompressed(const std::vector<std::string> &file);
+	// Decodes the six faces to RGBA8 and flips them on the CPU, in parallel. Safe to call from worker threads.
+	// On success the caller owns the faces and frees them with Texture::freeImage().
+	static bool decodeFaces(const std::vector<std::string> &file, std::vector<unsigned char*> &faces, int &width, int &height);
+	// Uploads six RGBA8 faces of sizeX by sizeY into immutable storage, with a generated mip chain if mipmap is set
+	void uploadFaces(const std::vector<unsigned char*> &faces, bool mipmap);
+	// Uploads a cube map container (see TextureCooker) with every level it holds
+	void uploadCube(const ImageContainer &image, bool mipmap);
+	void createPlaceholder(unsigned char r, unsigned char g, unsigned char b);
+
+	// Loads a single equirectangular panorama as an RGB16F cube map, converted on the GPU.
+	// The cube is cached as a .ktx2 next to the panorama, which later loads use instead.
+	bool loadEquirectangular(const std::string &file, bool mipmap = true);
+	// Decodes a panorama to RGB16F (.hdr, RGBE) or RGBA8 (anything SOIL reads).
+	// Does not touch OpenGL, safe to call from worker threads.
+	static bool decodePanorama(const std::string &path, ImageContainer &image);
+	// Renders a decoded panorama into the six faces, faceSize 0 picks one to match the panorama
+	void convertEquirectangular(const ImageContainer &panorama, bool mipmap, int faceSize = 0);
+	// Copies every level of the cube back into an RGB16F container, stalls until the GPU has finished
+	void readBack(ImageContainer &image) const;
+	// Where the converted cube of a panorama is cached
+	static std::string getPanoramaCachePath(const std::string &path);
+private:
+	static bool decodeRGBE(const std::string &path, ImageContainer &image);
 };
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "TextureStreamer.h"
+#include "Texture.h"
+#include "ImageContainer.h"
+#include "AssetLoader.h"
+#include "ThreadPool.h"
+#include "IO.h"
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <cmath>
+
+std::unordered_map<const Texture*, TextureStreamer::Entry> TextureStreamer::_Entries;
+size_t TextureStreamer::_ResidentBytes = 0;
+size_t TextureStreamer::_ReservedBytes = 0;
+unsigned int TextureStreamer::_Frame = 0;
+unsigned int TextureStreamer::_NextGeneration = 0;
+int TextureStreamer::_NumLoading = 0;
+vec3 TextureStreamer::_CameraPosition = vec3(0.0f);
+float TextureStreamer::_PixelsPerUnit = 0.0f;
+
+bool TextureStreamer::enabled = true;
+size_t TextureStreamer::budgetBytes = 256 * 1024 * 1024;
+float TextureStreamer::detailBias = 1.0f;
+int TextureStreamer::TailSize = 64;
+
+namespace
+{
+	// Reads in flight at once, each one grows a single texture
+	const int MaxLoads = 2;
+	// MIN_LOD drops by this much a frame while new levels fade in
+	const float FadeStep = 0.125f;
+}
+
+int TextureStreamer::getTailLevel(const ImageContainer & image)
+{
+	if (!enabled || image.isCube())
+	{
+		return 0;
+	}
+
+	for (int level = 1; level < image.getNumLevels(); ++level)
+	{
+		const ImageLevel& data = image.getLevel(level);
+		if ((std::max)(data.width, data.height) <= TailSize)
+		{
+			return level;
+		}
+	}
+	// Small enough to keep whole, or the chain stops before it gets small
+	return 0;
+}
+
+void TextureStreamer::add(Texture * texture, const std::string & path, const ImageContainer & image, int firstLevel)
+{
+	remove(texture);
+
+	Entry entry;
+	entry.texture = texture;
+	entry.path = path;
+	entry.internalFormat = image.internalFormat;
+	entry.format = image.format;
+	entry.type = image.type;
+	entry.width = image.width;
+	entry.height = image.height;
+	entry.numLevels = image.getNumLevels();
+	entry.tailLevel = firstLevel;
+	entry.residentLevel = firstLevel;
+	entry.wantedLevel = firstLevel;
+	entry.residentBytes = calculateBytes(entry, firstLevel);
+	entry.lastUsedFrame = _Frame;
+	entry.generation = ++_NextGeneration;
+
+	_ResidentBytes += entry.residentBytes;
+	_Entries[texture] = entry;
+}
+
+void TextureStreamer::remove(Texture * texture)
+{
+	auto found = _Entries.find(texture);
+	if (found == _Entries.end())
+	{
+		return;
+	}
+
+	// A read still in flight is dropped when it finds its entry gone
+	Entry& entry = found->second;
+	_ResidentBytes -= entry.residentBytes;
+	_ReservedBytes -= entry.reservedBytes;
+	if (entry.loadingLevel >= 0)
+	{
+		--_NumLoading;
+	}
+	_Entries.erase(found);
+}
+
+void TextureStreamer::setView(const mat4 & projection, const vec3 & cameraPosition, int viewportHeight)
+{
+	_CameraPosition = cameraPosition;
+	// For a perspective projection UpY is 1 / tan(fovy / 2), so one unit at distance one covers
+	// UpY / 2 of the viewport's height
+	_PixelsPerUnit = projection[mat4::UpY] * viewportHeight * 0.5f;
+}
+
+void TextureStreamer::request(const Texture * texture, const vec3 & center, float radius)
+{
+	auto found = _Entries.find(texture);
+	if (found == _Entries.end())
+	{
+		return;
+	}
+
+	float distance = Distance(center, _CameraPosition);
+	float footprint = distance > radius ? 2.0f * radius * _PixelsPerUnit / distance : (std::numeric_limits<float>::max)();
+	found->second.footprint = (std::max)(found->second.footprint, footprint);
+}
+
+void TextureStreamer::update()
+{
+	++_Frame;
+
+	std::vector<Entry*> growing;
+	for (auto& pair : _Entries)
+	{
+		Entry& entry = pair.second;
+		if (entry.minLod > 0.0f)
+		{
+			entry.minLod = (std::max)(0.0f, entry.minLod - FadeStep);
+			glTextureParameterf(entry.texture->_TexHandle, GL_TEXTURE_MIN_LOD, entry.minLod);
+		}
+
+		if (entry.footprint > 0.0f)
+		{
+			entry.lastUsedFrame = _Frame;
+		}
+		entry.wantedLevel = getWantedLevel(entry);
+		entry.footprint = 0.0f;
+
+		if (entry.wantedLevel < entry.residentLevel && entry.loadingLevel < 0)
+		{
+			growing.push_back(&entry);
+		}
+	}
+
+	// Textures missing the most detail go first
+	std::sort(growing.begin(), growing.end(), [](const Entry* a, const Entry* b)
+	{
+		return a->residentLevel - a->wantedLevel > b->residentLevel - b->wantedLevel;
+	});
+
+	for (Entry* entry : growing)
+	{
+		if (_NumLoading >= MaxLoads)
+		{
+			break;
+		}
+
+		// Settle for less than wanted when the budget is tight
+		for (int level = entry->wantedLevel; level < entry->residentLevel; ++level)
+		{
+			if (makeRoom(calculateBytes(*entry, level) - entry->residentBytes, *entry))
+			{
+				startLoad(*entry, level);
+				break;
+			}
+		}
+	}
+}
+
+size_t TextureStreamer::getResidentBytes()
+{
+	return _ResidentBytes;
+}
+
+int TextureStreamer::getNumTextures()
+{
+	return (int)_Entries.size();
+}
+
+int TextureStreamer::getWantedLevel(const Entry & entry)
+{
+	// Textures that were not drawn keep what they have until the budget needs it back
+	if (entry.footprint <= 0.0f)
+	{
+		return entry.residentLevel;
+	}
+
+	float texels = (float)(std::max)(entry.width, entry.height);
+	int level = (int)floorf(log2f(texels / (entry.footprint * detailBias)));
+	return (std::max)(0, (std::min)(level, entry.tailLevel));
+}
+
+size_t TextureStreamer::calculateBytes(const Entry & entry, int firstLevel)
+{
+	size_t bytes = 0;
+	for (int level = firstLevel; level < entry.numLevels; ++level)
+	{
+		bytes += ImageContainer::calculateLevelSize(entry.internalFormat, (std::max)(1, entry.width >> level), (std::max)(1, entry.height >> level));
+	}
+	return bytes;
+}
+
+bool TextureStreamer::makeRoom(size_t extra, const Entry & keep)
+{
+	if (_ResidentBytes + _ReservedBytes + extra <= budgetBytes)
+	{
+		return true;
+	}
+
+	// Textures drawn last frame only give up what they no longer need, the rest go back to their tail
+	std::vector<std::pair<Entry*, int>> shrinkable;
+	size_t reclaimable = 0;
+	for (auto& pair : _Entries)
+	{
+		Entry& entry = pair.second;
+		if (&entry == &keep || entry.loadingLevel >= 0)
+		{
+			continue;
+		}
+
+		int target = entry.lastUsedFrame == _Frame ? entry.wantedLevel : entry.tailLevel;
+		if (target > entry.residentLevel)
+		{
+			shrinkable.push_back({ &entry, target });
+			reclaimable += entry.residentBytes - calculateBytes(entry, target);
+		}
+	}
+
+	size_t needed = _ResidentBytes + _ReservedBytes + extra - budgetBytes;
+	if (reclaimable < needed)
+	{
+		return false;
+	}
+
+	// Least recently used first
+	std::sort(shrinkable.begin(), shrinkable.end(), [](const std::pair<Entry*, int>& a, const std::pair<Entry*, int>& b)
+	{
+		return a.first->lastUsedFrame < b.first->lastUsedFrame;
+	});
+
+	for (const std::pair<Entry*, int>& candidate : shrinkable)
+	{
+		resize(*candidate.first, candidate.second, nullptr);
+		if (_ResidentBytes + _ReservedBytes + extra <= budgetBytes)
+		{
+			break;
+		}
+	}
+	return true;
+}
+
+void TextureStreamer::startLoad(Entry & entry, int level)
+{
+	entry.loadingLevel = level;
+	entry.reservedBytes = calculateBytes(entry, level) - entry.residentBytes;
+	_ReservedBytes += entry.reservedBytes;
+	++_NumLoading;
+
+	const Texture* texture = entry.texture;
+	unsigned int generation = entry.generation;
+	std::string path = entry.path;
+	GLenum internalFormat = entry.internalFormat;
+	int width = entry.width;
+	int height = entry.height;
+	int residentLevel = entry.residentLevel;
+
+	ThreadPool::shared().submit([=]()
+	{
+		// The container is mapped, only the pages of the levels copied here are read from disk
+		ImageContainer image;
+		std::shared_ptr<LoadedLevels> levels;
+		if (image.load(path) && image.internalFormat == internalFormat &&
+			image.width == width && image.height == height && image.getNumLevels() >= residentLevel)
+		{
+			levels = std::make_shared<LoadedLevels>();
+			for (int i = level; i < residentLevel; ++i)
+			{
+				const ImageLevel& data = image.getLevel(i);
+				levels->offsets.push_back(levels->data.size());
+				levels->sizes.push_back(data.size);
+				levels->data.insert(levels->data.end(), image.getData() + data.offset, image.getData() + data.offset + data.size);
+			}
+		}
+		else
+		{
+			SAT_DEBUG_LOG_ERROR("[TextureStreamer] %s changed since it was loaded, it will no longer stream", path.c_str());
+		}
+
+		AssetLoader::runOnMainThread([=]()
+		{
+			finishLoad(texture, generation, level, levels.get());
+		});
+	});
+}
+
+void TextureStreamer::finishLoad(const Texture * texture, unsigned int generation, int level, const LoadedLevels * levels)
+{
+	auto found = _Entries.find(texture);
+	if (found == _Entries.end() || found->second.generation != generation)
+	{
+		return;
+	}
+
+	Entry& entry = found->second;
+	_ReservedBytes -= entry.reservedBytes;
+	entry.reservedBytes = 0;
+	entry.loadingLevel = -1;
+	--_NumLoading;
+
+	if (levels == nullptr)
+	{
+		// Keep what is resident and stop asking for more
+		entry.tailLevel = entry.residentLevel;
+		return;
+	}
+	resize(entry, level, levels);
+}
+
+void TextureStreamer::resize(Entry & entry, int firstLevel, const LoadedLevels * newLevels)
+{
+	int numLevels = entry.numLevels - firstLevel;
+	GLuint handle = 0;
+	glCreateTextures(GL_TEXTURE_2D, 1, &handle);
+	glTextureStorage2D(handle, numLevels, entry.internalFormat, (std::max)(1, entry.width >> firstLevel), (std::max)(1, entry.height >> firstLevel));
+
+	// Levels held by both the old and new storage never leave the GPU
+	GLuint previous = entry.texture->_TexHandle;
+	for (int level = (std::max)(firstLevel, entry.residentLevel); level < entry.numLevels; ++level)
+	{
+		glCopyImageSubData(
+			previous, GL_TEXTURE_2D, level - entry.residentLevel, 0, 0, 0,
+			handle, GL_TEXTURE_2D, level - firstLevel, 0, 0, 0,
+			(std::max)(1, entry.width >> level), (std::max)(1, entry.height >> level), 1);
+	}
+
+	if (newLevels != nullptr)
+	{
+		for (int level = firstLevel; level < entry.residentLevel; ++level)
+		{
+			size_t index = level - firstLevel;
+			const char* pixels = newLevels->data.data() + newLevels->offsets[index];
+			int width = (std::max)(1, entry.width >> level);
+			int height = (std::max)(1, entry.height >> level);
+			if (ImageContainer::isCompressedFormat(entry.internalFormat))
+			{
+				glCompressedTextureSubImage2D(handle, level - firstLevel, 0, 0, width, height, entry.internalFormat, (GLsizei)newLevels->sizes[index], pixels);
+			}
+			else
+			{
+				glTextureSubImage2D(handle, level - firstLevel, 0, 0, width, height, entry.format, entry.type, pixels);
+			}
+		}
+	}
+
+	// Sampling stays on the old top level and eases down to the new one
+	entry.minLod = (std::max)(0.0f, entry.minLod + (float)(entry.residentLevel - firstLevel));
+	entry.texture->adoptStorage(handle, numLevels);
+	glTextureParameterf(handle, GL_TEXTURE_MIN_LOD, entry.minLod);
+
+	size_t bytes = calculateBytes(entry, firstLevel);
+	_ResidentBytes = _ResidentBytes - entry.residentBytes + bytes;
+	entry.residentBytes = bytes;
+	entry.residentLevel = firstLevel;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "GL/glew.h"
+#include <MiniMath/Core.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class Texture;
+class ImageContainer;
+
+/*
+	///// // TextureStreamer // /////
+
+	Keeps only the mip levels that are actually seen in video memory.
+
+	A texture loaded from a cooked .ktx2/.dds starts out with just its tail, the levels no larger
+	than TailSize texels on a side, so the first frame does not wait on the big levels. Each time
+	a GameObject draws, it reports the screen size of its bounds for its textures. update() turns
+	that into the level each texture wants, reads the missing levels on a worker thread and grows
+	the texture on the main thread.
+
+	Storage only ever holds the resident levels, so budgetBytes bounds real video memory.
+	Growing or shrinking reallocates the texture and copies the levels it keeps on the GPU.
+	GL_TEXTURE_MIN_LOD then clamps sampling to the old top level and eases down to the new one
+	over a few frames, so detail fades in instead of popping. When a texture would go over the
+	budget, textures that were not drawn for the longest time shrink back to their tail first.
+*/
+
+class TextureStreamer
+{
+public:
+	// Returns the first level to upload for a freshly loaded container, 0 if it is not streamed
+	static int getTailLevel(const ImageContainer &image);
+	// Starts streaming a texture that was uploaded from firstLevel of the container at path
+	static void add(Texture* texture, const std::string &path, const ImageContainer &image, int firstLevel);
+	// Stops streaming a texture, safe to call for textures that were never added
+	static void remove(Texture* texture);
+
+	// Describes the view that following draws go to
+	static void setView(const mat4 &projection, const vec3 &cameraPosition, int viewportHeight);
+	// Records that texture is drawn on an object with the given world space bounding sphere
+	static void request(const Texture* texture, const vec3 &center, float radius);
+	// Picks new resident levels from last frame's requests and applies finished reads, call once a frame
+	static void update();
+
+	static size_t getResidentBytes();
+	static int getNumTextures();
+
+	static bool enabled;
+	static size_t budgetBytes;
+	// Texels on screen per texel of the texture, above 1 keeps sharper levels than needed
+	static float detailBias;
+	// Largest size of a level that is always resident
+	static int TailSize;
+
+private:
+	struct Entry
+	{
+		Texture* texture = nullptr;
+		std::string path;
+		GLenum internalFormat = GL_NONE;
+		GLenum format = GL_NONE;
+		GLenum type = GL_NONE;
+		int width = 0;
+		int height = 0;
+		int numLevels = 0;
+		int tailLevel = 0;
+		// Largest level in storage
+		int residentLevel = 0;
+		// Largest level being read on a worker, -1 when nothing is in flight
+		int loadingLevel = -1;
+		// Level the last update() asked for
+		int wantedLevel = 0;
+		size_t residentBytes = 0;
+		size_t reservedBytes = 0;
+		// Largest on screen size in pixels requested since the last update
+		float footprint = 0.0f;
+		unsigned int lastUsedFrame = 0;
+		// Current GL_TEXTURE_MIN_LOD, above 0 while new levels fade in
+		float minLod = 0.0f;
+		unsigned int generation = 0;
+	};
+
+	struct LoadedLevels
+	{
+		std::vector<char> data;
+		std::vector<size_t> offsets;
+		std::vector<size_t> sizes;
+	};
+
+	static int getWantedLevel(const Entry &entry);
+	static size_t calculateBytes(const Entry &entry, int firstLevel);
+	// Shrinks other textures until another extra bytes fit in the budget. Returns false, without
+	// shrinking anything, if they cannot be made to fit.
+	static bool makeRoom(size_t extra, const Entry &keep);
+	static void startLoad(Entry &entry, int level);
+	// levels is null if the file could not be read
+	static void finishLoad(const Texture* texture, unsigned int generation, int level, const LoadedLevels* levels);
+	// Reallocates the texture to hold firstLevel and below, newLevels holds the levels it gains
+	static void resize(Entry &entry, int firstLevel, const LoadedLevels* newLevels);
+
+	static std::unordered_map<const Texture*, Entry> _Entries;
+	static size_t _ResidentBytes;
+	static size_t _ReservedBytes;
+	static unsigned int _Frame;
+	static unsigned int _NextGeneration;
+	static int _NumLoading;
+
+	static vec3 _CameraPosition;
+	// Pixels covered by one world unit at a distance of one unit
+	static float _PixelsPerUnit;
+};
@@ -0,0 +1,133 @@
+#include "ThreadPool.h"
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+	if (numThreads == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		numThreads = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < numThreads; ++i)
+	{
+		_Threads.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_Mutex);
+		_IsStopping = true;
+	}
+	_JobAvailable.notify_all();
+	for (std::thread& thread : _Threads)
+	{
+		thread.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(_Mutex);
+		_Jobs.push_back(std::move(job));
+	}
+	_JobAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+	std::unique_lock<std::mutex> lock(_Mutex);
+	_JobsFinished.wait(lock, [this] { return _Jobs.empty() && _ActiveJobs == 0; });
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+	return static_cast<unsigned int>(_Threads.size());
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)>& body, unsigned int grainSize)
+{
+	if (count == 0)
+	{
+		return;
+	}
+	grainSize = grainSize > 0 ? grainSize : 1;
+	unsigned int numChunks = (count + grainSize - 1) / grainSize;
+
+	struct ForState
+	{
+		std::atomic<unsigned int> nextChunk{ 0 };
+		std::atomic<unsigned int> chunksDone{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared<ForState>();
+
+	// Helpers that start after every chunk has been claimed return without touching body
+	auto runChunks = [state, &body, count, grainSize, numChunks]()
+	{
+		for (;;)
+		{
+			unsigned int chunk = state->nextChunk++;
+			if (chunk >= numChunks)
+			{
+				return;
+			}
+			unsigned int begin = chunk * grainSize;
+			unsigned int end = begin + grainSize < count ? begin + grainSize : count;
+			body(begin, end);
+
+			if (++state->chunksDone == numChunks)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	unsigned int numHelpers = numChunks - 1 < getNumThreads() ? numChunks - 1 : getNumThreads();
+	for (unsigned int i = 0; i < numHelpers; ++i)
+	{
+		submit(runChunks);
+	}
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state, numChunks] { return state->chunksDone == numChunks; });
+}
+
+ThreadPool & ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::workerLoop()
+{
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(_Mutex);
+			_JobAvailable.wait(lock, [this] { return _IsStopping || !_Jobs.empty(); });
+			if (_IsStopping && _Jobs.empty())
+			{
+				return;
+			}
+			job = std::move(_Jobs.front());
+			_Jobs.pop_front();
+			++_ActiveJobs;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(_Mutex);
+			--_ActiveJobs;
+		}
+		_JobsFinished.notify_all();
+	}
+}
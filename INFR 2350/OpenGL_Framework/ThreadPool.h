@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+/*
+  ////////////////
+ // ThreadPool //
+////////////////
+
+A fixed set of worker threads pulling jobs off a shared queue. Jobs must not
+touch OpenGL, the context is only current on the main thread. Anything that
+needs the GPU should hand its results back to the main thread (see AssetLoader).
+*/
+
+class ThreadPool
+{
+public:
+	// 0 threads uses one less than the number of hardware threads, leaving the main thread its own core
+	explicit ThreadPool(unsigned int numThreads = 0);
+	~ThreadPool();
+
+	void submit(std::function<void()> job);
+	// Blocks until the queue is empty and every job has finished. Do not call from a job.
+	void wait();
+	unsigned int getNumThreads() const;
+
+	// Runs body over [0, count) split into chunks of grainSize, blocking until every chunk is done.
+	// The calling thread works through chunks as well, so this is safe to call from inside a job.
+	void parallelFor(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)> &body, unsigned int grainSize = 1);
+
+	// Pool shared by the engine's subsystems
+	static ThreadPool& shared();
+
+private:
+	void workerLoop();
+
+	std::vector<std::thread> _Threads;
+	std::deque<std::function<void()>> _Jobs;
+	std::mutex _Mutex;
+	std::condition_variable _JobAvailable;
+	std::condition_variable _JobsFinished;
+	unsigned int _ActiveJobs = 0;
+	bool _IsStopping = false;
+};
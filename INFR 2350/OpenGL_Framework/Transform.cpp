@@ -112,6 +112,11 @@ Transform * Transform::getParent()
 	return m_pParent;
 }
 
+void Transform::storePreviousTransform()
+{
+	m_pPreviousLocalToWorld = m_pLocalToWorld;
+}
+
 void Transform::update(float dt)
 {
 	// Create 4x4 transformation matrix
@@ -153,3 +158,38 @@ void Transform::draw()
 {
 	SAT_DEBUG_LOG("DRAWING TRANSFORM INSTEAD OF GAMEOBJECT");
 }
+
+bool Transform::drawDepth(const ShaderProgram & program)
+{
+	return false;
+}
+
+void Transform::drawIndirect(size_t command)
+{
+	draw();
+}
+
+bool Transform::drawDepthIndirect(const ShaderProgram & program, size_t command)
+{
+	return drawDepth(program);
+}
+
+bool Transform::getWorldBounds(vec3 & boundsMin, vec3 & boundsMax)
+{
+	return false;
+}
+
+unsigned int Transform::getNumVertices()
+{
+	return 0;
+}
+
+const Mesh* Transform::getOccluderMesh()
+{
+	return nullptr;
+}
+
+RenderState Transform::getRenderState()
+{
+	return RenderState();
+}
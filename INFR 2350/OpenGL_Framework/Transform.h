@@ -3,6 +3,11 @@
 #include <MiniMath/Core.h>
 #include <vector>
 #include <string>
+#include <cstddef>
+#include "RenderQueue.h"
+
+class ShaderProgram;
+class Mesh;
 
 class Transform
 {
@@ -15,6 +20,8 @@ public:
 	
 	mat4 m_pLocalTransform;
 	mat4 m_pLocalToWorld;
+	// World matrix as of the previous frame, for motion vectors
+	mat4 m_pPreviousLocalToWorld;
 
 	Transform* m_pParent;
 	std::vector<Transform*> m_pChildren;
@@ -43,8 +50,23 @@ public:
 	std::vector<Transform*> getChildren();
 	Transform* getParent();
 
+	// Keeps the current world matrix as the previous frame's, call once a frame before update()
+	void storePreviousTransform();
 	virtual void update(float dt);	
 	virtual void draw();
+	// Draws only depth with program, already bound, for the depth pre-pass. False if nothing was drawn.
+	virtual bool drawDepth(const ShaderProgram &program);
+	// The same, with the vertex and instance counts taken from the command at an offset into the
+	// bound GL_DRAW_INDIRECT_BUFFER, see HiZCuller
+	virtual void drawIndirect(size_t command);
+	virtual bool drawDepthIndirect(const ShaderProgram &program, size_t command);
+	// World space bounding box of what draw() draws, false if there is none to cull with
+	virtual bool getWorldBounds(vec3 &boundsMin, vec3 &boundsMax);
+	virtual unsigned int getNumVertices();
+	// Mesh drawn in its place into the DepthRasterizer, null if it hides nothing
+	virtual const Mesh* getOccluderMesh();
+	// Where draw() goes in the camera's RenderQueue
+	virtual RenderState getRenderState();
 
 protected:
 	// Other Properties
@@ -0,0 +1,191 @@
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+namespace
+{
+	const float FilterWidth = 3.0f;
+	const float KaiserAlpha = 4.0f;
+	const float Pi = 3.14159265358979f;
+
+	// Zeroth order modified Bessel function of the first kind
+	float besselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		float halfX = x * 0.5f;
+		for (int k = 1; k < 32; ++k)
+		{
+			float factor = halfX / k;
+			term *= factor * factor;
+			sum += term;
+			if (term < sum * 1e-8f)
+			{
+				break;
+			}
+		}
+		return sum;
+	}
+
+	float srgbToLinear(float value)
+	{
+		return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linearToSRGB(float value)
+	{
+		return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+	}
+}
+
+void MipGenerator::generate(const unsigned char * pixels, int width, int height, bool sRGB, bool wrap, std::vector<MipLevel>& levels)
+{
+	levels.clear();
+	levels.emplace_back();
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(pixels, pixels + (size_t)width * height * 4);
+
+	float toLinear[256];
+	for (int i = 0; i < 256; ++i)
+	{
+		toLinear[i] = sRGB ? srgbToLinear(i / 255.0f) : i / 255.0f;
+	}
+
+	// Each level is filtered from the float version of the one above so rounding does not accumulate
+	std::vector<float> current((size_t)width * height * 4);
+	for (size_t i = 0; i < current.size(); ++i)
+	{
+		current[i] = (i % 4 == 3) ? pixels[i] / 255.0f : toLinear[pixels[i]];
+	}
+
+	std::vector<float> next;
+	while (width > 1 || height > 1)
+	{
+		downsample(current, width, height, wrap, next, width, height);
+		current.swap(next);
+
+		MipLevel level;
+		level.width = width;
+		level.height = height;
+		level.pixels.resize(current.size());
+		for (size_t i = 0; i < current.size(); ++i)
+		{
+			float value = current[i] < 0.0f ? 0.0f : (current[i] > 1.0f ? 1.0f : current[i]);
+			if (sRGB && i % 4 != 3)
+			{
+				value = linearToSRGB(value);
+			}
+			level.pixels[i] = (unsigned char)(value * 255.0f + 0.5f);
+		}
+		levels.push_back(std::move(level));
+	}
+}
+
+void MipGenerator::buildTaps(int sourceSize, int destSize, bool wrap, std::vector<std::vector<Tap>>& taps)
+{
+	float scale = (float)sourceSize / destSize;
+	float radius = FilterWidth * scale;
+
+	taps.assign(destSize, std::vector<Tap>());
+	for (int x = 0; x < destSize; ++x)
+	{
+		float center = (x + 0.5f) * scale;
+		int first = (int)floorf(center - radius);
+		int last = (int)ceilf(center + radius);
+
+		float total = 0.0f;
+		for (int i = first; i <= last; ++i)
+		{
+			float weight = kaiserSinc((i + 0.5f - center) / scale);
+			if (weight == 0.0f)
+			{
+				continue;
+			}
+
+			int index = i;
+			if (wrap)
+			{
+				index = ((i % sourceSize) + sourceSize) % sourceSize;
+			}
+			else
+			{
+				index = i < 0 ? 0 : (i >= sourceSize ? sourceSize - 1 : i);
+			}
+			taps[x].push_back({ index, weight });
+			total += weight;
+		}
+
+		for (Tap& tap : taps[x])
+		{
+			tap.weight /= total;
+		}
+	}
+}
+
+void MipGenerator::downsample(const std::vector<float>& source, int width, int height, bool wrap, std::vector<float>& result, int & newWidth, int & newHeight)
+{
+	newWidth = width > 1 ? width / 2 : 1;
+	newHeight = height > 1 ? height / 2 : 1;
+
+	std::vector<std::vector<Tap>> tapsX, tapsY;
+	buildTaps(width, newWidth, wrap, tapsX);
+	buildTaps(height, newHeight, wrap, tapsY);
+
+	// Horizontal pass into a newWidth by height buffer, then vertical into the result
+	std::vector<float> horizontal((size_t)newWidth * height * 4);
+	int destWidth = newWidth;
+	ThreadPool::shared().parallelFor(height, [&](unsigned int begin, unsigned int end)
+	{
+		for (int y = (int)begin; y < (int)end; ++y)
+		{
+			const float* row = source.data() + (size_t)y * width * 4;
+			float* output = horizontal.data() + (size_t)y * destWidth * 4;
+			for (int x = 0; x < destWidth; ++x)
+			{
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (const Tap& tap : tapsX[x])
+				{
+					for (int c = 0; c < 4; ++c)
+					{
+						sum[c] += row[tap.index * 4 + c] * tap.weight;
+					}
+				}
+				for (int c = 0; c < 4; ++c)
+				{
+					output[x * 4 + c] = sum[c];
+				}
+			}
+		}
+	}, 8);
+
+	result.assign((size_t)newWidth * newHeight * 4, 0.0f);
+	ThreadPool::shared().parallelFor(newHeight, [&](unsigned int begin, unsigned int end)
+	{
+		for (int y = (int)begin; y < (int)end; ++y)
+		{
+			float* output = result.data() + (size_t)y * destWidth * 4;
+			for (const Tap& tap : tapsY[y])
+			{
+				const float* row = horizontal.data() + (size_t)tap.index * destWidth * 4;
+				for (int i = 0; i < destWidth * 4; ++i)
+				{
+					output[i] += row[i] * tap.weight;
+				}
+			}
+		}
+	}, 8);
+}
+
+float MipGenerator::kaiserSinc(float x)
+{
+	float t = fabsf(x) / FilterWidth;
+	if (t >= 1.0f)
+	{
+		return 0.0f;
+	}
+
+	float sinc = x == 0.0f ? 1.0f : sinf(Pi * x) / (Pi * x);
+	float window = besselI0(KaiserAlpha * sqrtf(1.0f - t * t)) / besselI0(KaiserAlpha);
+	return sinc * window;
+}
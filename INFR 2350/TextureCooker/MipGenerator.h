@@ -0,0 +1,40 @@
+#pragma once
+#include <vector>
+
+/*
+	///// // MipGenerator // /////
+
+	Builds a mip chain from an RGBA8 image for the texture cooker.
+
+	Every level is resampled from the one above it in linear floating point with a
+	Kaiser windowed sinc (width 3, alpha 4), which keeps detail that a box filter blurs away.
+	Colour channels are converted out of sRGB before filtering and back afterwards, so
+	distant mips do not darken. Alpha and linear data (normals, masks) are filtered as is.
+*/
+
+struct MipLevel
+{
+	int width = 0;
+	int height = 0;
+	std::vector<unsigned char> pixels; // RGBA8
+};
+
+class MipGenerator
+{
+public:
+	// Fills levels with level 0 and every level below it down to 1x1.
+	// wrap samples across the edges as if the texture repeats, otherwise edges are clamped.
+	static void generate(const unsigned char* pixels, int width, int height, bool sRGB, bool wrap, std::vector<MipLevel> &levels);
+
+private:
+	struct Tap
+	{
+		int index;
+		float weight;
+	};
+
+	// Weights for resampling one axis from sourceSize to destSize texels, indexed by destination texel
+	static void buildTaps(int sourceSize, int destSize, bool wrap, std::vector<std::vector<Tap>> &taps);
+	static void downsample(const std::vector<float> &source, int width, int height, bool wrap, std::vector<float> &result, int &newWidth, int &newHeight);
+	static float kaiserSinc(float x);
+};
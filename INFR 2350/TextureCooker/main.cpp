@@ -0,0 +1,296 @@
+#pragma comment(lib, "SOIL_ext.lib")
+
+#include "ImageContainer.h"
+#include "BlockCompressor.h"
+#include "MipGenerator.h"
+#include "IO.h"
+#include "SOIL/SOIL.h"
+#include <fstream>
+#include <sstream>
+#include <cstring>
+
+/*
+	///// // TextureCooker // /////
+
+	Turns source images into .ktx2 files with a complete, pre-filtered mip chain so the game
+	never decodes images or builds mips at load time. Texture::load picks up a .ktx2 sitting
+	next to the image it was asked for.
+
+	TextureCooker [options] <image> [output.ktx2]
+	TextureCooker [options] --cube <+x> <-x> <+y> <-y> <+z> <-z> [output.ktx2]
+	TextureCooker --list <cook.txt> [--force]
+
+	Options:
+		--format rgba8|bc1|bc3|bc4|bc5|bc7	Defaults to bc1, or bc3 when the image has alpha
+		--linear							The image is data (normals, masks) rather than sRGB colour
+		--wrap								Filter across edges as if the texture repeats
+		--no-mips							Only store level 0
+
+	The output defaults to the first image with its extension replaced by .ktx2.
+	A list file holds one command line per texture, with paths relative to the list. Entries are
+	skipped when their output is newer than every input, unless --force is given.
+*/
+
+struct CookOptions
+{
+	std::string format;
+	bool linear = false;
+	bool wrap = false;
+	bool mipmap = true;
+	bool cube = false;
+	std::vector<std::string> inputs;
+	std::string output;
+};
+
+static bool parseFormat(const std::string &name, GLenum &format)
+{
+	struct FormatName
+	{
+		const char* name;
+		GLenum format;
+	};
+	const FormatName formats[] =
+	{
+		{ "rgba8", GL_RGBA8 },
+		{ "bc1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT },
+		{ "bc3", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT },
+		{ "bc4", GL_COMPRESSED_RED_RGTC1 },
+		{ "bc5", GL_COMPRESSED_RG_RGTC2 },
+		{ "bc7", GL_COMPRESSED_RGBA_BPTC_UNORM },
+	};
+
+	for (const FormatName& entry : formats)
+	{
+		if (name == entry.name)
+		{
+			format = entry.format;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool parseOptions(const std::vector<std::string> &args, const std::string &baseDirectory, CookOptions &options)
+{
+	int numFaces = 1;
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		const std::string& arg = args[i];
+		if (arg == "--format" && i + 1 < args.size())
+		{
+			options.format = args[++i];
+		}
+		else if (arg == "--linear")
+		{
+			options.linear = true;
+		}
+		else if (arg == "--wrap")
+		{
+			options.wrap = true;
+		}
+		else if (arg == "--no-mips")
+		{
+			options.mipmap = false;
+		}
+		else if (arg == "--cube")
+		{
+			options.cube = true;
+			numFaces = 6;
+		}
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			SAT_LOG_ERROR("Unknown option %s", arg.c_str());
+			return false;
+		}
+		else if ((int)options.inputs.size() < numFaces)
+		{
+			options.inputs.push_back(baseDirectory + arg);
+		}
+		else
+		{
+			options.output = baseDirectory + arg;
+		}
+	}
+
+	if ((int)options.inputs.size() != numFaces)
+	{
+		SAT_LOG_ERROR("Expected %d input image(s)", numFaces);
+		return false;
+	}
+	if (options.output.empty())
+	{
+		options.output = options.inputs[0].substr(0, options.inputs[0].find_last_of('.')) + ".ktx2";
+	}
+	return true;
+}
+
+static bool isUpToDate(const CookOptions &options)
+{
+	unsigned long long outputTime = getFileWriteTime(options.output);
+	if (outputTime == 0)
+	{
+		return false;
+	}
+	for (const std::string& input : options.inputs)
+	{
+		if (getFileWriteTime(input) > outputTime)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool cook(const CookOptions &options)
+{
+	int numFaces = (int)options.inputs.size();
+	std::vector<std::vector<MipLevel>> faces(numFaces);
+	int width = 0, height = 0;
+	bool alpha = false;
+
+	for (int face = 0; face < numFaces; ++face)
+	{
+		int faceWidth = 0, faceHeight = 0, numChannels = 0;
+		unsigned char* pixels = SOIL_load_image(options.inputs[face].c_str(), &faceWidth, &faceHeight, &numChannels, SOIL_LOAD_RGBA);
+		if (pixels == nullptr || faceWidth == 0 || faceHeight == 0)
+		{
+			SAT_LOG_ERROR("Could not read %s", options.inputs[face].c_str());
+			SOIL_free_image_data(pixels);
+			return false;
+		}
+		if (face > 0 && (faceWidth != width || faceHeight != height))
+		{
+			SAT_LOG_ERROR("%s does not match the size of the other faces", options.inputs[face].c_str());
+			SOIL_free_image_data(pixels);
+			return false;
+		}
+		width = faceWidth;
+		height = faceHeight;
+
+		// Cube faces are stored upside down, as TextureCube does when loading images
+		if (options.cube)
+		{
+			std::vector<unsigned char> row((size_t)width * 4);
+			for (int y = 0; y < height / 2; ++y)
+			{
+				unsigned char* top = pixels + (size_t)y * width * 4;
+				unsigned char* bottom = pixels + (size_t)(height - y - 1) * width * 4;
+				memcpy(row.data(), top, row.size());
+				memcpy(top, bottom, row.size());
+				memcpy(bottom, row.data(), row.size());
+			}
+		}
+
+		alpha = alpha || BlockCompressor::hasAlpha(pixels, width, height);
+		if (options.mipmap)
+		{
+			MipGenerator::generate(pixels, width, height, !options.linear, options.wrap, faces[face]);
+		}
+		else
+		{
+			faces[face].resize(1);
+			faces[face][0].width = width;
+			faces[face][0].height = height;
+			faces[face][0].pixels.assign(pixels, pixels + (size_t)width * height * 4);
+		}
+		SOIL_free_image_data(pixels);
+	}
+
+	GLenum format = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	if (!options.format.empty() && !parseFormat(options.format, format))
+	{
+		SAT_LOG_ERROR("Unknown format %s", options.format.c_str());
+		return false;
+	}
+
+	int numLevels = (int)faces[0].size();
+	ImageContainer image;
+	image.create(format, width, height, numLevels, numFaces);
+	for (int level = 0; level < numLevels; ++level)
+	{
+		for (int face = 0; face < numFaces; ++face)
+		{
+			const MipLevel& source = faces[face][level];
+			unsigned char* output = reinterpret_cast<unsigned char*>(image.getLevelData(level, face));
+			if (image.isCompressed())
+			{
+				BlockCompressor::compressLevel(source.pixels.data(), source.width, source.height, format, output);
+			}
+			else
+			{
+				memcpy(output, source.pixels.data(), source.pixels.size());
+			}
+		}
+	}
+
+	if (!image.save(options.output))
+	{
+		SAT_LOG_ERROR("Could not write %s", options.output.c_str());
+		return false;
+	}
+	printf("Cooked %s (%dx%d, %d levels)\n", options.output.c_str(), width, height, numLevels);
+	return true;
+}
+
+static bool cookList(const std::string &listFile, bool force)
+{
+	std::ifstream list(listFile);
+	if (!list.good())
+	{
+		SAT_LOG_ERROR("Could not open %s", listFile.c_str());
+		return false;
+	}
+
+	size_t slash = listFile.find_last_of("/\\");
+	std::string baseDirectory = slash == std::string::npos ? "" : listFile.substr(0, slash + 1);
+
+	bool success = true;
+	std::string line;
+	while (std::getline(list, line))
+	{
+		std::istringstream tokens(line);
+		std::vector<std::string> args;
+		for (std::string token; tokens >> token;)
+		{
+			args.push_back(token);
+		}
+		if (args.empty() || args[0][0] == '#')
+		{
+			continue;
+		}
+
+		CookOptions options;
+		if (!parseOptions(args, baseDirectory, options))
+		{
+			success = false;
+			continue;
+		}
+		if (!force && isUpToDate(options))
+		{
+			continue;
+		}
+		success = cook(options) && success;
+	}
+	return success;
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+
+	if (args.size() >= 2 && args[0] == "--list")
+	{
+		bool force = args.size() >= 3 && args[2] == "--force";
+		return cookList(args[1], force) ? 0 : 1;
+	}
+
+	CookOptions options;
+	if (args.empty() || !parseOptions(args, "", options))
+	{
+		printf("Usage: TextureCooker [--format rgba8|bc1|bc3|bc4|bc5|bc7] [--linear] [--wrap] [--no-mips] <image> [output.ktx2]\n");
+		printf("       TextureCooker [options] --cube <+x> <-x> <+y> <-y> <+z> <-z> [output.ktx2]\n");
+		printf("       TextureCooker --list <cook.txt> [--force]\n");
+		return 1;
+	}
+	return cook(options) ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+@echo off
+rem Offline-compiles the GLSL shaders into OpenGL SPIR-V modules (GL_ARB_gl_spirv).
+rem ShaderProgram loads spirv\<shader>.spv when the driver supports it, and
+rem falls back to the GLSL source when the extension or the module is missing,
+rem or the driver rejects the module.
+rem Requires glslangValidator from the Vulkan SDK on the PATH.
+
+cd /d "%~dp0"
+if not exist spirv mkdir spirv
+
+rem Stages are compiled on their own, so each numbers its plain uniforms from its own base.
+rem Two uniforms sharing a location fail to link, vertex stages start at 0 and fragment stages at 64.
+for %%f in (*.vert) do (
+	glslangValidator -G --auto-map-locations --uniform-base 0 -o "spirv\%%f.spv" "%%f" || echo Skipping %%f, it will be loaded from source
+)
+for %%f in (*.frag) do (
+	glslangValidator -G --auto-map-locations --uniform-base 64 -o "spirv\%%f.spv" "%%f" || echo Skipping %%f, it will be loaded from source
+)
@@ -0,0 +1,7 @@
+#version 420
+
+// Depth pre-pass, depth is all that is written
+
+void main()
+{
+}
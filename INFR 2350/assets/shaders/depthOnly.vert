@@ -0,0 +1,23 @@
+#version 420
+
+// Depth pre-pass, see Camera::renderDepth. Positions only.
+
+layout(std140, binding = 0) uniform Camera
+{
+	uniform mat4 uProj;
+	uniform mat4 uView;
+};
+
+layout(location = 0) in vec3 in_vert;
+
+uniform mat4 uModel;
+
+// The color pass tests against this depth with GL_EQUAL, so both must compute it the same way
+invariant gl_Position;
+
+void main()
+{
+	vec3 pos = (uView * uModel * vec4(in_vert, 1.0f)).xyz;
+
+	gl_Position = uProj * vec4(pos, 1.0f);
+}
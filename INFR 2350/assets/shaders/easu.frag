@@ -0,0 +1,146 @@
+#version 420
+
+// Edge adaptive spatial upsampling, after AMD FidelityFX Super Resolution 1.0 (EASU).
+// Upscales the rendered part of the scene target to the whole output with a 12 tap lanczos
+// like filter that is stretched along edges, then clamped to the nearest 2x2 texels to avoid ringing.
+
+layout(std140, binding = 11) uniform Resolution
+{
+	// Part of the scene target that was rendered to, see DynamicResolution
+	uniform vec2 uViewportScale;
+	uniform vec2 uViewportClamp;
+};
+
+layout(binding = 0) uniform sampler2D uTexScene;
+
+in vec2 texcoord;
+
+out vec4 outColor;
+
+ivec2 viewportMax;
+
+vec3 fetch(ivec2 position)
+{
+	return texelFetch(uTexScene, clamp(position, ivec2(0), viewportMax), 0).rgb;
+}
+
+// Twice the luma, good enough to find edges with
+float luma(vec3 color)
+{
+	return color.b * 0.5 + (color.r * 0.5 + color.g);
+}
+
+// Accumulates the gradient direction and edge length around one of the 4 centre texels (C),
+// from its neighbours above (A), left (B), right (D) and below (E), weighted bilinearly by w
+void accumulateEdge(inout vec2 direction, inout float len, float w, float lA, float lB, float lC, float lD, float lE)
+{
+	float dc = lD - lC;
+	float cb = lC - lB;
+	float lenX = max(abs(dc), abs(cb));
+	lenX = lenX > 0.0f ? 1.0f / lenX : 0.0f;
+	float dirX = lD - lB;
+	direction.x += dirX * w;
+	lenX = clamp(abs(dirX) * lenX, 0.0f, 1.0f);
+	len += lenX * lenX * w;
+
+	float ec = lE - lC;
+	float ca = lC - lA;
+	float lenY = max(abs(ec), abs(ca));
+	lenY = lenY > 0.0f ? 1.0f / lenY : 0.0f;
+	float dirY = lE - lA;
+	direction.y += dirY * w;
+	lenY = clamp(abs(dirY) * lenY, 0.0f, 1.0f);
+	len += lenY * lenY * w;
+}
+
+// Adds one tap of the filter, offset is from the sample point in input texels
+void accumulateTap(inout vec3 colorSum, inout float weightSum, vec2 offset, vec2 direction, vec2 len, float lobe, float clip, vec3 color)
+{
+	// Rotate into the edge's frame and squash across it
+	vec2 v = vec2(dot(offset, direction), dot(offset, vec2(-direction.y, direction.x))) * len;
+	float d2 = min(dot(v, v), clip);
+
+	// Polynomial approximation of lanczos2, [25/16 * (2/5 * x^2 - 1)^2 - (25/16 - 1)] * (lobe * x^2 - 1)^2
+	float wB = 2.0f / 5.0f * d2 - 1.0f;
+	float wA = lobe * d2 - 1.0f;
+	wB *= wB;
+	wA *= wA;
+	wB = 25.0f / 16.0f * wB - (25.0f / 16.0f - 1.0f);
+	float w = wB * wA;
+
+	colorSum += color * w;
+	weightSum += w;
+}
+
+void main()
+{
+	vec2 inputSize = vec2(textureSize(uTexScene, 0)) * uViewportScale;
+	viewportMax = ivec2(inputSize) - 1;
+
+	// Position in input texels relative to the texel f below
+	vec2 pp = texcoord * inputSize - 0.5f;
+	vec2 fp = floor(pp);
+	pp -= fp;
+	ivec2 origin = ivec2(fp);
+
+	//    b c
+	//  e f g h
+	//  i j k l
+	//    n o
+	vec3 b = fetch(origin + ivec2( 0, -1));
+	vec3 c = fetch(origin + ivec2( 1, -1));
+	vec3 e = fetch(origin + ivec2(-1,  0));
+	vec3 f = fetch(origin + ivec2( 0,  0));
+	vec3 g = fetch(origin + ivec2( 1,  0));
+	vec3 h = fetch(origin + ivec2( 2,  0));
+	vec3 i = fetch(origin + ivec2(-1,  1));
+	vec3 j = fetch(origin + ivec2( 0,  1));
+	vec3 k = fetch(origin + ivec2( 1,  1));
+	vec3 l = fetch(origin + ivec2( 2,  1));
+	vec3 n = fetch(origin + ivec2( 0,  2));
+	vec3 o = fetch(origin + ivec2( 1,  2));
+
+	float bL = luma(b), cL = luma(c), eL = luma(e), fL = luma(f), gL = luma(g), hL = luma(h);
+	float iL = luma(i), jL = luma(j), kL = luma(k), lL = luma(l), nL = luma(n), oL = luma(o);
+
+	vec2 direction = vec2(0.0f);
+	float len = 0.0f;
+	accumulateEdge(direction, len, (1.0f - pp.x) * (1.0f - pp.y), bL, eL, fL, gL, jL);
+	accumulateEdge(direction, len, pp.x * (1.0f - pp.y), cL, fL, gL, hL, kL);
+	accumulateEdge(direction, len, (1.0f - pp.x) * pp.y, fL, iL, jL, kL, nL);
+	accumulateEdge(direction, len, pp.x * pp.y, gL, jL, kL, lL, oL);
+
+	// Flat areas get an arbitrary direction, the filter is round there anyway
+	float directionLength = dot(direction, direction);
+	direction = directionLength < 1.0f / 32768.0f ? vec2(1.0f, 0.0f) : direction * inversesqrt(directionLength);
+
+	// len is 0 in flat areas and 1 along strong edges
+	len *= 0.5f;
+	len *= len;
+	// Stretch the kernel along the edge, more when the edge is diagonal
+	float stretch = dot(direction, direction) / max(abs(direction.x), abs(direction.y));
+	vec2 len2 = vec2(1.0f + (stretch - 1.0f) * len, 1.0f - 0.5f * len);
+	// Sharper negative lobe on edges
+	float lobe = 0.5f + ((1.0f / 4.0f - 0.04f) - 0.5f) * len;
+	float clip = 1.0f / lobe;
+
+	vec3 colorSum = vec3(0.0f);
+	float weightSum = 0.0f;
+	accumulateTap(colorSum, weightSum, vec2( 0.0f, -1.0f) - pp, direction, len2, lobe, clip, b);
+	accumulateTap(colorSum, weightSum, vec2( 1.0f, -1.0f) - pp, direction, len2, lobe, clip, c);
+	accumulateTap(colorSum, weightSum, vec2(-1.0f,  1.0f) - pp, direction, len2, lobe, clip, i);
+	accumulateTap(colorSum, weightSum, vec2( 0.0f,  1.0f) - pp, direction, len2, lobe, clip, j);
+	accumulateTap(colorSum, weightSum, vec2( 0.0f,  0.0f) - pp, direction, len2, lobe, clip, f);
+	accumulateTap(colorSum, weightSum, vec2(-1.0f,  0.0f) - pp, direction, len2, lobe, clip, e);
+	accumulateTap(colorSum, weightSum, vec2( 1.0f,  1.0f) - pp, direction, len2, lobe, clip, k);
+	accumulateTap(colorSum, weightSum, vec2( 2.0f,  1.0f) - pp, direction, len2, lobe, clip, l);
+	accumulateTap(colorSum, weightSum, vec2( 2.0f,  0.0f) - pp, direction, len2, lobe, clip, h);
+	accumulateTap(colorSum, weightSum, vec2( 1.0f,  0.0f) - pp, direction, len2, lobe, clip, g);
+	accumulateTap(colorSum, weightSum, vec2( 1.0f,  2.0f) - pp, direction, len2, lobe, clip, o);
+	accumulateTap(colorSum, weightSum, vec2( 0.0f,  2.0f) - pp, direction, len2, lobe, clip, n);
+
+	// Clamp to the 2x2 around the sample point so the negative lobes can not ring
+	vec3 minColor = min(min(f, g), min(j, k));
+	vec3 maxColor = max(max(f, g), max(j, k));
+	outColor = vec4(clamp(colorSum / weightSum, minColor, maxColor), 1.0f);
+}
@@ -0,0 +1,37 @@
+#version 420
+
+// Resamples an equirectangular panorama into one face of a cube map
+
+layout(binding = 0) uniform sampler2D uTexEquirect;
+
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + uFace
+uniform int uFace;
+
+in vec2 texcoord;
+
+out vec4 outColor;
+
+const float PI = 3.14159265359;
+
+void main()
+{
+	// Direction through this texel, following the face orientations of the OpenGL spec
+	vec2 uv = texcoord * 2.0 - 1.0;
+	vec3 direction;
+	switch (uFace)
+	{
+	case 0: direction = vec3( 1.0, -uv.y, -uv.x); break;
+	case 1: direction = vec3(-1.0, -uv.y,  uv.x); break;
+	case 2: direction = vec3( uv.x,  1.0,  uv.y); break;
+	case 3: direction = vec3( uv.x, -1.0, -uv.y); break;
+	case 4: direction = vec3( uv.x, -uv.y,  1.0); break;
+	default: direction = vec3(-uv.x, -uv.y, -1.0); break;
+	}
+	direction = normalize(direction);
+
+	// Longitude across, latitude down from the top row of the panorama
+	vec2 equirect = vec2(
+		atan(direction.z, direction.x) / (2.0 * PI) + 0.5,
+		acos(clamp(direction.y, -1.0, 1.0)) / PI);
+	outColor = vec4(textureLod(uTexEquirect, equirect, 0.0).rgb, 1.0);
+}
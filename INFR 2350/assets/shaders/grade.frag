@@ -0,0 +1,34 @@
+#version 420
+
+// Colour grades the scene with a 3D lookup table, see Texture::loadLUT
+
+layout(std140, binding = 10) uniform Grade
+{
+	uniform float uGradeAmount;
+};
+
+layout(std140, binding = 11) uniform Resolution
+{
+	// Part of the scene target that was rendered to, see DynamicResolution
+	uniform vec2 uViewportScale;
+	// Centre of the last rendered texel, keeps filtering from reading past the rendered part
+	uniform vec2 uViewportClamp;
+};
+
+layout(binding = 0) uniform sampler2D uTexScene;
+layout(binding = 30) uniform sampler3D uTexLUT;
+
+in vec2 texcoord;
+
+out vec4 outColor;
+
+void main()
+{
+	vec3 color = clamp(texture(uTexScene, min(texcoord * uViewportScale, uViewportClamp)).rgb, 0.0f, 1.0f);
+
+	// The table's entries sit on texel centres, so 0 and 1 map to the first and last texel
+	float size = float(textureSize(uTexLUT, 0).x);
+	vec3 graded = texture(uTexLUT, color * ((size - 1.0f) / size) + 0.5f / size).rgb;
+
+	outColor = vec4(mix(color, graded, uGradeAmount), 1.0f);
+}
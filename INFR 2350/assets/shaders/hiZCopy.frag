@@ -0,0 +1,31 @@
+#version 450
+
+// Level 0 of the Hi-Z pyramid, see HiZCuller.
+// Picks the sampler type, so it can only be set as a #define.
+#ifndef MULTISAMPLED
+#define MULTISAMPLED 0
+#endif
+
+#if MULTISAMPLED
+layout(binding = 0) uniform sampler2DMS uTexDepth;
+#else
+layout(binding = 0) uniform sampler2D uTexDepth;
+#endif
+
+layout(location = 0) out float outDepth;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+#if MULTISAMPLED
+	// The farthest sample, so edges never hide more than they cover
+	float depth = 0.0f;
+	for (int i = 0; i < textureSamples(uTexDepth); ++i)
+	{
+		depth = max(depth, texelFetch(uTexDepth, texel, i).r);
+	}
+	outDepth = depth;
+#else
+	outDepth = texelFetch(uTexDepth, texel, 0).r;
+#endif
+}
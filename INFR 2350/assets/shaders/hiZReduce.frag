@@ -0,0 +1,22 @@
+#version 420
+
+// One level of the Hi-Z pyramid from the level below, see HiZCuller.
+// Keeps the farthest depth of the 2x2 texels under each texel.
+
+// The level below is the texture's only level while this one is rendered
+layout(binding = 0) uniform sampler2D uTexHiZ;
+uniform vec2 uSourceSize;
+
+layout(location = 0) out float outDepth;
+
+void main()
+{
+	// Sizes round up, so the last row or column may only have one texel under it
+	ivec2 last = ivec2(uSourceSize) - 1;
+	ivec2 source = ivec2(gl_FragCoord.xy) * 2;
+	float depth = texelFetch(uTexHiZ, source, 0).r;
+	depth = max(depth, texelFetch(uTexHiZ, min(source + ivec2(1, 0), last), 0).r);
+	depth = max(depth, texelFetch(uTexHiZ, min(source + ivec2(0, 1), last), 0).r);
+	depth = max(depth, texelFetch(uTexHiZ, min(source + ivec2(1, 1), last), 0).r);
+	outDepth = depth;
+}
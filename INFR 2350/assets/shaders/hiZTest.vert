@@ -0,0 +1,102 @@
+#version 430
+
+// Occlusion test of one object against the Hi-Z pyramid per vertex, see HiZCuller.
+// Drawn as points with the rasterizer off, the results go straight to the indirect draw commands.
+
+// Minimum and maximum corner of each object's world space bounding box
+layout(std430, binding = 0) readonly buffer ObjectBounds
+{
+	vec4 bounds[];
+};
+
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint first;
+	uint baseInstance;
+};
+
+// First and second phase command of each object
+layout(std430, binding = 1) buffer DrawCommands
+{
+	DrawCommand commands[];
+};
+
+layout(binding = 0) uniform sampler2D uTexHiZ;
+
+// What the pyramid's depth was drawn with
+uniform mat4 uViewProjection;
+uniform int uPhase;
+uniform int uHiZValid;
+// Size of level 0 in texels
+uniform vec2 uHiZSize;
+uniform int uNumLevels;
+
+bool isVisible(vec3 boundsMin, vec3 boundsMax)
+{
+	if (uHiZValid == 0)
+	{
+		return true;
+	}
+
+	vec3 ndcMin = vec3(1.0e9f);
+	vec3 ndcMax = vec3(-1.0e9f);
+	for (int i = 0; i < 8; ++i)
+	{
+		vec3 corner = mix(boundsMin, boundsMax, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+		vec4 clip = uViewProjection * vec4(corner, 1.0f);
+		// Crossing the near plane, the box covers too much of the screen to be worth testing
+		if (clip.w <= 0.0f)
+		{
+			return true;
+		}
+		vec3 ndc = clip.xyz / clip.w;
+		ndcMin = min(ndcMin, ndc);
+		ndcMax = max(ndcMax, ndc);
+	}
+
+	// Nothing of it lands on the screen
+	if (any(lessThan(ndcMax.xy, vec2(-1.0f))) || any(greaterThan(ndcMin.xy, vec2(1.0f))) || ndcMin.z > 1.0f)
+	{
+		return false;
+	}
+
+	vec2 texelMin = clamp((ndcMin.xy * 0.5f + 0.5f) * uHiZSize, vec2(0.0f), uHiZSize - 1.0f);
+	vec2 texelMax = clamp((ndcMax.xy * 0.5f + 0.5f) * uHiZSize, vec2(0.0f), uHiZSize - 1.0f);
+	float nearest = ndcMin.z * 0.5f + 0.5f;
+
+	// The level where the rectangle spans at most 2x2 texels
+	vec2 extent = texelMax - texelMin;
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0f)))), 0, uNumLevels - 1);
+	ivec2 first = ivec2(texelMin) >> level;
+	ivec2 last = ivec2(texelMax) >> level;
+
+	float farthest = 0.0f;
+	for (int y = first.y; y <= last.y; ++y)
+	{
+		for (int x = first.x; x <= last.x; ++x)
+		{
+			farthest = max(farthest, texelFetch(uTexHiZ, ivec2(x, y), level).r);
+		}
+	}
+	return nearest <= farthest;
+}
+
+void main()
+{
+	int object = gl_VertexID;
+	bool visible = isVisible(bounds[object * 2].xyz, bounds[object * 2 + 1].xyz);
+
+	if (uPhase == 0)
+	{
+		commands[object * 2].instanceCount = visible ? 1u : 0u;
+	}
+	else
+	{
+		// Only what the first phase did not already draw
+		commands[object * 2 + 1].instanceCount = visible && commands[object * 2].instanceCount == 0u ? 1u : 0u;
+	}
+
+	gl_Position = vec4(0.0f);
+}
@@ -0,0 +1,22 @@
+#version 420
+
+// Bounding box of an occlusion query, see OcclusionQueries.
+// Drawn as a 14 vertex triangle strip without attributes, the corners come from the vertex index.
+
+layout(std140, binding = 0) uniform Camera
+{
+	uniform mat4 uProj;
+	uniform mat4 uView;
+};
+
+// World space corners
+uniform vec3 uBoundsMin;
+uniform vec3 uBoundsMax;
+
+void main()
+{
+	int bit = 1 << gl_VertexID;
+	vec3 corner = vec3((0x287a & bit) != 0, (0x02af & bit) != 0, (0x31e3 & bit) != 0);
+
+	gl_Position = uProj * uView * vec4(mix(uBoundsMin, uBoundsMax, corner), 1.0f);
+}
@@ -0,0 +1,20 @@
+#version 420
+
+layout(std140, binding = 11) uniform Resolution
+{
+	// Part of the scene target that was rendered to, see DynamicResolution
+	uniform vec2 uViewportScale;
+	// Centre of the last rendered texel, keeps filtering from reading past the rendered part
+	uniform vec2 uViewportClamp;
+};
+
+layout(binding = 0) uniform sampler2D uTexScene;
+
+in vec2 texcoord;
+
+out vec4 outColor;
+
+void main()
+{
+	outColor = vec4(texture(uTexScene, min(texcoord * uViewportScale, uViewportClamp)).rgb, 1.0f);
+}
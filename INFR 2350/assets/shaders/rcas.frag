@@ -0,0 +1,42 @@
+#version 420
+
+// Robust contrast adaptive sharpening, after AMD FidelityFX Super Resolution 1.0 (RCAS).
+// Runs on the upscaled image at output resolution. Sharpens with a 5 tap cross whose negative
+// lobe is limited per pixel so the result never leaves the range of its neighbours.
+
+layout(binding = 0) uniform sampler2D uTexScene;
+
+// 0 is the strongest sharpening, each stop above halves it
+uniform float uSharpness;
+
+out vec4 outColor;
+
+// Largest negative lobe that keeps the filter from going unstable
+const float RcasLimit = 0.25f - 1.0f / 16.0f;
+
+void main()
+{
+	ivec2 position = ivec2(gl_FragCoord.xy);
+	ivec2 maxPosition = textureSize(uTexScene, 0) - 1;
+
+	//    b
+	//  d e f
+	//    h
+	vec3 b = texelFetch(uTexScene, clamp(position + ivec2( 0, -1), ivec2(0), maxPosition), 0).rgb;
+	vec3 d = texelFetch(uTexScene, clamp(position + ivec2(-1,  0), ivec2(0), maxPosition), 0).rgb;
+	vec3 e = texelFetch(uTexScene, position, 0).rgb;
+	vec3 f = texelFetch(uTexScene, clamp(position + ivec2( 1,  0), ivec2(0), maxPosition), 0).rgb;
+	vec3 h = texelFetch(uTexScene, clamp(position + ivec2( 0,  1), ivec2(0), maxPosition), 0).rgb;
+
+	vec3 minRing = min(min(b, d), min(f, h));
+	vec3 maxRing = max(max(b, d), max(f, h));
+
+	// The lobe that would take the darkest or brightest channel right to 0 or 1
+	vec3 hitMin = min(minRing, e) / max(4.0f * maxRing, 1.0e-5f);
+	vec3 hitMax = (1.0f - max(maxRing, e)) / min(4.0f * minRing - 4.0f, -1.0e-5f);
+	vec3 lobeRGB = max(-hitMin, hitMax);
+	float lobe = max(-RcasLimit, min(max(lobeRGB.r, max(lobeRGB.g, lobeRGB.b)), 0.0f)) * exp2(-uSharpness);
+
+	vec3 color = (lobe * (b + d + f + h) + e) / (4.0f * lobe + 1.0f);
+	outColor = vec4(color, 1.0f);
+}
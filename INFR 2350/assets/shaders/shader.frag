@@ -16,11 +16,18 @@ uniform float uMaterialSpecularExponent = 16.0;
 in vec2 texcoord;
 in vec3 norm;
 in vec3 pos;
+// Unjittered clip space positions this frame and last, see Camera::setJitter
+in vec4 clipCurrent;
+in vec4 clipPrevious;
 
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+// Screen space motion since the previous frame in texture coordinates, read by taa.frag
+layout(location = 1) out vec2 outVelocity;
 
 void main()
 {
+	outVelocity = (clipCurrent.xy / clipCurrent.w - clipPrevious.xy / clipPrevious.w) * 0.5f;
+
 	outColor.rgb = uSceneAmbient; 
 
 	// Fix length after rasterizer interpolates
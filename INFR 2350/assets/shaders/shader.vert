@@ -4,6 +4,9 @@ layout(std140, binding = 0) uniform Camera
 {
 	uniform mat4 uProj;
 	uniform mat4 uView;
+	// Without jitter, for motion vectors
+	uniform mat4 uViewProj;
+	uniform mat4 uViewProjPrev;
 };
 
 layout(std140, binding = 1) uniform Time
@@ -18,8 +21,14 @@ layout(location = 2) in vec3 in_normal;
 out vec2 texcoord;
 out vec3 norm;
 out vec3 pos;
+out vec4 clipCurrent;
+out vec4 clipPrevious;
 
 uniform mat4 uModel;
+uniform mat4 uModelPrev;
+
+// Must match depthOnly.vert exactly, the depth pre-pass is tested against with GL_EQUAL
+invariant gl_Position;
 
 void main()
 {
@@ -31,4 +40,7 @@ void main()
 	pos = (uView * uModel * vec4(in_vert, 1.0f)).xyz;
 
 	gl_Position = uProj * vec4(pos, 1.0f);
+
+	clipCurrent = uViewProj * uModel * vec4(in_vert, 1.0f);
+	clipPrevious = uViewProjPrev * uModelPrev * vec4(in_vert, 1.0f);
 }
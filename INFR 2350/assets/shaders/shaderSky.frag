@@ -10,10 +10,17 @@ layout(binding = 0) uniform samplerCube uTexCube;
 in vec2 texcoord;
 in vec3 norm;
 in vec3 pos;
+// Unjittered clip space positions this frame and last, see Camera::setJitter
+in vec4 clipCurrent;
+in vec4 clipPrevious;
 
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+// Screen space motion since the previous frame in texture coordinates, read by taa.frag
+layout(location = 1) out vec2 outVelocity;
 
 void main()
 {
+	outVelocity = (clipCurrent.xy / clipCurrent.w - clipPrevious.xy / clipPrevious.w) * 0.5f;
+
 	outColor = texture(uTexCube, normalize(norm));
 }
@@ -3,7 +3,11 @@
 layout(std140, binding = 0) uniform Camera
 {
 	uniform mat4 uProj;
+	// The camera's rotation while the sky draws, it is drawn around the eye
 	uniform mat4 uView;
+	// Without jitter, for motion vectors
+	uniform mat4 uViewProj;
+	uniform mat4 uViewProjPrev;
 };
 uniform mat4 uModel;
 
@@ -19,6 +23,8 @@ layout(location = 2) in vec3 in_normal;
 out vec2 texcoord;
 out vec3 norm;
 out vec3 pos;
+out vec4 clipCurrent;
+out vec4 clipPrevious;
 
 void main()
 {	
@@ -26,4 +32,9 @@ void main()
 	pos = (uModel * vec4(in_vert, 1.0f)).xyz;
 
 	gl_Position = uProj * vec4(pos, 1.0f);
+
+	// The sky is infinitely far away, so only the camera's rotation moves it
+	vec4 direction = vec4(mat3(uView) * pos, 0.0f);
+	clipCurrent = uViewProj * direction;
+	clipPrevious = uViewProjPrev * direction;
 }
@@ -46,12 +46,34 @@ layout(std140, binding = 8) uniform SpecularActive
 
 layout(binding = 31) uniform sampler2D uTexToonRamp;
 
+// Where the active ramp lives when it is pooled, uToonRampPool is -1 when it is bound to slot 31
+layout(std140, binding = 9) uniform ToonRamp
+{
+	uniform int uToonRampPool;
+	uniform int uToonRampLayer;
+};
+
 
 
 layout(binding = 0) uniform sampler2D uTexAlbedo;
 layout(binding = 1) uniform sampler2D uTexEmissive;
 layout(binding = 2) uniform sampler2D uTexSpecular;
 
+// Small textures are packed into shared arrays (see TextureArray), picked by pool and layer.
+// A pool of -1 means the texture is bound to its own slot instead.
+layout(binding = 16) uniform sampler2DArray uTexPools[8];
+uniform int uTexPool[3];
+uniform int uTexLayer[3];
+
+vec4 sampleMaterial(sampler2D tex, int slot, vec2 uv)
+{
+	if (uTexPool[slot] < 0)
+	{
+		return texture(tex, uv);
+	}
+	return texture(uTexPools[uTexPool[slot]], vec3(uv, uTexLayer[slot]));
+}
+
 uniform vec3 DiffuseLight = vec3(0.0, 0.0, 1.0);
 uniform vec3 RimColor  = vec3(0.0, 0.0, 0.0);
 uniform float gamma = 1/0.01;
@@ -60,14 +82,21 @@ uniform float uMaterialSpecularExponent = 64.0;
 in vec2 texcoord;
 in vec3 norm;
 in vec3 pos;
+// Unjittered clip space positions this frame and last, see Camera::setJitter
+in vec4 clipCurrent;
+in vec4 clipPrevious;
 
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+// Screen space motion since the previous frame in texture coordinates, read by taa.frag
+layout(location = 1) out vec2 outVelocity;
 
 void main()
 {
+	outVelocity = (clipCurrent.xy / clipCurrent.w - clipPrevious.xy / clipPrevious.w) * 0.5f;
+
 	vec2 texOffset = texcoord;
 
-	vec4 albedoColor = texture(uTexAlbedo, texOffset);
+	vec4 albedoColor = sampleMaterial(uTexAlbedo, 0, texOffset);
 	if(uAmbientActive)
 	{
 		outColor.rgb = albedoColor.rgb * uSceneAmbient; 
@@ -102,7 +131,10 @@ void main()
 		if(uToonActive)
 		{
 			NdotL = NdotL * 0.5 + 0.5;
-			outColor.rgb += albedoColor.rgb * uLightColor * texture(uTexToonRamp, vec2(NdotL, 0.5)).rgb * uLightAttenuation.rgb;
+			vec3 ramp = uToonRampPool < 0 ? 
+				texture(uTexToonRamp, vec2(NdotL, 0.5)).rgb : 
+				texture(uTexPools[uToonRampPool], vec3(NdotL, 0.5, uToonRampLayer)).rgb;
+			outColor.rgb += albedoColor.rgb * uLightColor * ramp * uLightAttenuation.rgb;
 		}
 		else
 		{
@@ -119,7 +151,7 @@ void main()
 			specularStrength = max(specularStrength, 0.0f); // don't let it fall before zero
 
 			// Calculate the specular contribution
-			outColor.rgb += texture(uTexSpecular, texOffset).rgb * uLightColor * pow(specularStrength, uMaterialSpecularExponent) * attenuation;
+			outColor.rgb += sampleMaterial(uTexSpecular, 2, texOffset).rgb * uLightColor * pow(specularStrength, uMaterialSpecularExponent) * attenuation;
 		}
 		else
 		{
@@ -128,7 +160,7 @@ void main()
 		
 		if (uRimActive)
 		{
-			vec3 tex = texture(uTexAlbedo, texcoord).rgb;
+			vec3 tex = sampleMaterial(uTexAlbedo, 0, texcoord).rgb;
 
 			//Diffuse Light
 			vec3 diffuse = DiffuseLight * max(0, dot(pos, norm));
@@ -151,5 +183,5 @@ void main()
 			outColor.rgb = outColor.rgb;
 		}
 	}
-	outColor.rgb += texture(uTexEmissive, texOffset).rgb;
+	outColor.rgb += sampleMaterial(uTexEmissive, 1, texOffset).rgb;
 }
@@ -1,5 +1,17 @@
 #version 420
 
+// Specialization constants, injected as a #define when loaded from GLSL source
+#ifdef GL_SPIRV
+layout(constant_id = 0) const int ALPHA_DISCARD = 1;
+layout(constant_id = 1) const int ALPHA_TO_COVERAGE = 0;
+#else
+#if !defined(ALPHA_DISCARD)
+#define ALPHA_DISCARD 1
+#endif
+#if !defined(ALPHA_TO_COVERAGE)
+#define ALPHA_TO_COVERAGE 0
+#endif
+#endif
 
 layout(std140, binding = 2) uniform LightScene
 {
@@ -23,25 +35,55 @@ layout(binding = 0) uniform sampler2D uTexAlbedo;
 layout(binding = 1) uniform sampler2D uTexEmissive;
 layout(binding = 2) uniform sampler2D uTexSpecular;
 
+// Small textures are packed into shared arrays (see TextureArray), picked by pool and layer.
+// A pool of -1 means the texture is bound to its own slot instead.
+layout(binding = 16) uniform sampler2DArray uTexPools[8];
+uniform int uTexPool[3];
+uniform int uTexLayer[3];
+
+vec4 sampleMaterial(sampler2D tex, int slot, vec2 uv)
+{
+	if (uTexPool[slot] < 0)
+	{
+		return texture(tex, uv);
+	}
+	return texture(uTexPools[uTexPool[slot]], vec3(uv, uTexLayer[slot]));
+}
+
 in vec2 texcoord;
 in vec3 norm;
 in vec3 pos;
+// Unjittered clip space positions this frame and last, see Camera::setJitter
+in vec4 clipCurrent;
+in vec4 clipPrevious;
 
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+// Screen space motion since the previous frame in texture coordinates, read by taa.frag
+layout(location = 1) out vec2 outVelocity;
 
 void main()
 {
+	outVelocity = (clipCurrent.xy / clipCurrent.w - clipPrevious.xy / clipPrevious.w) * 0.5f;
+
 	vec2 texOffset = texcoord;
 
-	vec4 albedoColor = texture(uTexAlbedo, texOffset);
+	vec4 albedoColor = sampleMaterial(uTexAlbedo, 0, texOffset);
 	outColor.rgb = albedoColor.rgb * uSceneAmbient; 
 	outColor.a = albedoColor.a;
 
-	if(albedoColor.a < uCutoff)
+	if(ALPHA_DISCARD != 0 && albedoColor.a < uCutoff)
 	{
 		discard;
 	}
 
+	// With GL_SAMPLE_ALPHA_TO_COVERAGE alpha picks how many samples the fragment covers.
+	// Rescaling it around the cutoff by its screen space rate of change keeps the edge one pixel wide
+	// at any distance, instead of the texture's blurry alpha fading the leaves out as they mip down.
+	if(ALPHA_TO_COVERAGE != 0)
+	{
+		outColor.a = clamp((albedoColor.a - uCutoff) / max(fwidth(albedoColor.a), 0.0001f) + 0.5f, 0.0f, 1.0f);
+	}
+
 	// Fix length after rasterizer interpolates
 	vec3 normal = normalize(norm);
 
@@ -70,8 +112,8 @@ void main()
 		specularStrength = max(specularStrength, 0.0f); // don't let it fall before zero
 
 		// Calculate the specular contribution
-		outColor.rgb += texture(uTexSpecular, texOffset).rgb * uLightColor * pow(specularStrength, uMaterialSpecularExponent) * attenuation;
+		outColor.rgb += sampleMaterial(uTexSpecular, 2, texOffset).rgb * uLightColor * pow(specularStrength, uMaterialSpecularExponent) * attenuation;
 	}
 
-	outColor.rgb += texture(uTexEmissive, texOffset).rgb;
+	outColor.rgb += sampleMaterial(uTexEmissive, 1, texOffset).rgb;
 }
@@ -22,18 +22,40 @@ layout(binding = 0) uniform sampler2D uTexAlbedo;
 layout(binding = 1) uniform sampler2D uTexEmissive;
 layout(binding = 2) uniform sampler2D uTexSpecular;
 
+// Small textures are packed into shared arrays (see TextureArray), picked by pool and layer.
+// A pool of -1 means the texture is bound to its own slot instead.
+layout(binding = 16) uniform sampler2DArray uTexPools[8];
+uniform int uTexPool[3];
+uniform int uTexLayer[3];
+
+vec4 sampleMaterial(sampler2D tex, int slot, vec2 uv)
+{
+	if (uTexPool[slot] < 0)
+	{
+		return texture(tex, uv);
+	}
+	return texture(uTexPools[uTexPool[slot]], vec3(uv, uTexLayer[slot]));
+}
+
 in vec2 texcoord;
 in vec3 norm;
 in vec3 pos;
+// Unjittered clip space positions this frame and last, see Camera::setJitter
+in vec4 clipCurrent;
+in vec4 clipPrevious;
 
-out vec4 outColor;
+layout(location = 0) out vec4 outColor;
+// Screen space motion since the previous frame in texture coordinates, read by taa.frag
+layout(location = 1) out vec2 outVelocity;
 
 void main()
 {
+	outVelocity = (clipCurrent.xy / clipCurrent.w - clipPrevious.xy / clipPrevious.w) * 0.5f;
+
 	vec2 texOffset = texcoord;
 	texOffset.x += sin(texOffset.y * 16 + uTime) * 0.1 + uTime * 0.1;
 
-	vec4 albedoColor = texture(uTexAlbedo, texOffset);
+	vec4 albedoColor = sampleMaterial(uTexAlbedo, 0, texOffset);
 	outColor.rgb = albedoColor.rgb * uSceneAmbient; 
 	outColor.a = albedoColor.a;
 
@@ -65,8 +87,8 @@ void main()
 		specularStrength = max(specularStrength, 0.0f); // don't let it fall before zero
 
 		// Calculate the specular contribution
-		outColor.rgb += texture(uTexSpecular, texOffset).rgb * uLightColor * pow(specularStrength, uMaterialSpecularExponent) * attenuation;
+		outColor.rgb += sampleMaterial(uTexSpecular, 2, texOffset).rgb * uLightColor * pow(specularStrength, uMaterialSpecularExponent) * attenuation;
 	}
 
-	outColor.rgb += texture(uTexEmissive, texOffset).rgb;
+	outColor.rgb += sampleMaterial(uTexEmissive, 1, texOffset).rgb;
 }
@@ -0,0 +1,151 @@
+#version 420
+
+// Temporal anti-aliasing and upscaling, see TemporalAA.
+// Reconstructs the output pixel from the jittered scene samples around it, reprojects the history
+// with the motion vector of the closest surface, clips it to the new neighbourhood and blends.
+
+layout(std140, binding = 11) uniform Resolution
+{
+	// Part of the scene targets that was rendered to, see DynamicResolution
+	uniform vec2 uViewportScale;
+	uniform vec2 uViewportClamp;
+};
+
+layout(binding = 0) uniform sampler2D uTexScene;
+layout(binding = 1) uniform sampler2D uTexVelocity;
+layout(binding = 2) uniform sampler2D uTexDepth;
+layout(binding = 3) uniform sampler2D uTexHistory;
+
+// This frame's jitter in scene pixels
+uniform vec2 uJitter;
+// Weight kept from the history
+uniform float uFeedback;
+// 0 on the first frame, or after the history was dropped
+uniform int uHistoryValid;
+
+in vec2 texcoord;
+
+out vec4 outColor;
+
+vec3 toYCoCg(vec3 color)
+{
+	return vec3(
+		 0.25f * color.r + 0.5f * color.g + 0.25f * color.b,
+		 0.5f  * color.r                  - 0.5f  * color.b,
+		-0.25f * color.r + 0.5f * color.g - 0.25f * color.b);
+}
+
+vec3 fromYCoCg(vec3 color)
+{
+	return vec3(color.x + color.y - color.z, color.x + color.z, color.x - color.y - color.z);
+}
+
+// Bicubic Catmull-Rom in 5 bilinear taps, keeps the history sharp as it is resampled every frame
+vec3 sampleHistory(vec2 uv)
+{
+	vec2 size = vec2(textureSize(uTexHistory, 0));
+	vec2 samplePosition = uv * size;
+	vec2 texPosition1 = floor(samplePosition - 0.5f) + 0.5f;
+	vec2 f = samplePosition - texPosition1;
+
+	vec2 w0 = f * (-0.5f + f * (1.0f - 0.5f * f));
+	vec2 w1 = 1.0f + f * f * (-2.5f + 1.5f * f);
+	vec2 w2 = f * (0.5f + f * (2.0f - 1.5f * f));
+	vec2 w3 = f * f * (-0.5f + 0.5f * f);
+
+	vec2 w12 = w1 + w2;
+	vec2 texPosition0 = (texPosition1 - 1.0f) / size;
+	vec2 texPosition3 = (texPosition1 + 2.0f) / size;
+	vec2 texPosition12 = (texPosition1 + w2 / w12) / size;
+
+	vec3 result =
+		textureLod(uTexHistory, vec2(texPosition12.x, texPosition0.y), 0.0f).rgb * w12.x * w0.y +
+		textureLod(uTexHistory, vec2(texPosition0.x, texPosition12.y), 0.0f).rgb * w0.x * w12.y +
+		textureLod(uTexHistory, texPosition12, 0.0f).rgb * w12.x * w12.y +
+		textureLod(uTexHistory, vec2(texPosition3.x, texPosition12.y), 0.0f).rgb * w3.x * w12.y +
+		textureLod(uTexHistory, vec2(texPosition12.x, texPosition3.y), 0.0f).rgb * w12.x * w3.y;
+	float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+	return max(result / weight, 0.0f);
+}
+
+// Pulls history towards the centre of the box until it is inside, which keeps its hue better than clamping
+vec3 clipToBox(vec3 history, vec3 center, vec3 boxMin, vec3 boxMax)
+{
+	vec3 extent = (boxMax - boxMin) * 0.5f + 1.0e-5f;
+	vec3 offset = history - center;
+	vec3 units = abs(offset / extent);
+	float furthest = max(units.x, max(units.y, units.z));
+	return furthest > 1.0f ? center + offset / furthest : history;
+}
+
+void main()
+{
+	vec2 inputSize = vec2(textureSize(uTexScene, 0)) * uViewportScale;
+	ivec2 viewportMax = ivec2(inputSize) - 1;
+	vec2 outputSize = vec2(textureSize(uTexHistory, 0));
+
+	// The output pixel's centre in scene pixels. Scene texel t holds the point at t + 0.5 - jitter.
+	vec2 position = texcoord * inputSize;
+	ivec2 nearest = ivec2(floor(position + uJitter));
+
+	// Reconstruct the new sample from the 3x3 around it, and gather the neighbourhood's colour spread
+	vec3 colorSum = vec3(0.0f);
+	float weightSum = 0.0f;
+	vec3 moment1 = vec3(0.0f);
+	vec3 moment2 = vec3(0.0f);
+	vec3 neighbourMin = vec3(1.0e5f);
+	vec3 neighbourMax = vec3(-1.0e5f);
+	float closestDepth = 1.0f;
+	ivec2 closest = nearest;
+	float nearestDistance = 1.0e5f;
+	for (int y = -1; y <= 1; ++y)
+	{
+		for (int x = -1; x <= 1; ++x)
+		{
+			ivec2 texel = clamp(nearest + ivec2(x, y), ivec2(0), viewportMax);
+			vec3 color = toYCoCg(texelFetch(uTexScene, texel, 0).rgb);
+
+			// Gaussian fit of Blackman-Harris over the distance to the sample, in scene pixels
+			vec2 offset = vec2(nearest + ivec2(x, y)) + 0.5f - uJitter - position;
+			float distance2 = dot(offset, offset);
+			float weight = exp(-2.29f * distance2);
+			colorSum += color * weight;
+			weightSum += weight;
+			nearestDistance = min(nearestDistance, distance2);
+
+			moment1 += color;
+			moment2 += color * color;
+			neighbourMin = min(neighbourMin, color);
+			neighbourMax = max(neighbourMax, color);
+
+			// Motion of the closest surface keeps edges of moving objects from trailing
+			float depth = texelFetch(uTexDepth, texel, 0).r;
+			if (depth < closestDepth)
+			{
+				closestDepth = depth;
+				closest = texel;
+			}
+		}
+	}
+	vec3 current = colorSum / weightSum;
+
+	vec2 historyUV = texcoord - texelFetch(uTexVelocity, closest, 0).xy;
+	if (uHistoryValid == 0 || any(lessThan(historyUV, vec2(0.0f))) || any(greaterThan(historyUV, vec2(1.0f))))
+	{
+		outColor = vec4(fromYCoCg(current), 1.0f);
+		return;
+	}
+
+	// Variance clipping, a box of one standard deviation around the mean inside the neighbourhood's bounds
+	vec3 mean = moment1 / 9.0f;
+	vec3 deviation = sqrt(max(moment2 / 9.0f - mean * mean, 0.0f));
+	vec3 boxMin = max(mean - deviation, neighbourMin);
+	vec3 boxMax = min(mean + deviation, neighbourMax);
+	vec3 history = clipToBox(toYCoCg(sampleHistory(historyUV)), clamp(mean, boxMin, boxMax), boxMin, boxMax);
+
+	// When upscaling, output pixels far from any new sample lean on the history more
+	float outputDistance2 = nearestDistance * dot(outputSize / inputSize, outputSize / inputSize) * 0.5f;
+	float blend = (1.0f - uFeedback) * exp(-2.29f * outputDistance2);
+
+	outColor = vec4(fromYCoCg(mix(history, current, blend)), 1.0f);
+}